@@ -258,15 +258,14 @@ void displayFileCount() {
     M5.Display.setCursor(10, 130);
     M5.Display.println("SD Card Information:");
     
-    auto files = uploader.listFiles();
-    M5.Display.setCursor(15, 150);
-    M5.Display.printf("Total files: %d", files.size());
-    
+    // 1回の走査でファイル数と合計サイズを集計（ファイルごとに開き直さない）
     uint32_t totalSize = 0;
-    for (const auto& file : files) {
-        String fullPath = "/uploads/" + file;
-        totalSize += SDCardManager::getFileSize(fullPath.c_str());
-    }
+    uint32_t fileCount = SDCardManager::forEachEntry("/uploads", [&totalSize](const DirectoryEntry& entry) {
+        totalSize += entry.size;
+        return true;
+    }, false, DIR_FIELD_SIZE);
+    M5.Display.setCursor(15, 150);
+    M5.Display.printf("Total files: %d", fileCount);
     
     M5.Display.setCursor(15, 165);
     M5.Display.printf("Total size: %d KB", totalSize / 1024);
@@ -0,0 +1,246 @@
+/**
+ * JsonReader テスト・ベンチマークスケッチ
+ *
+ * JsonReader のエスケープ解釈・構文検証を確認し、
+ * 削除リクエスト（{"filename":..}）と100件の一括操作（/api/batch）のボディを
+ * 従来の indexOf/substring による取り出し・ArduinoJson の StaticJsonDocument・JsonReader で読んだときの
+ * 所要時間とヒープ使用量を比較します。
+ */
+
+#include <M5Unified.h>
+#include <ArduinoJson.h>
+#include "JsonReader.h"
+
+const int BATCH_COUNT = 100;
+const int ITERATIONS = 200;
+
+String deleteBody;
+String batchBody;
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== JsonReader Test Suite ===\n");
+
+    // テスト1: エスケープ・空白
+    testEscape();
+
+    // テスト2: 構文エラーの検出
+    testSyntax();
+
+    // テスト3: 入れ子の読み飛ばし
+    testSkip();
+
+    // ベンチマーク
+    deleteBody = "{ \"path\": \"/sdcard\", \"filename\" : \"IMG_0001.jpg\" }";
+    batchBody = "{\"operations\":[";
+    for (int i = 0; i < BATCH_COUNT; i++) {
+        if (i > 0) batchBody += ",";
+        batchBody += "{\"op\":\"move\",\"from\":\"IMG_" + String(i) + ".jpg\",\"to\":\"cam1\"}";
+    }
+    batchBody += "]}";
+    benchDelete();
+    benchBatch();
+
+    Serial.println("\n=== All Tests Completed ===\n");
+}
+
+void loop() {
+    delay(1000);
+}
+
+void check(const char* name, bool ok) {
+    Serial.printf("  %s: %s\n", name, ok ? "PASS" : "FAIL");
+}
+
+// 従来の実装（_handleDeleteFile() の indexOf/substring）
+String legacyFilename(const String& body) {
+    int filenamePos = body.indexOf("\"filename\"");
+    if (filenamePos == -1) return "";
+    int startPos = body.indexOf("\"", filenamePos + 11) + 1;
+    int endPos = body.indexOf("\"", startPos);
+    return body.substring(startPos, endPos);
+}
+
+bool readerFilename(const String& body, char* out, size_t size) {
+    out[0] = '\0';
+    JsonReader reader(body.c_str(), body.length());
+    bool valid = reader.next() == JSON_TOKEN_BEGIN_OBJECT;
+    while (valid && reader.next() == JSON_TOKEN_KEY) {
+        if (!reader.span().equals("filename")) {
+            valid = reader.skip();
+        } else {
+            valid = reader.next() == JSON_TOKEN_STRING && reader.span().copyTo(out, size);
+        }
+    }
+    return valid && !reader.hasError();
+}
+
+bool isValid(const char* text) {
+    JsonReader reader(text, strlen(text));
+    JsonToken token;
+    do {
+        token = reader.next();
+    } while (token != JSON_TOKEN_END && token != JSON_TOKEN_ERROR);
+    return token == JSON_TOKEN_END;
+}
+
+void testEscape() {
+    Serial.println("[Test 1] Escape and whitespace");
+    char name[64];
+
+    String body = "{\n  \"filename\" :\t\"a\\\"b\\\\c.jpg\"\n}";
+    check("escaped quote/backslash", readerFilename(body, name, sizeof(name)) && strcmp(name, "a\"b\\c.jpg") == 0);
+    Serial.printf("    legacy code extracts: '%s'\n", legacyFilename(body).c_str());
+
+    body = "{\"filename\":\"\\u5199\\u771f.jpg\"}";
+    check("\\u escape to UTF-8", readerFilename(body, name, sizeof(name)) && strcmp(name, "写真.jpg") == 0);
+
+    body = "{\"filename\":\"\\ud83d\\ude00.png\"}";
+    check("surrogate pair", readerFilename(body, name, sizeof(name)) && strcmp(name, "\xF0\x9F\x98\x80.png") == 0);
+
+    body = "{\"note\":\"\\\"filename\\\"\",\"filename\":\"real.jpg\"}";
+    check("key-like text inside value", readerFilename(body, name, sizeof(name)) && strcmp(name, "real.jpg") == 0);
+    Serial.printf("    legacy code extracts: '%s'\n", legacyFilename(body).c_str());
+
+    char small[4];
+    body = "{\"filename\":\"toolong.jpg\"}";
+    check("too long is rejected, not truncated", !readerFilename(body, small, sizeof(small)) && small[0] == '\0');
+
+    const char* nulKey = "{\"\\u0000x\":1}";
+    JsonReader reader(nulKey, strlen(nulKey));
+    check("\\u0000 key does not match shorter text",
+          reader.next() == JSON_TOKEN_BEGIN_OBJECT && reader.next() == JSON_TOKEN_KEY && !reader.span().equals(""));
+}
+
+void testSyntax() {
+    Serial.println("[Test 2] Syntax errors");
+    check("valid documents", isValid("{}") && isValid(" [ ] ") && isValid("[1,-0.5e+3,true,false,null,\"x\"]"));
+    check("trailing comma", !isValid("[1,]") && !isValid("{\"a\":1,}"));
+    check("missing colon", !isValid("{\"a\" 1}"));
+    check("unterminated", !isValid("{\"a\":\"b") && !isValid("[1"));
+    check("trailing garbage", !isValid("{} x"));
+    check("leading zero / bad escape", !isValid("01") && !isValid("\"\\x\""));
+    String deep;
+    for (int i = 0; i < 33; i++) deep = "[" + deep + "]";
+    check("depth limit (33 levels)", !isValid(deep.c_str()));
+}
+
+void testSkip() {
+    Serial.println("[Test 3] Skip nested values");
+    const char* text = "{\"a\":{\"b\":[1,{\"c\":[]}]},\"d\":[[\"x\"]],\"e\":42}";
+    JsonReader reader(text, strlen(text));
+    uint32_t e = 0;
+    reader.next();
+    while (reader.next() == JSON_TOKEN_KEY) {
+        if (reader.span().equals("e") && reader.next() == JSON_TOKEN_NUMBER) {
+            reader.span().toUInt32(e);
+        } else {
+            reader.skip();
+        }
+    }
+    check("skip object and array values", e == 42 && !reader.hasError() && reader.next() == JSON_TOKEN_END);
+}
+
+void printResult(const char* name, unsigned long elapsed, uint32_t minHeapBefore, uint32_t heapBefore) {
+    uint32_t minHeapAfter = ESP.getMinFreeHeap();
+    Serial.printf("  %-20s %7lu us  heap low-water drop: %u bytes  (free: %u -> %u)\n", name, elapsed,
+                  minHeapBefore > minHeapAfter ? minHeapBefore - minHeapAfter : 0, heapBefore, ESP.getFreeHeap());
+}
+
+void benchDelete() {
+    Serial.printf("\n[Benchmark] delete body (%u bytes) x %d\n", deleteBody.length(), ITERATIONS);
+    static StaticJsonDocument<256> doc;
+
+    for (int mode = 0; mode < 3; mode++) {
+        uint32_t heapBefore = ESP.getFreeHeap();
+        uint32_t minHeapBefore = ESP.getMinFreeHeap();
+        size_t length = 0;
+
+        unsigned long startTime = micros();
+        for (int i = 0; i < ITERATIONS; i++) {
+            if (mode == 0) {
+                length = legacyFilename(deleteBody).length();
+            } else if (mode == 1) {
+                deserializeJson(doc, deleteBody.c_str(), deleteBody.length());
+                length = strlen(doc["filename"] | "");
+            } else {
+                char name[JSON_REQUEST_MAX_STRING];
+                readerFilename(deleteBody, name, sizeof(name));
+                length = strlen(name);
+            }
+        }
+        unsigned long elapsed = (micros() - startTime) / ITERATIONS;
+
+        const char* names[] = {"indexOf/substring", "StaticJsonDocument", "JsonReader"};
+        printResult(names[mode], elapsed, minHeapBefore, heapBefore);
+        if (length != 12) Serial.println("    unexpected result");
+    }
+    Serial.printf("  ※ StaticJsonDocument<256> は静的領域、JsonReader は %u バイト + 出力先のスタックバッファのみ使用\n",
+                  (unsigned int)sizeof(JsonReader));
+}
+
+// /api/batch と同じ手順（1回目で検証・件数の確認、2回目で各操作を読む）
+uint32_t readerBatch(const String& body) {
+    JsonReader reader(body.c_str(), body.length());
+    JsonToken token;
+    do {
+        token = reader.next();
+    } while (token != JSON_TOKEN_END && token != JSON_TOKEN_ERROR);
+    if (token == JSON_TOKEN_ERROR) return 0;
+
+    char op[16];
+    char from[JSON_REQUEST_MAX_STRING];
+    char to[JSON_REQUEST_MAX_STRING];
+    uint32_t count = 0;
+    JsonReader operations(body.c_str(), body.length());
+    operations.next();                                  // {
+    operations.next();                                  // "operations"
+    operations.next();                                  // [
+    while (operations.next() == JSON_TOKEN_BEGIN_OBJECT) {
+        op[0] = from[0] = to[0] = '\0';
+        while (operations.next() == JSON_TOKEN_KEY) {
+            JsonSpan key = operations.span();
+            operations.next();
+            if (key.equals("op")) operations.span().copyTo(op, sizeof(op));
+            else if (key.equals("from")) operations.span().copyTo(from, sizeof(from));
+            else if (key.equals("to")) operations.span().copyTo(to, sizeof(to));
+        }
+        if (from[0] != '\0') count++;
+    }
+    return count;
+}
+
+void benchBatch() {
+    Serial.printf("\n[Benchmark] batch body, %d operations (%u bytes) x %d\n", BATCH_COUNT, batchBody.length(),
+                  ITERATIONS / 10);
+    static StaticJsonDocument<16384> doc;
+
+    for (int mode = 0; mode < 2; mode++) {
+        uint32_t heapBefore = ESP.getFreeHeap();
+        uint32_t minHeapBefore = ESP.getMinFreeHeap();
+        uint32_t count = 0;
+
+        unsigned long startTime = micros();
+        for (int i = 0; i < ITERATIONS / 10; i++) {
+            if (mode == 0) {
+                // 文字列は const char* から読むとコピーされないため、String から読んで従来の実装にそろえる
+                deserializeJson(doc, batchBody);
+                count = 0;
+                for (JsonObject item : doc["operations"].as<JsonArray>()) {
+                    if (strlen(item["from"] | "") > 0) count++;
+                }
+            } else {
+                count = readerBatch(batchBody);
+            }
+        }
+        unsigned long elapsed = (micros() - startTime) / (ITERATIONS / 10);
+
+        printResult(mode == 0 ? "StaticJsonDocument" : "JsonReader", elapsed, minHeapBefore, heapBefore);
+        if (mode == 0) Serial.printf("    document memory usage: %u bytes\n", (unsigned int)doc.memoryUsage());
+        if (count != BATCH_COUNT) Serial.println("    unexpected result");
+    }
+}
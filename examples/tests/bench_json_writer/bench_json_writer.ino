@@ -0,0 +1,187 @@
+/**
+ * JsonWriter テスト・ベンチマークスケッチ
+ *
+ * JsonWriter のエスケープ・数値整形を検証し、
+ * 1000件のファイル一覧を String の連結（従来の実装）と JsonWriter で生成したときの
+ * 所要時間とヒープ使用量を比較します。
+ */
+
+#include <M5Unified.h>
+#include "JsonWriter.h"
+
+const int ENTRY_COUNT = 1000;
+const int ITERATIONS = 5;
+
+String captured;
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== JsonWriter Test Suite ===\n");
+
+    // テスト1: 文字列のエスケープ
+    testEscape();
+
+    // テスト2: 数値・入れ子構造
+    testStructure();
+
+    // テスト3: バッファより長い出力の分割
+    testSmallBuffer();
+
+    // ベンチマーク: 1000件の一覧
+    benchListing();
+
+    Serial.println("\n=== All Tests Completed ===\n");
+}
+
+void loop() {
+    delay(1000);
+}
+
+JsonOutputCallback captureOutput() {
+    return [](const char* data, size_t length) {
+        captured.concat(data, length);
+        return true;
+    };
+}
+
+void check(const char* name, const String& expected) {
+    bool ok = captured == expected;
+    Serial.printf("  %s: %s\n", name, ok ? "PASS" : "FAIL");
+    if (!ok) {
+        Serial.printf("    expected: %s\n    actual:   %s\n", expected.c_str(), captured.c_str());
+    }
+}
+
+void testEscape() {
+    Serial.println("[Test 1] Escape");
+    char buffer[64];
+
+    captured = "";
+    JsonWriter json(buffer, sizeof(buffer), captureOutput());
+    json.beginObject();
+    json.field("name", "a\"b\\c.txt");
+    json.field("ctrl", "tab\there\nnew\x01");
+    json.field("utf8", "写真.jpg");
+    json.endObject();
+    json.flush();
+    check("quotes/backslash/control/utf8",
+          "{\"name\":\"a\\\"b\\\\c.txt\",\"ctrl\":\"tab\\there\\nnew\\u0001\",\"utf8\":\"写真.jpg\"}");
+}
+
+void testStructure() {
+    Serial.println("[Test 2] Numbers and nesting");
+    char buffer[64];
+
+    captured = "";
+    JsonWriter json(buffer, sizeof(buffer), captureOutput());
+    json.beginObject();
+    json.field("max", 4294967295UL);
+    json.field("neg", -42);
+    json.field("zero", 0);
+    json.field("ok", true);
+    json.key("list");
+    json.beginArray();
+    json.value("x");
+    json.beginObject();
+    json.endObject();
+    json.valueNull();
+    json.endArray();
+    json.endObject();
+    json.flush();
+    check("numbers/arrays/null",
+          "{\"max\":4294967295,\"neg\":-42,\"zero\":0,\"ok\":true,\"list\":[\"x\",{},null]}");
+}
+
+void testSmallBuffer() {
+    Serial.println("[Test 3] Output split across flushes");
+    char buffer[8];
+    int flushes = 0;
+
+    captured = "";
+    JsonWriter json(buffer, sizeof(buffer), [&flushes](const char* data, size_t length) {
+        flushes++;
+        captured.concat(data, length);
+        return true;
+    });
+    json.beginArray();
+    for (int i = 0; i < 10; i++) {
+        json.value("item");
+    }
+    json.endArray();
+    json.flush();
+    check("8-byte buffer", "[\"item\",\"item\",\"item\",\"item\",\"item\",\"item\",\"item\",\"item\",\"item\",\"item\"]");
+    Serial.printf("  flushes: %d\n", flushes);
+}
+
+// 従来の実装（String の連結）
+size_t buildWithString() {
+    String json = "{";
+    json += "\"files\": [";
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        if (i > 0) json += ", ";
+        json += "{";
+        json += "\"name\": \"IMG_" + String(i) + ".jpg\", ";
+        json += "\"size\": " + String(100000 + i) + ", ";
+        json += "\"modified\": " + String(1700000000 + i) + ", ";
+        json += "\"isDirectory\": " + String("false") + ", ";
+        json += "\"extension\": \"jpg\"";
+        json += "}";
+    }
+    json += "], ";
+    json += "\"total\": " + String(ENTRY_COUNT);
+    json += "}";
+    return json.length();
+}
+
+// JsonWriter（1KBの固定バッファ、出力は破棄）
+size_t buildWithWriter() {
+    char buffer[1024];
+    char name[16];
+    JsonWriter json(buffer, sizeof(buffer), [](const char* data, size_t length) { return true; });
+    json.beginObject();
+    json.key("files");
+    json.beginArray();
+    for (int i = 0; i < ENTRY_COUNT; i++) {
+        snprintf(name, sizeof(name), "IMG_%d.jpg", i);
+        json.beginObject();
+        json.field("name", name);
+        json.field("size", 100000 + i);
+        json.field("modified", 1700000000 + i);
+        json.field("isDirectory", false);
+        json.field("extension", "jpg");
+        json.endObject();
+    }
+    json.endArray();
+    json.field("total", ENTRY_COUNT);
+    json.endObject();
+    json.flush();
+    return json.getBytesWritten();
+}
+
+void benchListing() {
+    Serial.printf("\n[Benchmark] %d-entry listing x %d\n", ENTRY_COUNT, ITERATIONS);
+
+    for (int mode = 0; mode < 2; mode++) {
+        uint32_t heapBefore = ESP.getFreeHeap();
+        uint32_t largestBefore = ESP.getMaxAllocHeap();
+        uint32_t minHeapBefore = ESP.getMinFreeHeap();
+        size_t bytes = 0;
+
+        unsigned long startTime = micros();
+        for (int i = 0; i < ITERATIONS; i++) {
+            bytes = (mode == 0) ? buildWithString() : buildWithWriter();
+        }
+        unsigned long elapsed = (micros() - startTime) / ITERATIONS;
+
+        uint32_t minHeapAfter = ESP.getMinFreeHeap();
+        Serial.printf("  %-10s %6lu us  %6u bytes  heap low-water drop: %u bytes  (free: %u, largest block: %u -> %u)\n",
+                      mode == 0 ? "String" : "JsonWriter", elapsed, (unsigned int)bytes,
+                      minHeapBefore > minHeapAfter ? minHeapBefore - minHeapAfter : 0,
+                      heapBefore, largestBefore, ESP.getMaxAllocHeap());
+    }
+    Serial.println("  ※ String は出力全体を連続領域に確保し直しながら伸長、JsonWriter は1KBのスタックバッファのみ使用");
+}
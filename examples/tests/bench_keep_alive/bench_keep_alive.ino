@@ -0,0 +1,135 @@
+/**
+ * HTTP keep-alive ベンチマークスケッチ
+ *
+ * 2台目のESP32（M5Stack）をHTTPクライアントとして使い、
+ * M5StackWiFiUploader を実行中のサーバーへ 1KB のファイルを繰り返しアップロードして
+ * 持続的接続あり・なしの requests/s を比較します。
+ *
+ * 使用方法:
+ * 1. サーバー側で任意のアップロード例（HTTPUploadExample など）を起動
+ * 2. このスケッチの WiFi 設定とサーバーのIPアドレスを設定して書き込み
+ * 3. シリアルモニタで結果を確認
+ */
+
+#include <M5Unified.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+
+// WiFi設定
+const char* WIFI_SSID = "your_ssid";
+const char* WIFI_PASSWORD = "your_password";
+
+// サーバー設定
+const char* SERVER_HOST = "192.168.1.100";
+const uint16_t SERVER_PORT = 80;
+
+// ベンチマーク設定
+const int REQUEST_COUNT = 50;
+const size_t UPLOAD_SIZE = 1024;
+const char* BOUNDARY = "----BenchKeepAliveBoundary";
+
+String uploadBody;
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== HTTP Keep-Alive Benchmark ===\n");
+
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(500);
+        Serial.print(".");
+    }
+    Serial.printf("\nConnected: %s\n\n", WiFi.localIP().toString().c_str());
+
+    buildUploadBody();
+
+    // ベンチマーク1: 1KBアップロード
+    Serial.printf("[1KB upload x %d]\n", REQUEST_COUNT);
+    float closeRate = benchUpload(false);
+    float keepAliveRate = benchUpload(true);
+    printComparison(closeRate, keepAliveRate);
+
+    // ベンチマーク2: 小さなGET（/api/status）
+    Serial.printf("\n[GET /api/status x %d]\n", REQUEST_COUNT);
+    closeRate = benchStatus(false);
+    keepAliveRate = benchStatus(true);
+    printComparison(closeRate, keepAliveRate);
+
+    Serial.println("\n=== Benchmark Completed ===\n");
+}
+
+void loop() {
+    delay(1000);
+}
+
+void buildUploadBody() {
+    uploadBody = String("--") + BOUNDARY + "\r\n";
+    uploadBody += "Content-Disposition: form-data; name=\"file\"; filename=\"bench.txt\"\r\n";
+    uploadBody += "Content-Type: text/plain\r\n\r\n";
+    for (size_t i = 0; i < UPLOAD_SIZE; i++) {
+        uploadBody += (char)('a' + (i % 26));
+    }
+    uploadBody += String("\r\n--") + BOUNDARY + "--\r\n";
+}
+
+float benchUpload(bool keepAlive) {
+    WiFiClient client;
+    HTTPClient http;
+    http.setReuse(keepAlive);
+
+    String url = String("http://") + SERVER_HOST + ":" + SERVER_PORT + "/api/upload";
+    String contentType = String("multipart/form-data; boundary=") + BOUNDARY;
+    int failures = 0;
+
+    unsigned long startTime = millis();
+    for (int i = 0; i < REQUEST_COUNT; i++) {
+        http.begin(client, url);
+        http.addHeader("Content-Type", contentType);
+        int code = http.POST((uint8_t*)uploadBody.c_str(), uploadBody.length());
+        if (code != 200) failures++;
+        http.getString();
+        http.end();
+    }
+    unsigned long elapsed = millis() - startTime;
+    client.stop();
+
+    float rate = elapsed > 0 ? REQUEST_COUNT * 1000.0f / elapsed : 0.0f;
+    Serial.printf("  %-10s %6lu ms  %6.1f req/s  (failures: %d)\n",
+                  keepAlive ? "keep-alive" : "close", elapsed, rate, failures);
+    return rate;
+}
+
+float benchStatus(bool keepAlive) {
+    WiFiClient client;
+    HTTPClient http;
+    http.setReuse(keepAlive);
+
+    String url = String("http://") + SERVER_HOST + ":" + SERVER_PORT + "/api/status";
+    int failures = 0;
+
+    unsigned long startTime = millis();
+    for (int i = 0; i < REQUEST_COUNT; i++) {
+        http.begin(client, url);
+        int code = http.GET();
+        if (code != 200) failures++;
+        http.getString();
+        http.end();
+    }
+    unsigned long elapsed = millis() - startTime;
+    client.stop();
+
+    float rate = elapsed > 0 ? REQUEST_COUNT * 1000.0f / elapsed : 0.0f;
+    Serial.printf("  %-10s %6lu ms  %6.1f req/s  (failures: %d)\n",
+                  keepAlive ? "keep-alive" : "close", elapsed, rate, failures);
+    return rate;
+}
+
+void printComparison(float closeRate, float keepAliveRate) {
+    if (closeRate > 0) {
+        Serial.printf("  speedup: x%.2f\n", keepAliveRate / closeRate);
+    }
+}
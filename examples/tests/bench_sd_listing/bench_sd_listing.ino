@@ -0,0 +1,109 @@
+/**
+ * ディレクトリ走査ベンチマークスケッチ
+ *
+ * SDカード上に FILE_COUNT 個のファイルを用意し、
+ * 従来の listFilesWithInfo()（エントリごとに getLastModified() で開き直す）と
+ * 1回の走査でサイズ・更新時刻を取る SDCardManager::forEachEntry() の
+ * 処理速度（エントリ/秒）を比較します。
+ */
+
+#include <M5Unified.h>
+#include "SDCardManager.h"
+
+const char* BENCH_DIR = "/bench_list";
+const int FILE_COUNT = 1000;
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== Directory Listing Benchmark ===\n");
+
+    if (!SDCardManager::initialize()) {
+        Serial.println("SD card initialization failed");
+        return;
+    }
+
+    prepareFiles();
+
+    // 詳細情報付き一覧（サイズ・更新時刻）
+    runBench("listFilesWithInfo (legacy, reopen per entry)", legacyListFilesWithInfo);
+    runBench("listFilesWithInfo (single pass)", []() {
+        return (uint32_t)SDCardManager::listFilesWithInfo(BENCH_DIR).size();
+    });
+
+    // ファイル数（名前のみ）
+    runBench("getFileCount (legacy, open per entry)", legacyGetFileCount);
+    runBench("getFileCount (names only)", []() {
+        return SDCardManager::getFileCount(BENCH_DIR);
+    });
+
+    Serial.println("\n=== Benchmark Completed ===\n");
+}
+
+void loop() {
+    delay(1000);
+}
+
+void prepareFiles() {
+    uint32_t existing = SDCardManager::getFileCount(BENCH_DIR);
+    if (existing >= FILE_COUNT) {
+        Serial.printf("Using %u existing files in %s\n", existing, BENCH_DIR);
+        return;
+    }
+
+    Serial.printf("Creating %d files in %s ...\n", FILE_COUNT, BENCH_DIR);
+    SDCardManager::createDir(BENCH_DIR);
+    char path[48];
+    for (int i = 0; i < FILE_COUNT; i++) {
+        snprintf(path, sizeof(path), "%s/file_%04d.txt", BENCH_DIR, i);
+        SDCardManager::writeText(path, "benchmark");
+    }
+}
+
+void runBench(const char* name, uint32_t (*fn)()) {
+    unsigned long startTime = millis();
+    uint32_t entries = fn();
+    unsigned long elapsed = millis() - startTime;
+    float rate = elapsed > 0 ? entries * 1000.0f / elapsed : 0.0f;
+    Serial.printf("  %-46s %5u entries  %6lu ms  %8.1f entries/s\n", name, entries, elapsed, rate);
+}
+
+// 変更前の listFilesWithInfo() と同じ処理（比較用）
+uint32_t legacyListFilesWithInfo() {
+    std::vector<FileInfo> list;
+    File dir = SD.open(BENCH_DIR);
+    if (!dir || !dir.isDirectory()) return 0;
+
+    File entry;
+    while (entry = dir.openNextFile()) {
+        FileInfo info;
+        info.name = String(entry.name());
+        info.size = entry.size();
+        String fullPath = String(BENCH_DIR) + "/" + entry.name();
+        info.modified = SDCardManager::getLastModified(fullPath.c_str());
+        info.isDirectory = entry.isDirectory();
+        info.extension = SDCardManager::getFileExtension(entry.name());
+        list.push_back(info);
+        entry.close();
+    }
+    dir.close();
+    return list.size();
+}
+
+// 変更前の getFileCount() と同じ処理（比較用）
+uint32_t legacyGetFileCount() {
+    File dir = SD.open(BENCH_DIR);
+    if (!dir || !dir.isDirectory()) return 0;
+
+    uint32_t count = 0;
+    File file = dir.openNextFile();
+    while (file) {
+        if (!file.isDirectory()) count++;
+        file = dir.openNextFile();
+    }
+    dir.close();
+    return count;
+}
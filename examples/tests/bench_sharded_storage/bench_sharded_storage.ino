@@ -0,0 +1,125 @@
+/**
+ * バケット配置ベンチマークスケッチ
+ *
+ * 1つのディレクトリに全ファイルを置く平坦な配置と、ShardedLayout で256個のバケットに
+ * 分けた配置それぞれに 1,000 / 10,000 / 50,000 個のファイルを用意し、
+ * SD.exists() と SD.open() の平均所要時間（マイクロ秒）を存在するファイル・存在しないファイルで比較します。
+ *
+ * ファイルは初回だけ作成し、次回以降は作成済みのファイルを使います
+ * （平坦な配置で50,000個を作成するには長い時間がかかります）。
+ */
+
+#include <M5Unified.h>
+#include "SDCardManager.h"
+#include "ShardedLayout.h"
+
+const char* FLAT_DIR = "/bench_flat";
+const char* SHARDED_DIR = "/bench_shard";
+const uint32_t FILE_COUNTS[] = {1000, 10000, 50000};
+const int SAMPLES = 200;
+
+ShardedLayout layout;
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== Sharded Storage Benchmark ===\n");
+
+    if (!SDCardManager::initialize()) {
+        Serial.println("SD card initialization failed");
+        return;
+    }
+
+    ShardedLayout flat;
+    layout.configure(256);
+    uint32_t conflicts = 0;
+    SDCardManager::createDir(FLAT_DIR);
+    SDCardManager::createDir(SHARDED_DIR);
+    layout.migrate(SHARDED_DIR, conflicts);  // バケットを作成
+
+    for (uint32_t count : FILE_COUNTS) {
+        Serial.printf("--- %u files ---\n", count);
+        prepareFiles(flat, FLAT_DIR, count);
+        prepareFiles(layout, SHARDED_DIR, count);
+
+        runBench("flat", flat, FLAT_DIR, count);
+        runBench("sharded (256 buckets)", layout, SHARDED_DIR, count);
+        Serial.println();
+    }
+
+    Serial.println("=== Benchmark Completed ===\n");
+}
+
+void loop() {
+    delay(1000);
+}
+
+String fileName(uint32_t i) {
+    char name[16];
+    snprintf(name, sizeof(name), "f%06u.dat", i);
+    return String(name);
+}
+
+// 連番で作成済みのファイル数を二分探索で求め、足りない分だけ作成する
+void prepareFiles(const ShardedLayout& storage, const char* root, uint32_t count) {
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (SD.exists(storage.filePath(root, fileName(mid).c_str()).c_str())) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low >= count) return;
+
+    Serial.printf("Creating files %u..%u in %s ...\n", low, count - 1, root);
+    unsigned long startTime = millis();
+    for (uint32_t i = low; i < count; i++) {
+        File file = SD.open(storage.filePath(root, fileName(i).c_str()).c_str(), FILE_WRITE);
+        if (!file) {
+            Serial.printf("Failed to create file %u\n", i);
+            return;
+        }
+        file.print("benchmark");
+        file.close();
+    }
+    Serial.printf("  created in %lu ms\n", millis() - startTime);
+}
+
+void runBench(const char* name, const ShardedLayout& storage, const char* root, uint32_t count) {
+    uint32_t existsHit = 0;
+    uint32_t existsMiss = 0;
+    uint32_t openHit = 0;
+    uint32_t openMiss = 0;
+
+    for (int i = 0; i < SAMPLES; i++) {
+        String hit = storage.filePath(root, fileName(esp_random() % count).c_str());
+        String miss = storage.filePath(root, ("missing" + String(i) + ".dat").c_str());
+
+        uint32_t start = micros();
+        SD.exists(hit.c_str());
+        existsHit += micros() - start;
+
+        start = micros();
+        SD.exists(miss.c_str());
+        existsMiss += micros() - start;
+
+        start = micros();
+        File file = SD.open(hit.c_str(), FILE_READ);
+        openHit += micros() - start;
+        if (file) file.close();
+
+        start = micros();
+        file = SD.open(miss.c_str(), FILE_READ);
+        openMiss += micros() - start;
+        if (file) file.close();
+    }
+
+    Serial.printf("  %-24s exists hit %7u us  miss %7u us  open hit %7u us  miss %7u us\n", name,
+                  existsHit / SAMPLES, existsMiss / SAMPLES, openHit / SAMPLES, openMiss / SAMPLES);
+}
@@ -0,0 +1,400 @@
+/**
+ * WebSocket アップロード ベンチマークスケッチ
+ *
+ * 2台目のESP32（M5Stack）をクライアントとして使い、
+ * M5StackWiFiUploader を実行中のサーバーへ同じ内容のファイルを
+ * HTTPマルチパート（/api/upload、keep-alive）と WebSocket（file_info + バイナリフレーム）で
+ * アップロードして、転送速度（KB/s）とファイルあたりの所要時間を比較します。
+ * WebSocket は1チャンネルで1ファイルずつ送る場合と、WS_CHANNELS 個のチャンネルで並行して送る場合を計測します。
+ * 各チャンネルはサーバーから受け取ったクレジット（ack の received + credit）を超えてチャンクを送りません。
+ * 最後に、クレジットを使い切った転送の途中で他のチャンネルを開き（サーバー側のウィンドウが縮む）、
+ * 与え済みのクレジットが取り消されずに完了することを確認します。
+ * また、ディレクトリインデックスの検証間隔（既定30秒）より長くかかる大きなファイルを送り、
+ * 受信中のファイルが外部からの変更と誤検出されない（/api/status の rebuilds・externalChanges が増えない）ことを確認します。
+ *
+ * 使用方法:
+ * 1. サーバー側で enableWebSocket(true) を呼び出したアップロード例を起動
+ * 2. このスケッチの WiFi 設定とサーバーのIPアドレスを設定して書き込み
+ * 3. シリアルモニタで結果を確認
+ */
+
+#include <M5Unified.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <WebSocketsClient.h>
+
+// WiFi設定
+const char* WIFI_SSID = "your_ssid";
+const char* WIFI_PASSWORD = "your_password";
+
+// サーバー設定
+const char* SERVER_HOST = "192.168.1.100";
+const uint16_t SERVER_PORT = 80;
+const uint16_t WS_PORT = 81;
+
+// ベンチマーク設定
+const size_t CHUNK_SIZE = 4096;
+const char* BOUNDARY = "----BenchWsUploadBoundary";
+const uint8_t WS_CHANNELS = 3;          // 並行送信で使うチャンネル数（サーバーの MAX_CONCURRENT_UPLOADS 以下）
+const size_t FRAME_HEADER_SIZE = 4;     // [チャンネル][フラグ][シーケンス番号（リトルエンディアン）]
+
+struct BenchCase {
+    const char* label;
+    size_t fileSize;
+    int fileCount;
+};
+
+const BenchCase CASES[] = {
+    {"4KB x 20", 4 * 1024, 20},
+    {"64KB x 10", 64 * 1024, 10},
+    {"1MB x 2", 1024 * 1024, 2},
+};
+
+// チャンネルごとの送信状態
+struct WsChannel {
+    int file;              // 送信中のファイル番号（-1は空き）
+    size_t sent;
+    uint32_t chunks;       // 送信したチャンク数（次のシーケンス番号）
+    uint32_t allowed;      // 送信してよいチャンク数（受信済み + クレジット）
+    bool accepted;         // file_info が受け付けられたか
+};
+
+uint8_t frame[FRAME_HEADER_SIZE + CHUNK_SIZE];
+uint8_t* const chunk = frame + FRAME_HEADER_SIZE;
+WebSocketsClient ws;
+volatile bool wsConnected = false;
+WsChannel wsChannels[WS_CHANNELS];
+int wsCompleted = 0;       // 完了（成功・失敗）したファイル数
+int wsFailures = 0;
+uint16_t wsMaxWindow = 0;
+uint32_t wsRevoked = 0;    // 送信してよいチャンク数が前の ack より減った回数（0であるべき）
+
+// マルチパートのボディを RAM に置かずに生成するストリーム
+class MultipartBodyStream : public Stream {
+public:
+    MultipartBodyStream(const String& filename, size_t size) : _size(size), _position(0) {
+        _head = String("--") + BOUNDARY + "\r\n";
+        _head += "Content-Disposition: form-data; name=\"file\"; filename=\"" + filename + "\"\r\n";
+        _head += "Content-Type: application/octet-stream\r\n\r\n";
+        _tail = String("\r\n--") + BOUNDARY + "--\r\n";
+    }
+
+    size_t length() const { return _head.length() + _size + _tail.length(); }
+
+    int available() override { return length() - _position; }
+    int peek() override { return _position < length() ? _byteAt(_position) : -1; }
+    int read() override { return _position < length() ? _byteAt(_position++) : -1; }
+    size_t readBytes(char* buffer, size_t count) override {
+        size_t n = 0;
+        while (n < count && _position < length()) {
+            buffer[n++] = _byteAt(_position++);
+        }
+        return n;
+    }
+    size_t write(uint8_t) override { return 0; }
+
+private:
+    String _head;
+    String _tail;
+    size_t _size;
+    size_t _position;
+
+    uint8_t _byteAt(size_t i) const {
+        if (i < _head.length()) return _head[i];
+        i -= _head.length();
+        if (i < _size) return chunk[i % CHUNK_SIZE];
+        return _tail[i - _size];
+    }
+};
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== WebSocket Upload Benchmark ===\n");
+
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    while (WiFi.status() != WL_CONNECTED) {
+        delay(500);
+        Serial.print(".");
+    }
+    Serial.printf("\nConnected: %s\n\n", WiFi.localIP().toString().c_str());
+
+    for (size_t i = 0; i < CHUNK_SIZE; i++) {
+        chunk[i] = (uint8_t)i;
+    }
+
+    ws.begin(SERVER_HOST, WS_PORT, "/");
+    ws.onEvent(onWsEvent);
+    unsigned long start = millis();
+    while (!wsConnected && millis() - start < 5000) {
+        ws.loop();
+    }
+    if (!wsConnected) {
+        Serial.println("WebSocket connection failed (enableWebSocket(true) on the server?)");
+        return;
+    }
+
+    for (const BenchCase& bench : CASES) {
+        Serial.printf("[%s]\n", bench.label);
+        float httpRate = benchHttp(bench);
+        float serialRate = benchWebSocket(bench, 1);
+        float pipelinedRate = benchWebSocket(bench, WS_CHANNELS);
+        if (httpRate > 0) {
+            Serial.printf("  speedup: x%.2f (1 channel), x%.2f (%u channels)\n\n", serialRate / httpRate,
+                          pipelinedRate / httpRate, WS_CHANNELS);
+        }
+    }
+
+    Serial.printf("[Window shrink] %s\n\n", testWindowShrink() ? "PASS" : "FAIL");
+    Serial.printf("[Index verify during upload] %s\n\n", testIndexVerify() ? "PASS" : "FAIL");
+
+    Serial.println("=== Benchmark Completed ===\n");
+}
+
+void loop() {
+    ws.loop();
+    delay(10);
+}
+
+void onWsEvent(WStype_t type, uint8_t* payload, size_t length) {
+    if (type == WStype_CONNECTED) {
+        wsConnected = true;
+    } else if (type == WStype_DISCONNECTED) {
+        wsConnected = false;
+    } else if (type == WStype_TEXT) {
+        String message((const char*)payload, length);
+        int start = message.indexOf("\"type\":\"") + 8;
+        String messageType = message.substring(start, message.indexOf('"', start));
+        uint32_t channel = jsonNumber(message, "channel");
+        if (channel >= WS_CHANNELS || wsChannels[channel].file < 0) return;
+
+        WsChannel& ch = wsChannels[channel];
+        if (messageType == "ack") {
+            uint32_t credit = jsonNumber(message, "credit");
+            uint32_t allowed = jsonNumber(message, "received") + credit;
+            if (allowed < ch.allowed) wsRevoked++;
+            ch.allowed = allowed;
+            ch.accepted = true;
+            if (credit > wsMaxWindow) wsMaxWindow = credit;
+        } else if (messageType == "complete") {
+            if (message.indexOf("\"success\":true") < 0) wsFailures++;
+            ch.file = -1;
+            wsCompleted++;
+        } else if (messageType == "error" && !ch.accepted) {
+            // file_info が拒否された（受け付け後の中止は complete(false) が続く）
+            wsFailures++;
+            ch.file = -1;
+            wsCompleted++;
+        }
+    }
+}
+
+uint32_t jsonNumber(const String& message, const char* key) {
+    int start = message.indexOf(String("\"") + key + "\":");
+    return start < 0 ? 0 : strtoul(message.c_str() + start + strlen(key) + 3, nullptr, 10);
+}
+
+void printResult(const char* name, unsigned long elapsed, const BenchCase& bench, int failures) {
+    float kb = bench.fileSize * bench.fileCount / 1024.0f;
+    Serial.printf("  %-10s %6lu ms  %7.1f KB/s  %6.1f ms/file  (failures: %d)\n", name, elapsed,
+                  elapsed > 0 ? kb * 1000.0f / elapsed : 0.0f, (float)elapsed / bench.fileCount, failures);
+}
+
+float benchHttp(const BenchCase& bench) {
+    WiFiClient client;
+    HTTPClient http;
+    http.setReuse(true);
+
+    String url = String("http://") + SERVER_HOST + ":" + SERVER_PORT + "/api/upload";
+    String contentType = String("multipart/form-data; boundary=") + BOUNDARY;
+    int failures = 0;
+
+    unsigned long startTime = millis();
+    for (int i = 0; i < bench.fileCount; i++) {
+        MultipartBodyStream body("bench_http_" + String(i) + ".bin", bench.fileSize);
+        http.begin(client, url);
+        http.addHeader("Content-Type", contentType);
+        int code = http.sendRequest("POST", &body, body.length());
+        if (code != 200) failures++;
+        http.getString();
+        http.end();
+    }
+    unsigned long elapsed = millis() - startTime;
+    client.stop();
+
+    printResult("HTTP", elapsed, bench, failures);
+    return elapsed > 0 ? bench.fileSize * bench.fileCount * 1000.0f / elapsed : 0.0f;
+}
+
+// チャンネル c で file_info を送り、送信状態を初期化する
+void startWsFile(uint8_t c, int file, const char* prefix, size_t fileSize) {
+    wsChannels[c] = {file, 0, 0, 0, false};
+    String info = String("{\"type\":\"file_info\",\"filename\":\"") + prefix + file + ".bin\",\"filesize\":" +
+                  fileSize + ",\"chunkSize\":" + CHUNK_SIZE + ",\"channel\":" + c + "}";
+    ws.sendTXT(info);
+}
+
+// クレジットが残っていればチャンネル c の次のフレーム（ヘッダー + データ）を送る
+bool sendWsFrame(uint8_t c, size_t fileSize) {
+    WsChannel& ch = wsChannels[c];
+    if (ch.file < 0 || !ch.accepted || ch.sent >= fileSize || ch.chunks >= ch.allowed) return false;
+
+    size_t length = fileSize - ch.sent < CHUNK_SIZE ? fileSize - ch.sent : CHUNK_SIZE;
+    frame[0] = c;
+    frame[1] = 0;
+    frame[2] = ch.chunks & 0xFF;
+    frame[3] = (ch.chunks >> 8) & 0xFF;
+    ws.sendBIN(frame, FRAME_HEADER_SIZE + length);
+    ch.sent += length;
+    ch.chunks++;
+    return true;
+}
+
+float benchWebSocket(const BenchCase& bench, uint8_t channels) {
+    uint32_t creditWaits = 0;
+    wsCompleted = 0;
+    wsFailures = 0;
+    wsMaxWindow = 0;
+    for (WsChannel& ch : wsChannels) {
+        ch.file = -1;
+    }
+
+    int nextFile = 0;
+    unsigned long startTime = millis();
+    unsigned long lastActivity = startTime;
+    while (wsCompleted < bench.fileCount && wsConnected) {
+        bool sent = false;
+        for (uint8_t c = 0; c < channels; c++) {
+            WsChannel& ch = wsChannels[c];
+            if (ch.file < 0) {
+                // 空いたチャンネルで次のファイルを送り始める
+                if (nextFile >= bench.fileCount) continue;
+                startWsFile(c, nextFile++, "bench_ws_", bench.fileSize);
+                sent = true;
+            } else if (sendWsFrame(c, bench.fileSize)) {
+                // クレジットを使い切ったら次の ack まで他のチャンネルを送る
+                if (ch.chunks >= ch.allowed && ch.sent < bench.fileSize) creditWaits++;
+                sent = true;
+            }
+        }
+        ws.loop();
+        if (sent) {
+            lastActivity = millis();
+        } else if (millis() - lastActivity > 30000) {
+            break;
+        }
+    }
+    unsigned long elapsed = millis() - startTime;
+    wsFailures += bench.fileCount - wsCompleted;
+
+    char name[16];
+    snprintf(name, sizeof(name), "WS x%u", channels);
+    printResult(name, elapsed, bench, wsFailures);
+    Serial.printf("             credit waits: %u, max window: %u chunks\n", (unsigned int)creditWaits, wsMaxWindow);
+    return elapsed > 0 ? bench.fileSize * bench.fileCount * 1000.0f / elapsed : 0.0f;
+}
+
+// チャンネル0でクレジットを全て送り切った直後に他のチャンネルを開き、サーバーのウィンドウを縮ませる
+// 与え済みのクレジットが取り消される（ack の received + credit が前の ack より減る）か、中止されると失敗する
+bool testWindowShrink() {
+    const size_t LARGE_SIZE = 512 * 1024;
+    const size_t SMALL_SIZE = 64 * 1024;
+    wsCompleted = 0;
+    wsFailures = 0;
+    wsRevoked = 0;
+    for (WsChannel& ch : wsChannels) {
+        ch.file = -1;
+    }
+
+    startWsFile(0, 0, "shrink_", LARGE_SIZE);
+    bool opened = false;
+    unsigned long lastActivity = millis();
+    while (wsCompleted < (opened ? WS_CHANNELS : 1) && wsConnected) {
+        bool sent = false;
+        while (sendWsFrame(0, LARGE_SIZE)) {
+            sent = true;
+        }
+        // ウィンドウが広がった後半で、クレジットを使い切った状態のまま他のチャンネルを開く
+        if (!opened && wsChannels[0].sent >= LARGE_SIZE / 2) {
+            for (uint8_t c = 1; c < WS_CHANNELS; c++) {
+                startWsFile(c, c, "shrink_", SMALL_SIZE);
+            }
+            opened = true;
+        }
+        for (uint8_t c = 1; c < WS_CHANNELS; c++) {
+            sent = sendWsFrame(c, SMALL_SIZE) || sent;
+        }
+        ws.loop();
+        if (sent) {
+            lastActivity = millis();
+        } else if (millis() - lastActivity > 30000) {
+            break;
+        }
+    }
+
+    Serial.printf("  completed: %d, failures: %d, revoked credit: %u\n", wsCompleted, wsFailures,
+                  (unsigned int)wsRevoked);
+    return opened && wsCompleted == WS_CHANNELS && wsFailures == 0 && wsRevoked == 0;
+}
+
+// /api/status の directoryIndex から rebuilds と externalChanges を読む
+bool readIndexStats(uint32_t& rebuilds, uint32_t& externalChanges) {
+    WiFiClient client;
+    HTTPClient http;
+    http.begin(client, String("http://") + SERVER_HOST + ":" + SERVER_PORT + "/api/status");
+    int code = http.GET();
+    String body = code == 200 ? http.getString() : String();
+    http.end();
+
+    int start = body.indexOf("\"directoryIndex\":");
+    if (start < 0) return false;
+    String index = body.substring(start, body.indexOf('}', start));
+    rebuilds = jsonNumber(index, "rebuilds");
+    externalChanges = jsonNumber(index, "externalChanges");
+    return true;
+}
+
+// 検証間隔より長い WebSocket アップロードの間に、インデックスの作り直しが起きないことを確認する
+bool testIndexVerify() {
+    const size_t FILE_SIZE = 16 * 1024 * 1024;
+    uint32_t rebuildsBefore, externalBefore, rebuildsAfter, externalAfter;
+    if (!readIndexStats(rebuildsBefore, externalBefore)) {
+        Serial.println("  directoryIndex not in /api/status (ENABLE_DIRECTORY_INDEX disabled?)");
+        return false;
+    }
+
+    wsCompleted = 0;
+    wsFailures = 0;
+    for (WsChannel& ch : wsChannels) {
+        ch.file = -1;
+    }
+    startWsFile(0, 0, "verify_", FILE_SIZE);
+    unsigned long startTime = millis();
+    unsigned long lastActivity = startTime;
+    while (wsCompleted < 1 && wsConnected) {
+        bool sent = false;
+        while (sendWsFrame(0, FILE_SIZE)) {
+            sent = true;
+        }
+        ws.loop();
+        if (sent) {
+            lastActivity = millis();
+        } else if (millis() - lastActivity > 30000) {
+            break;
+        }
+    }
+    unsigned long elapsed = millis() - startTime;
+
+    if (!readIndexStats(rebuildsAfter, externalAfter)) return false;
+    Serial.printf("  %u KB in %lu ms, rebuilds: %u -> %u, externalChanges: %u -> %u\n",
+                  (unsigned int)(FILE_SIZE / 1024), elapsed, (unsigned int)rebuildsBefore,
+                  (unsigned int)rebuildsAfter, (unsigned int)externalBefore, (unsigned int)externalAfter);
+    if (elapsed < 30000) {
+        Serial.println("  (upload finished within the verify interval, result is not conclusive)");
+    }
+    return wsCompleted == 1 && wsFailures == 0 && rebuildsAfter == rebuildsBefore &&
+           externalAfter == externalBefore;
+}
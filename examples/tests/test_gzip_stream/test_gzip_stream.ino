@@ -0,0 +1,144 @@
+/**
+ * GzipStream テストスケッチ
+ *
+ * このスケッチは GzipStream クラスの圧縮結果を
+ * ESP32 ROM内蔵のinflate（miniz tinfl）で展開して検証します。
+ */
+
+#include <M5Unified.h>
+#include "GzipStream.h"
+#include "rom/miniz.h"
+#include <vector>
+
+std::vector<uint8_t> compressed;
+
+void setup() {
+    auto cfg = M5.config();
+    M5.begin(cfg);
+    Serial.begin(115200);
+    delay(1000);
+
+    Serial.println("\n=== GzipStream Test Suite ===\n");
+
+    // テスト1: ログ形式テキストの往復
+    testLogRoundTrip();
+
+    // テスト2: 空入力
+    testEmptyInput();
+
+    // テスト3: 窓サイズを超える繰り返し
+    testLongRepeat();
+
+    // テスト4: 圧縮速度
+    testThroughput();
+
+    Serial.println("\n=== All Tests Completed ===\n");
+}
+
+void loop() {
+    delay(1000);
+}
+
+bool compress(const uint8_t* data, size_t length, size_t step) {
+    compressed.clear();
+    GzipStream gzip;
+    bool ok = gzip.begin([](const uint8_t* out, size_t n) {
+        compressed.insert(compressed.end(), out, out + n);
+        return true;
+    });
+    for (size_t pos = 0; ok && pos < length; pos += step) {
+        size_t n = (length - pos) < step ? (length - pos) : step;
+        ok = gzip.write(data + pos, n);
+    }
+    return ok && gzip.finish();
+}
+
+bool verify(const uint8_t* original, size_t length) {
+    // gzipヘッダー（10バイト）とトレーラー（8バイト）を除いた生deflateを展開
+    if (compressed.size() < 18 || compressed[0] != 0x1F || compressed[1] != 0x8B) {
+        return false;
+    }
+    uint8_t* out = (uint8_t*)malloc(length + 1);
+    size_t n = tinfl_decompress_mem_to_mem(out, length + 1, compressed.data() + 10,
+                                           compressed.size() - 18, 0);
+    bool ok = (n == length) && memcmp(out, original, length) == 0;
+
+    uint32_t isize = compressed[compressed.size() - 4] | (compressed[compressed.size() - 3] << 8) |
+                     (compressed[compressed.size() - 2] << 16) | (compressed[compressed.size() - 1] << 24);
+    free(out);
+    return ok && isize == length;
+}
+
+void testLogRoundTrip() {
+    Serial.println("Test 1: Log Text Round Trip");
+
+    String text;
+    for (int i = 0; i < 400; i++) {
+        text += "2026-10-18 12:00:" + String(i % 60) + " INFO sensor" + String(i % 7) +
+                " temp=" + String(200 + (i * 37) % 100) + " status=OK\n";
+    }
+
+    bool ok = compress((const uint8_t*)text.c_str(), text.length(), 333);
+    if (ok && verify((const uint8_t*)text.c_str(), text.length())) {
+        Serial.printf("✓ Round trip OK (%u -> %u bytes)\n", text.length(), compressed.size());
+    } else {
+        Serial.println("✗ Round trip failed");
+    }
+
+    Serial.println();
+}
+
+void testEmptyInput() {
+    Serial.println("Test 2: Empty Input");
+
+    bool ok = compress(nullptr, 0, 1);
+    if (ok && verify((const uint8_t*)"", 0)) {
+        Serial.printf("✓ Empty stream OK (%u bytes)\n", compressed.size());
+    } else {
+        Serial.println("✗ Empty stream failed");
+    }
+
+    Serial.println();
+}
+
+void testLongRepeat() {
+    Serial.println("Test 3: Long Repeat Beyond Window");
+
+    const size_t length = 20000;
+    uint8_t* data = (uint8_t*)malloc(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = "abcdefgh"[i % 8] ^ ((i / 5000) & 1);
+    }
+
+    bool ok = compress(data, length, 4096);
+    if (ok && verify(data, length)) {
+        Serial.printf("✓ Repeat OK (%u -> %u bytes)\n", length, compressed.size());
+    } else {
+        Serial.println("✗ Repeat failed");
+    }
+    free(data);
+
+    Serial.println();
+}
+
+void testThroughput() {
+    Serial.println("Test 4: Throughput");
+
+    const size_t length = 64 * 1024;
+    uint8_t* data = (uint8_t*)malloc(length);
+    for (size_t i = 0; i < length; i++) {
+        data[i] = 'A' + (i * 7 + i / 13) % 26;
+    }
+
+    unsigned long start = millis();
+    compress(data, length, 4096);
+    unsigned long elapsed = millis() - start;
+    free(data);
+
+    Serial.printf("  %u bytes in %lu ms (%.1f KB/s), ratio %.2f\n", length, elapsed,
+                  elapsed > 0 ? (length / 1024.0f) * 1000.0f / elapsed : 0.0f,
+                  (float)length / compressed.size());
+    Serial.printf("  Work memory: %u bytes\n", GzipStream::getMemoryUsage());
+
+    Serial.println();
+}
@@ -0,0 +1,317 @@
+#include "ArchiveStreamer.h"
+#include <esp_rom_crc.h>
+#include <time.h>
+
+// ============================================================================
+// アーカイブ定数
+// ============================================================================
+#define TAR_BLOCK_SIZE 512
+#define TAR_NAME_LENGTH 100
+
+#define ZIP_LOCAL_HEADER_SIG 0x04034B50
+#define ZIP_DATA_DESCRIPTOR_SIG 0x08074B50
+#define ZIP_CENTRAL_HEADER_SIG 0x02014B50
+#define ZIP_END_OF_CENTRAL_SIG 0x06054B50
+#define ZIP_VERSION 20
+#define ZIP_FLAGS 0x0808  // bit3: データディスクリプタ, bit11: UTF-8ファイル名
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+ArchiveStreamer::ArchiveStreamer()
+    : _format(ARCHIVE_ZIP),
+      _output(nullptr),
+      _buffer(nullptr),
+      _bufferSize(0),
+      _length(0),
+      _offset(0),
+      _entryCount(0),
+      _ok(false) {
+}
+
+ArchiveStreamer::~ArchiveStreamer() {
+    end();
+}
+
+// ============================================================================
+// 出力
+// ============================================================================
+
+bool ArchiveStreamer::begin(ArchiveFormat format, ArchiveOutputCallback output, size_t bufferSize) {
+    end();
+
+    // tarのブロック境界とSDセクタに合わせる
+    _bufferSize = ((max(bufferSize, (size_t)TAR_BLOCK_SIZE) + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE) * TAR_BLOCK_SIZE;
+    _buffer = (uint8_t*)malloc(_bufferSize);
+    if (!_buffer) {
+        return false;
+    }
+
+    _format = format;
+    _output = output;
+    _length = 0;
+    _offset = 0;
+    _entryCount = 0;
+    _ok = true;
+    return true;
+}
+
+bool ArchiveStreamer::addFile(const String& name, File& file) {
+    if (!_buffer || !_ok) return false;
+    if (_entryCount >= MAX_ARCHIVE_ENTRIES) return false;
+
+    uint32_t size = file.size();
+    time_t mtime = file.getLastWrite();
+    uint32_t crc = 0;
+    uint32_t copied = 0;
+
+    if (_format == ARCHIVE_TAR) {
+        // 100バイトを超える名前はGNU拡張（././@LongLink）で前置
+        if (name.length() >= TAR_NAME_LENGTH) {
+            _writeTarHeader("././@LongLink", name.length() + 1, 0, 'L');
+            _put(name.c_str(), name.length() + 1);
+            _putZero((TAR_BLOCK_SIZE - (name.length() + 1) % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+        }
+        _writeTarHeader(name.c_str(), size, mtime, '0');
+
+        // ヘッダーで宣言したサイズを必ず出力（読み込みが途中で失敗した場合はゼロで埋める）
+        _copyData(file, size, true, crc, copied);
+        _putZero((TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE);
+    } else {
+        // オフセットが32ビットを超える場合はZIP64が必要になるため追加しない
+        if ((uint64_t)_offset + size + 2 * name.length() + 128 > 0xFFFFFFFFull) {
+            return false;
+        }
+
+        ZipEntry entry;
+        entry.name = name;
+        entry.offset = _offset;
+        _toDosTime(mtime, entry.dosTime, entry.dosDate);
+        _writeZipLocalHeader(entry);
+
+        // サイズとCRCは実際に送信したバイトから求め、データディスクリプタに記録
+        _copyData(file, size, false, crc, copied);
+        entry.crc = crc;
+        entry.size = copied;
+        _putLE32(ZIP_DATA_DESCRIPTOR_SIG);
+        _putLE32(entry.crc);
+        _putLE32(entry.size);
+        _putLE32(entry.size);
+        _entries.push_back(entry);
+    }
+
+    _entryCount++;
+    return _ok;
+}
+
+bool ArchiveStreamer::finish() {
+    if (!_buffer || !_ok) return false;
+
+    if (_format == ARCHIVE_TAR) {
+        // 終端は2つの空ブロック
+        _putZero(2 * TAR_BLOCK_SIZE);
+    } else {
+        _writeZipCentralDirectory();
+    }
+    _flush();
+    return _ok;
+}
+
+void ArchiveStreamer::end() {
+    if (_buffer) {
+        free(_buffer);
+        _buffer = nullptr;
+    }
+    _entries.clear();
+    _entries.shrink_to_fit();
+    _output = nullptr;
+}
+
+const char* ArchiveStreamer::getContentType(ArchiveFormat format) {
+    return format == ARCHIVE_TAR ? "application/x-tar" : "application/zip";
+}
+
+const char* ArchiveStreamer::getExtension(ArchiveFormat format) {
+    return format == ARCHIVE_TAR ? "tar" : "zip";
+}
+
+// ============================================================================
+// プライベートメソッド - ファイル本体
+// ============================================================================
+
+bool ArchiveStreamer::_copyData(File& file, uint32_t size, bool padToSize, uint32_t& crc, uint32_t& copied) {
+    // 作業バッファの空き領域へ直接読み込み、ヘッダーと同じチャンクで送信する
+    copied = 0;
+    while (copied < size && _ok) {
+        if (_length == _bufferSize) {
+            _flush();
+            continue;
+        }
+        size_t space = _bufferSize - _length;
+        size_t want = (size - copied) < space ? (size - copied) : space;
+        size_t n = file.read(_buffer + _length, want);
+        if (n == 0) {
+            break;
+        }
+        crc = esp_rom_crc32_le(crc, _buffer + _length, n);
+        _length += n;
+        _offset += n;
+        copied += n;
+    }
+
+    if (copied < size && padToSize) {
+        _putZero(size - copied);
+    }
+    return copied == size;
+}
+
+// ============================================================================
+// プライベートメソッド - tar
+// ============================================================================
+
+void ArchiveStreamer::_writeTarHeader(const char* name, uint32_t size, time_t mtime, char type) {
+    uint8_t header[TAR_BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+
+    strncpy((char*)header, name, TAR_NAME_LENGTH);            // name
+    memcpy(header + 100, "0000644", 7);                        // mode
+    memcpy(header + 108, "0000000", 7);                        // uid
+    memcpy(header + 116, "0000000", 7);                        // gid
+    snprintf((char*)header + 124, 12, "%011lo", (unsigned long)size);
+    snprintf((char*)header + 136, 12, "%011lo", (unsigned long)mtime);
+    header[156] = type;                                        // typeflag
+    memcpy(header + 257, "ustar", 6);                          // magic
+    memcpy(header + 263, "00", 2);                             // version
+
+    // チェックサムはチェックサム欄を空白とみなして計算
+    memset(header + 148, ' ', 8);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < sizeof(header); i++) {
+        sum += header[i];
+    }
+    snprintf((char*)header + 148, 8, "%06lo", (unsigned long)sum);
+    header[155] = ' ';
+
+    _put(header, sizeof(header));
+}
+
+// ============================================================================
+// プライベートメソッド - zip
+// ============================================================================
+
+void ArchiveStreamer::_writeZipLocalHeader(const ZipEntry& entry) {
+    _putLE32(ZIP_LOCAL_HEADER_SIG);
+    _putLE16(ZIP_VERSION);
+    _putLE16(ZIP_FLAGS);
+    _putLE16(0);  // 無圧縮（stored）
+    _putLE16(entry.dosTime);
+    _putLE16(entry.dosDate);
+    _putLE32(0);  // CRC32・サイズはデータディスクリプタに記録
+    _putLE32(0);
+    _putLE32(0);
+    _putLE16(entry.name.length());
+    _putLE16(0);
+    _put(entry.name.c_str(), entry.name.length());
+}
+
+void ArchiveStreamer::_writeZipCentralDirectory() {
+    uint32_t centralOffset = _offset;
+
+    for (const auto& entry : _entries) {
+        _putLE32(ZIP_CENTRAL_HEADER_SIG);
+        _putLE16(ZIP_VERSION);
+        _putLE16(ZIP_VERSION);
+        _putLE16(ZIP_FLAGS);
+        _putLE16(0);
+        _putLE16(entry.dosTime);
+        _putLE16(entry.dosDate);
+        _putLE32(entry.crc);
+        _putLE32(entry.size);
+        _putLE32(entry.size);
+        _putLE16(entry.name.length());
+        _putLE16(0);  // 拡張フィールド長
+        _putLE16(0);  // コメント長
+        _putLE16(0);  // ディスク番号
+        _putLE16(0);  // 内部属性
+        _putLE32(0);  // 外部属性
+        _putLE32(entry.offset);
+        _put(entry.name.c_str(), entry.name.length());
+    }
+
+    uint32_t centralSize = _offset - centralOffset;
+    _putLE32(ZIP_END_OF_CENTRAL_SIG);
+    _putLE16(0);
+    _putLE16(0);
+    _putLE16(_entries.size());
+    _putLE16(_entries.size());
+    _putLE32(centralSize);
+    _putLE32(centralOffset);
+    _putLE16(0);
+}
+
+void ArchiveStreamer::_toDosTime(time_t t, uint16_t& dosTime, uint16_t& dosDate) {
+    struct tm tmInfo;
+    gmtime_r(&t, &tmInfo);
+
+    // MS-DOS日付は1980年以降のみ表現できる
+    if (tmInfo.tm_year < 80) {
+        dosTime = 0;
+        dosDate = (1 << 5) | 1;  // 1980-01-01
+        return;
+    }
+    dosTime = (tmInfo.tm_hour << 11) | (tmInfo.tm_min << 5) | (tmInfo.tm_sec / 2);
+    dosDate = ((tmInfo.tm_year - 80) << 9) | ((tmInfo.tm_mon + 1) << 5) | tmInfo.tm_mday;
+}
+
+// ============================================================================
+// プライベートメソッド - バッファ
+// ============================================================================
+
+void ArchiveStreamer::_put(const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (length > 0 && _ok) {
+        if (_length == _bufferSize) {
+            _flush();
+        }
+        size_t n = min(length, _bufferSize - _length);
+        memcpy(_buffer + _length, p, n);
+        _length += n;
+        _offset += n;
+        p += n;
+        length -= n;
+    }
+}
+
+void ArchiveStreamer::_putZero(size_t length) {
+    while (length > 0 && _ok) {
+        if (_length == _bufferSize) {
+            _flush();
+        }
+        size_t n = min(length, _bufferSize - _length);
+        memset(_buffer + _length, 0, n);
+        _length += n;
+        _offset += n;
+        length -= n;
+    }
+}
+
+void ArchiveStreamer::_putLE16(uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)(value & 0xFF), (uint8_t)(value >> 8) };
+    _put(bytes, sizeof(bytes));
+}
+
+void ArchiveStreamer::_putLE32(uint32_t value) {
+    uint8_t bytes[4] = {
+        (uint8_t)(value & 0xFF), (uint8_t)((value >> 8) & 0xFF),
+        (uint8_t)((value >> 16) & 0xFF), (uint8_t)(value >> 24)
+    };
+    _put(bytes, sizeof(bytes));
+}
+
+void ArchiveStreamer::_flush() {
+    if (_length > 0 && _ok) {
+        _ok = _output(_buffer, _length);
+    }
+    _length = 0;
+}
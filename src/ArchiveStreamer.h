@@ -0,0 +1,122 @@
+#ifndef ARCHIVE_STREAMER_H
+#define ARCHIVE_STREAMER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <vector>
+#include "Config.h"
+
+// ============================================================================
+// 出力コールバック（falseを返すと書き出しを中断）
+// ============================================================================
+typedef std::function<bool(const uint8_t* data, size_t length)> ArchiveOutputCallback;
+
+// ============================================================================
+// アーカイブ形式
+// ============================================================================
+enum ArchiveFormat {
+    ARCHIVE_TAR = 0,  // POSIX ustar（長いファイル名はGNU拡張）
+    ARCHIVE_ZIP = 1   // 無圧縮（stored）ZIP、データディスクリプタ付き
+};
+
+/**
+ * @brief 複数ファイルを一時ファイルなしでアーカイブとして逐次出力するクラス
+ *
+ * ヘッダーとファイル本体を1つの作業バッファに詰めて出力します。
+ * ZIPのCRC32はファイル本体の送信と同時に計算し、データディスクリプタと
+ * セントラルディレクトリに書き込むため、SDカードを2回読む必要はありません。
+ */
+class ArchiveStreamer {
+public:
+    ArchiveStreamer();
+    ~ArchiveStreamer();
+
+    /**
+     * @brief 作業バッファを確保して出力を開始
+     * @param format アーカイブ形式
+     * @param output 出力コールバック
+     * @param bufferSize 作業バッファサイズ（512バイト単位に切り上げ）
+     * @return 確保成功時true
+     */
+    bool begin(ArchiveFormat format, ArchiveOutputCallback output, size_t bufferSize = ARCHIVE_BUFFER_SIZE);
+
+    /**
+     * @brief ファイルをアーカイブに追加
+     * @param name アーカイブ内のファイル名
+     * @param file 読み込み用に開いたファイル
+     * @return 追加できなかった場合false（isOk() == false なら出力の失敗で以降の追加・finish()は無効、
+     *         true ならエントリ数・zipのサイズの上限で、このファイルを除いて続けられる）
+     */
+    bool addFile(const String& name, File& file);
+
+    /**
+     * @brief 終端レコード（tar: 空ブロック / zip: セントラルディレクトリ）を出力
+     * @return 出力成功時true
+     */
+    bool finish();
+
+    /**
+     * @brief 作業バッファとエントリ情報を解放
+     */
+    void end();
+
+    /**
+     * @brief 出力に失敗していないかチェック
+     */
+    bool isOk() const { return _buffer && _ok; }
+
+    /**
+     * @brief 追加したファイル数を取得
+     */
+    uint16_t getEntryCount() const { return _entryCount; }
+
+    /**
+     * @brief 出力バイト数を取得
+     */
+    uint32_t getOutputSize() const { return _offset; }
+
+    /**
+     * @brief 形式に対応するMIMEタイプを取得
+     */
+    static const char* getContentType(ArchiveFormat format);
+
+    /**
+     * @brief 形式に対応する拡張子を取得（ドットなし）
+     */
+    static const char* getExtension(ArchiveFormat format);
+
+private:
+    // セントラルディレクトリ用のエントリ情報（ZIPのみ）
+    struct ZipEntry {
+        String name;
+        uint32_t crc;
+        uint32_t size;
+        uint32_t offset;
+        uint16_t dosTime;
+        uint16_t dosDate;
+    };
+
+    ArchiveFormat _format;
+    ArchiveOutputCallback _output;
+    uint8_t* _buffer;
+    size_t _bufferSize;
+    size_t _length;
+    uint32_t _offset;
+    uint16_t _entryCount;
+    bool _ok;
+    std::vector<ZipEntry> _entries;
+
+    bool _copyData(File& file, uint32_t size, bool padToSize, uint32_t& crc, uint32_t& copied);
+    void _writeTarHeader(const char* name, uint32_t size, time_t mtime, char type);
+    void _writeZipLocalHeader(const ZipEntry& entry);
+    void _writeZipCentralDirectory();
+    void _put(const void* data, size_t length);
+    void _putZero(size_t length);
+    void _putLE16(uint16_t value);
+    void _putLE32(uint32_t value);
+    void _flush();
+    static void _toDosTime(time_t t, uint16_t& dosTime, uint16_t& dosDate);
+};
+
+#endif // ARCHIVE_STREAMER_H
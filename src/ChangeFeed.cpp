@@ -0,0 +1,176 @@
+#include "ChangeFeed.h"
+#include <time.h>
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+ChangeFeed::ChangeFeed()
+    : _capacity(DEFAULT_CHANGE_FEED_CAPACITY),
+      _head(0),
+      _count(0),
+      _latest(0),
+      _floor(0),
+      _feedId(0),
+      _maxWaiters(DEFAULT_MAX_CHANGE_WAITERS) {
+}
+
+ChangeFeed::~ChangeFeed() {
+    closeAll();
+}
+
+// ============================================================================
+// 設定・記録
+// ============================================================================
+
+void ChangeFeed::configure(uint16_t capacity, uint8_t maxWaiters) {
+    closeAll();
+    _capacity = capacity > 0 ? capacity : 1;
+    _maxWaiters = maxWaiters;
+    _ring.clear();
+    _ring.shrink_to_fit();
+    _head = 0;
+    _count = 0;
+    _floor = _latest;
+}
+
+uint32_t ChangeFeed::record(ChangeType type, const String& name, uint32_t size) {
+    // リングは最初の記録時に確保する（変更のない構成ではメモリを使わない）
+    if (_ring.size() != _capacity) {
+        _ring.resize(_capacity);
+    }
+
+    ChangeRecord& slot = _ring[_head];
+    if (_count == _capacity) {
+        // 最も古い変更を押し出す（それ以前の連番からは差分を返せなくなる）
+        _floor = slot.sequence;
+    } else {
+        _count++;
+    }
+
+    slot.sequence = ++_latest;
+    slot.type = type;
+    slot.size = type == CHANGE_DELETE ? 0 : size;
+    slot.time = time(nullptr);
+    slot.name = name;
+    _head = (_head + 1) % _capacity;
+
+    // 待機中のクライアントへの応答は loop() でまとめて行う（一括操作の変更を1回の応答にまとめる）
+    return _latest;
+}
+
+void ChangeFeed::reset() {
+    for (auto& slot : _ring) {
+        slot.name = String();
+    }
+    _head = 0;
+    _count = 0;
+    // 連番を進め、最新まで受け取り済みのクライアント（待機中を含む）にも reset を返す
+    _floor = ++_latest;
+}
+
+// ============================================================================
+// 差分の出力
+// ============================================================================
+
+void ChangeFeed::writeChanges(JsonWriter& json, uint32_t since) const {
+    char feedId[12];
+    snprintf(feedId, sizeof(feedId), "%08x", (unsigned int)_feedId);
+    bool expired = isExpired(since);
+
+    json.beginObject();
+    json.field("feedId", feedId);
+    json.field("since", since);
+    json.field("latest", _latest);
+    json.field("reset", expired);
+    json.key("changes");
+    json.beginArray();
+    if (!expired) {
+        // リングの古い方から順に、since より後の変更だけを書き出す
+        uint16_t start = (_head + _capacity - _count) % _capacity;
+        for (uint16_t i = 0; i < _count; i++) {
+            const ChangeRecord& record = _ring[(start + i) % _capacity];
+            if (record.sequence <= since) continue;
+            json.beginObject();
+            json.field("seq", record.sequence);
+            json.field("type", getTypeName(record.type));
+            json.field("name", record.name);
+            json.field("size", record.size);
+            json.field("time", (unsigned long)record.time);
+            json.endObject();
+        }
+    }
+    json.endArray();
+    json.endObject();
+}
+
+const char* ChangeFeed::getTypeName(ChangeType type) {
+    switch (type) {
+        case CHANGE_CREATE: return "create";
+        case CHANGE_MODIFY: return "modify";
+        case CHANGE_DELETE: return "delete";
+    }
+    return "unknown";
+}
+
+// ============================================================================
+// 待機クライアント
+// ============================================================================
+
+bool ChangeFeed::addWaiter(const WiFiClient& client, uint32_t since, uint32_t timeoutMs) {
+    if (!canWait()) return false;
+
+    ChangeWaiter waiter;
+    waiter.client = client;
+    waiter.since = since;
+    waiter.startTime = millis();
+    waiter.timeout = timeoutMs;
+    _waiters.push_back(waiter);
+    return true;
+}
+
+void ChangeFeed::loop() {
+    if (_waiters.empty()) return;
+
+    unsigned long now = millis();
+    for (auto it = _waiters.begin(); it != _waiters.end();) {
+        if (!it->client.connected()) {
+            it->client.stop();
+            it = _waiters.erase(it);
+        } else if (hasUpdate(it->since) || now - it->startTime >= it->timeout) {
+            _respond(*it);
+            it = _waiters.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ChangeFeed::closeAll() {
+    for (auto& waiter : _waiters) {
+        _respond(waiter);
+    }
+    _waiters.clear();
+}
+
+void ChangeFeed::_respond(ChangeWaiter& waiter) {
+    if (waiter.client.connected()) {
+        // 本文の長さは事前に分からないため、接続を閉じて終わりを示す
+        static const char header[] =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n"
+            "\r\n";
+        waiter.client.write((const uint8_t*)header, sizeof(header) - 1);
+
+        char buffer[CHANGE_FEED_BUFFER_SIZE];
+        WiFiClient& client = waiter.client;
+        JsonWriter json(buffer, sizeof(buffer), [&client](const char* data, size_t length) {
+            return client.write((const uint8_t*)data, length) == length;
+        });
+        writeChanges(json, waiter.since);
+        json.flush();
+    }
+    waiter.client.stop();
+}
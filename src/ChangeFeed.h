@@ -0,0 +1,140 @@
+#ifndef CHANGE_FEED_H
+#define CHANGE_FEED_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <vector>
+#include "Config.h"
+#include "JsonWriter.h"
+
+// 変更の種類
+enum ChangeType : uint8_t {
+    CHANGE_CREATE,
+    CHANGE_MODIFY,
+    CHANGE_DELETE
+};
+
+// ============================================================================
+// 変更記録
+// ============================================================================
+struct ChangeRecord {
+    uint32_t sequence;          // 連番（1から始まり、起動中は単調増加）
+    ChangeType type;
+    uint32_t size;              // 変更後のサイズ（削除は0）
+    time_t time;                // 記録した時刻（時計が未設定なら起動からの秒数）
+    String name;                // アップロードディレクトリからの相対パス
+};
+
+// ============================================================================
+// 変更待ちのクライアント
+// ============================================================================
+struct ChangeWaiter {
+    WiFiClient client;          // 切り離したクライアント（レスポンス未送信）
+    uint32_t since;             // クライアントが受け取り済みの連番
+    unsigned long startTime;
+    uint32_t timeout;           // 変更がないまま空の結果を返すまでの時間（ミリ秒）
+};
+
+/**
+ * @brief ファイルの作成・更新・削除を連番付きで記録する変更フィード
+ *
+ * 書き込み側（アップロード・削除・追記・リネーム）から変更を受け取り、固定長のリングに保持します。
+ * クライアントは受け取り済みの連番を since に指定して差分だけを取得し、
+ * 変更がなければ切り離した接続のまま待たせておき、loop() で変更またはタイムアウトを検出して応答します。
+ *
+ * リングから押し出された連番（または起動前の連番）を指定された場合は "reset": true を返し、
+ * クライアントは一覧を取り直してから latest を since として続けます。
+ */
+class ChangeFeed {
+public:
+    ChangeFeed();
+    ~ChangeFeed();
+
+    /**
+     * @brief 上限を設定（保持している変更は破棄し、待機中のクライアントには応答する）
+     * @param capacity リングに保持する変更の件数
+     * @param maxWaiters 同時に待機できるクライアント数
+     */
+    void configure(uint16_t capacity, uint8_t maxWaiters);
+
+    /**
+     * @brief フィードの識別子を設定（起動ごとに変わる値、クライアントは変化したら一覧を取り直す）
+     */
+    void setFeedId(uint32_t feedId) { _feedId = feedId; }
+
+    /**
+     * @brief 変更を記録
+     * @return 割り当てた連番
+     */
+    uint32_t record(ChangeType type, const String& name, uint32_t size);
+
+    /**
+     * @brief 記録を破棄し、これまでの連番からの差分は取得できないものとする
+     * @note 外部からの変更を検出した場合など、個々の変更を記録できなかったときに呼び出す
+     */
+    void reset();
+
+    /**
+     * @brief since より後の変更があるか、または差分を返せない（reset になる）か
+     */
+    bool hasUpdate(uint32_t since) const { return since != _latest; }
+
+    /**
+     * @brief since からの差分を返せないか（リングから押し出された・起動前の連番）
+     */
+    bool isExpired(uint32_t since) const { return since < _floor || since > _latest; }
+
+    /**
+     * @brief since より後の変更をJSONオブジェクトとして書き出す
+     */
+    void writeChanges(JsonWriter& json, uint32_t since) const;
+
+    /**
+     * @brief 新しい待機クライアントを受け付けられるか判定
+     */
+    bool canWait() const { return _waiters.size() < _maxWaiters; }
+
+    /**
+     * @brief 変更を待つクライアントを登録（変更がないことを確認してから呼び出す）
+     * @param client 切り離したクライアント
+     * @param since クライアントが受け取り済みの連番
+     * @param timeoutMs 空の結果を返すまでの時間（ミリ秒）
+     */
+    bool addWaiter(const WiFiClient& client, uint32_t since, uint32_t timeoutMs);
+
+    /**
+     * @brief 変更・タイムアウト・切断を処理（handleClient から定期的に呼び出す）
+     */
+    void loop();
+
+    /**
+     * @brief 待機中の全クライアントに現在の結果を返して終了
+     */
+    void closeAll();
+
+    uint32_t getLatestSequence() const { return _latest; }
+    uint16_t getCount() const { return _count; }
+    uint16_t getCapacity() const { return _capacity; }
+    uint8_t getWaiterCount() const { return _waiters.size(); }
+    uint8_t getMaxWaiters() const { return _maxWaiters; }
+
+    /**
+     * @brief 変更の種類の名前を取得（"create" / "modify" / "delete"）
+     */
+    static const char* getTypeName(ChangeType type);
+
+private:
+    std::vector<ChangeRecord> _ring;
+    uint16_t _capacity;
+    uint16_t _head;           // 次に書き込む位置
+    uint16_t _count;
+    uint32_t _latest;         // 最後に割り当てた連番
+    uint32_t _floor;          // これ以下の連番からは差分を返せない
+    uint32_t _feedId;
+    std::vector<ChangeWaiter> _waiters;
+    uint8_t _maxWaiters;
+
+    void _respond(ChangeWaiter& waiter);
+};
+
+#endif // CHANGE_FEED_H
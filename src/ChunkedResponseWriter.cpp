@@ -0,0 +1,42 @@
+#include "ChunkedResponseWriter.h"
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+ChunkedResponseWriter::ChunkedResponseWriter(UploaderWebServer& server)
+    : _server(server),
+      _bytesWritten(0),
+      _started(false),
+      _ended(false) {
+}
+
+ChunkedResponseWriter::~ChunkedResponseWriter() {
+    end();
+}
+
+// ============================================================================
+// 送信
+// ============================================================================
+
+void ChunkedResponseWriter::begin(int code, const char* contentType) {
+    if (_started) return;
+    _started = true;
+    _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    _server.send(code, contentType, "");
+}
+
+bool ChunkedResponseWriter::write(const char* data, size_t length) {
+    if (!_started || _ended) return false;
+    if (length > 0) {
+        _server.sendContent(data, length);
+        _bytesWritten += length;
+    }
+    return _server.client().connected();
+}
+
+void ChunkedResponseWriter::end() {
+    if (!_started || _ended) return;
+    _server.sendContent("");
+    _ended = true;
+}
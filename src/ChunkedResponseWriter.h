@@ -0,0 +1,69 @@
+#ifndef CHUNKED_RESPONSE_WRITER_H
+#define CHUNKED_RESPONSE_WRITER_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "JsonWriter.h"
+#include "UploaderWebServer.h"
+
+/**
+ * @brief 生成したレスポンスを Transfer-Encoding: chunked で送信するライター
+ *
+ * 本文全体を String に組み立ててから send() する代わりに、
+ * JsonWriter などが固定長バッファを使い切るたびに1チャンクとして送信します。
+ * 1レスポンスあたりのメモリ使用量は本文の長さに関係なくバッファサイズで一定です。
+ *
+ * 例:
+ * @code
+ * char buffer[CHUNKED_RESPONSE_BUFFER_SIZE];
+ * ChunkedResponseWriter out(server);
+ * out.begin(200, "application/json");
+ * JsonWriter json(buffer, sizeof(buffer), out.sink());
+ * ...
+ * json.flush();
+ * out.end();
+ * @endcode
+ */
+class ChunkedResponseWriter {
+public:
+    explicit ChunkedResponseWriter(UploaderWebServer& server);
+    ~ChunkedResponseWriter();
+
+    /**
+     * @brief ステータス行とヘッダーを送信（追加ヘッダーは sendHeader() で先に設定）
+     * @param code HTTPステータスコード
+     * @param contentType Content-Type
+     */
+    void begin(int code, const char* contentType);
+
+    /**
+     * @brief データを1チャンクとして送信
+     * @return クライアントが接続中の場合true
+     */
+    bool write(const char* data, size_t length);
+
+    /**
+     * @brief JsonWriter の出力先として使うコールバックを取得
+     */
+    JsonOutputCallback sink() {
+        return [this](const char* data, size_t length) { return write(data, length); };
+    }
+
+    /**
+     * @brief 終端チャンクを書き込む（デストラクタでも呼ばれる）
+     */
+    void end();
+
+    /**
+     * @brief これまでに送信した本文のバイト数を取得
+     */
+    uint32_t getBytesWritten() const { return _bytesWritten; }
+
+private:
+    UploaderWebServer& _server;
+    uint32_t _bytesWritten;
+    bool _started;
+    bool _ended;
+};
+
+#endif // CHUNKED_RESPONSE_WRITER_H
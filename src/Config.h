@@ -35,6 +35,13 @@
 #define DEFAULT_WS_MAX_CHUNK_SIZE 4096
 #define DEFAULT_WS_TIMEOUT 30000
 
+// WebSocketアップロードのフロー制御（クライアントは与えられたクレジットのチャンク数までしか送らない）
+// ウィンドウは計測したSDカードの書き込み速度で WS_CREDIT_TARGET_MS 分のデータになるよう調整する
+#define WS_CREDIT_INITIAL_CHUNKS 4
+#define WS_CREDIT_MIN_CHUNKS 2
+#define WS_CREDIT_MAX_CHUNKS 16
+#define WS_CREDIT_TARGET_MS 100
+
 // ============================================================================
 // 再試行設定
 // ============================================================================
@@ -108,11 +115,51 @@
   #endif
 #endif
 
+// ダブルバッファ先読みダウンロードエンジン（ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_DOWNLOAD_ENGINE
+#define ENABLE_DOWNLOAD_ENGINE ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// JPEGサムネイル生成（ROM内蔵TJpgDecを使用、ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_THUMBNAILS
+#define ENABLE_THUMBNAILS ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// 小さなファイルのRAMキャッシュ（ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_FILE_CACHE
+#define ENABLE_FILE_CACHE ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// 追記中ファイルのライブtail配信（ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_TAIL
+#define ENABLE_TAIL ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// アップロードディレクトリのメタデータをRAMに保持するインデックス（ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_DIRECTORY_INDEX
+#define ENABLE_DIRECTORY_INDEX ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// アップロードディレクトリ直下のファイルをハッシュで分けたバケットに保存する配置（ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_SHARDED_STORAGE
+#define ENABLE_SHARDED_STORAGE ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// ファイルの作成・更新・削除を連番で記録する変更フィード（/api/changes、ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_CHANGE_FEED
+#define ENABLE_CHANGE_FEED ENABLE_ADVANCED_ENDPOINTS
+#endif
+
+// ファイル数・合計サイズ・拡張子ごとの内訳を差分で保つディレクトリ統計（/api/status、ENABLE_ADVANCED_ENDPOINTS が必要）
+#ifndef ENABLE_DIRECTORY_STATS
+#define ENABLE_DIRECTORY_STATS ENABLE_ADVANCED_ENDPOINTS
+#endif
+
 // ============================================================================
 // パフォーマンス設定
 // ============================================================================
 
-// 同時アップロード数の上限
+// 同時アップロード数の上限（WebSocketで同時に開くファイル数、SDライブラリが同時に開けるファイル数（既定5）より少なくする）
 #define MAX_CONCURRENT_UPLOADS 3
 
 // セッションIDの最大値
@@ -121,6 +168,86 @@
 // ファイルリスト取得時の最大ファイル数
 #define MAX_FILE_LIST_SIZE 1000
 
+// 生成するレスポンス（一覧・ステータス）をJSONに書き込み、チャンク転送する際のバッファサイズ
+#define CHUNKED_RESPONSE_BUFFER_SIZE 1024
+
+// 結果メッセージ（{"success":..,"message":..}）用のバッファサイズ（収まらない場合はチャンク転送）
+#define JSON_MESSAGE_BUFFER_SIZE 256
+
+// JSONリクエストボディから取り出す文字列（ファイル名・パス）の最大バイト数（NUL終端を含む）
+#define JSON_REQUEST_MAX_STRING 512
+
+// HTTP keep-alive の設定（1接続あたりの最大リクエスト数と、次のリクエストを待つ時間）
+#define DEFAULT_KEEP_ALIVE_MAX_REQUESTS 32
+#define DEFAULT_KEEP_ALIVE_TIMEOUT 2000
+
+// ダウンロードエンジンのバッファ設定（PSRAMがあればPSRAMに確保）
+#define DEFAULT_DOWNLOAD_BUFFER_SIZE (16 * 1024)
+#define DEFAULT_DOWNLOAD_BUFFER_COUNT 2
+#define MAX_DOWNLOAD_BUFFER_COUNT 4
+#define DOWNLOAD_READER_STACK_SIZE 4096
+
+// オンザフライgzip圧縮の設定（窓サイズ 2^bits バイト、作業メモリは約 6 x 2^bits + 8KB）
+#define DEFAULT_GZIP_WINDOW_BITS 11
+#define GZIP_MAX_CHAIN 8
+#define DEFAULT_GZIP_MIN_SIZE 1024
+
+// アーカイブ（tar/zip）一括ダウンロードの設定
+#define ARCHIVE_BUFFER_SIZE (8 * 1024)
+#define MAX_ARCHIVE_ENTRIES MAX_FILE_LIST_SIZE
+
+// 一括操作（/api/batch）で1リクエストに含められる操作数の上限
+#define MAX_BATCH_OPERATIONS 256
+
+// サムネイルの設定（キャッシュはアップロードディレクトリ内の隠しディレクトリに保存）
+#define DEFAULT_THUMBNAIL_SIZE 160
+#define MIN_THUMBNAIL_SIZE 16
+#define MAX_THUMBNAIL_SIZE 320
+#define DEFAULT_THUMBNAIL_QUALITY 75
+#define THUMBNAIL_CACHE_DIR ".thumbs"
+
+// ダウンロード用RAMキャッシュの設定（PSRAMの有無で既定容量を切り替え）
+#define DEFAULT_FILE_CACHE_SIZE (32 * 1024)
+#define DEFAULT_FILE_CACHE_SIZE_PSRAM (512 * 1024)
+#define DEFAULT_FILE_CACHE_MAX_ENTRY_SIZE (16 * 1024)
+
+// ライブtailの設定（追記がないまま idle timeout を過ぎたレスポンスは閉じる）
+#define DEFAULT_MAX_TAIL_FOLLOWERS 4
+#define DEFAULT_TAIL_IDLE_TIMEOUT 60000
+#define TAIL_READ_BUFFER_SIZE 1024
+
+// ディレクトリインデックスの設定（上限を超えるディレクトリではSDカードを直接参照する）
+// 外部からの変更は verify interval ごとに1ループあたり VERIFY_STEP 件ずつ読み比べて検出
+#define DEFAULT_DIRECTORY_INDEX_MAX_ENTRIES 2000
+#define DEFAULT_DIRECTORY_INDEX_MAX_ENTRIES_PSRAM 20000
+#define DEFAULT_DIRECTORY_INDEX_VERIFY_INTERVAL 30000
+#define DIRECTORY_INDEX_VERIFY_STEP 8
+
+// 永続インデックス（アップロードディレクトリ内の隠しディレクトリに保存、起動時は走査せずに読み込む）
+// 追記した変更記録が COMPACT_THRESHOLD 件（またはエントリ数の半分）を超えたら全体を書き直す
+#define DIRECTORY_INDEX_DIR ".index"
+#define DIRECTORY_INDEX_FILE "files.idx"
+#define DIRECTORY_INDEX_COMPACT_THRESHOLD 256
+#define DIRECTORY_INDEX_IO_BUFFER_SIZE 1024
+
+// バケット配置の設定（バケットはアップロードディレクトリ内の隠しディレクトリに "00"〜"ff" の名前で作成）
+// 移行が完了したバケット数を LAYOUT_FILE に記録し、次回の起動では再配置を省く
+#define SHARD_DIR ".shards"
+#define SHARD_LAYOUT_FILE "layout"
+#define DEFAULT_SHARD_BUCKETS 256
+#define MAX_SHARD_BUCKETS 256
+
+// 変更フィードの設定（リングから押し出された連番を指定したクライアントには一覧の取り直しを求める）
+// 待機（wait）は最大 MAX_CHANGE_WAIT 秒、待機中のクライアントは接続を切り離して保持する
+#define DEFAULT_CHANGE_FEED_CAPACITY 128
+#define DEFAULT_MAX_CHANGE_WAITERS 4
+#define MAX_CHANGE_WAIT 60
+#define CHANGE_FEED_BUFFER_SIZE 512
+
+// ディレクトリ統計の設定（拡張子は小文字で集計し、表に入らない・長すぎる拡張子は「その他」にまとめる）
+#define DIRECTORY_STATS_MAX_EXTENSIONS 16
+#define DIRECTORY_STATS_EXTENSION_LENGTH 12
+
 // ============================================================================
 // セキュリティ設定
 // ============================================================================
@@ -161,10 +288,21 @@
 // HTTP ステータスコード
 // ============================================================================
 #define HTTP_OK                 200
+#define HTTP_NOT_MODIFIED       304
 #define HTTP_BAD_REQUEST        400
 #define HTTP_NOT_FOUND          404
 #define HTTP_METHOD_NOT_ALLOWED 405
 #define HTTP_INTERNAL_ERROR     500
+#define HTTP_SERVICE_UNAVAILABLE 503
+
+// ============================================================================
+// 条件付きGET（ETag / Last-Modified）
+// ============================================================================
+
+// Web UIページのETag元になるビルド識別子（ビルドごとに変化する定数）
+#ifndef WEB_UI_BUILD_ID
+#define WEB_UI_BUILD_ID M5STACK_WIFI_UPLOADER_VERSION "-" __DATE__ "-" __TIME__
+#endif
 
 // ============================================================================
 // マジックナンバー定義
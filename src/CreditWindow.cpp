@@ -0,0 +1,64 @@
+#include "CreditWindow.h"
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+CreditWindow::CreditWindow()
+    : _chunkSize(DEFAULT_WS_MAX_CHUNK_SIZE),
+      _received(0),
+      _limit(0),
+      _window(WS_CREDIT_INITIAL_CHUNKS),
+      _drainBytes(0),
+      _drainUs(0),
+      _drainRate(0) {
+}
+
+// ============================================================================
+// クレジット
+// ============================================================================
+
+uint16_t CreditWindow::begin(uint32_t chunkSize) {
+    _chunkSize = chunkSize > 0 ? chunkSize : DEFAULT_WS_MAX_CHUNK_SIZE;
+    _received = 0;
+    _window = WS_CREDIT_INITIAL_CHUNKS;
+    _limit = _window;
+    _drainBytes = 0;
+    _drainUs = 0;
+    _drainRate = 0;
+    return _window;
+}
+
+bool CreditWindow::consume() {
+    if (_received >= _limit) return false;
+    _received++;
+    return true;
+}
+
+void CreditWindow::recordDrain(size_t bytes, uint32_t elapsedUs) {
+    _drainBytes += bytes;
+    _drainUs += elapsedUs;
+}
+
+uint16_t CreditWindow::grant(uint8_t sharers) {
+    if (_drainUs > 0) {
+        // 数チャンク分の書き込みから求めた速度を平滑化する（FATの領域確保・flushによる一時的な遅延をならす）
+        uint32_t rate = (uint32_t)(_drainBytes * 1000000ULL / _drainUs);
+        _drainRate = _drainRate > 0 ? (_drainRate * 3 + rate) / 4 : rate;
+        _drainBytes = 0;
+        _drainUs = 0;
+
+        // 同時に書き込む転送の合計が WS_CREDIT_TARGET_MS 分に収まるよう等分する
+        uint32_t chunks = (uint32_t)((uint64_t)_drainRate * WS_CREDIT_TARGET_MS / 1000 / _chunkSize);
+        if (sharers > 1) chunks /= sharers;
+        if (chunks < WS_CREDIT_MIN_CHUNKS) chunks = WS_CREDIT_MIN_CHUNKS;
+        if (chunks > WS_CREDIT_MAX_CHUNKS) chunks = WS_CREDIT_MAX_CHUNKS;
+        _window = chunks;
+    }
+
+    // 与え済みのクレジットは取り消さない（クライアントは上限まで送信済みの場合がある）
+    // ウィンドウが縮んだ場合は、新たに与える量だけを減らす
+    uint32_t limit = _received + _window;
+    if (limit > _limit) _limit = limit;
+    return _limit - _received;
+}
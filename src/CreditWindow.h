@@ -0,0 +1,70 @@
+#ifndef CREDIT_WINDOW_H
+#define CREDIT_WINDOW_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @brief WebSocketアップロードのクレジット（送信してよいチャンク数）を管理するウィンドウ
+ *
+ * サーバーは受信済みのチャンク数とクレジットをクライアントに通知し、クライアントは
+ * 「受信済み + クレジット」を超えてチャンクを送りません。受信したチャンクをSDカードへ書き込んでから
+ * 残りのクレジットがウィンドウの半分以下になった時点で与え直すため、
+ * SDカードが吸収できない速度で送られたデータがTCPの受信バッファやヒープに溜まりません。
+ *
+ * ウィンドウの大きさは、SDカードへの書き込みにかかった時間から求めた速度（指数移動平均）で
+ * WS_CREDIT_TARGET_MS 分のデータになるよう、WS_CREDIT_MIN_CHUNKS〜WS_CREDIT_MAX_CHUNKS の範囲で調整します。
+ * 複数の転送が同じSDカードへ同時に書き込む場合は、その分だけウィンドウを等分します。
+ */
+class CreditWindow {
+public:
+    CreditWindow();
+
+    /**
+     * @brief 転送の開始時に初期化
+     * @param chunkSize 1チャンクの最大バイト数
+     * @return 最初に与えるクレジット（チャンク数）
+     */
+    uint16_t begin(uint32_t chunkSize);
+
+    /**
+     * @brief チャンクを1つ受信
+     * @return クレジットの範囲内ならtrue（超えていればクライアントのプロトコル違反）
+     */
+    bool consume();
+
+    /**
+     * @brief SDカードへの書き込みを計測（書き込み速度の推定に使う）
+     * @param bytes 書き込んだバイト数
+     * @param elapsedUs write()・flush() にかかった時間（マイクロ秒）
+     */
+    void recordDrain(size_t bytes, uint32_t elapsedUs);
+
+    /**
+     * @brief クレジットを与え直す時期か（残りがウィンドウの半分以下）
+     */
+    bool needsGrant() const { return _limit - _received <= _window / 2; }
+
+    /**
+     * @brief 書き込み速度からウィンドウを調整し、受信済みの位置からクレジットを与え直す
+     * @param sharers 同時に書き込んでいる転送の数（この転送を含む）
+     * @return クレジット（受信済みのチャンク数から数えて送信してよいチャンク数、与え済みの上限より前には戻さない）
+     */
+    uint16_t grant(uint8_t sharers = 1);
+
+    uint32_t getReceived() const { return _received; }
+    uint32_t getChunkSize() const { return _chunkSize; }
+    uint16_t getWindow() const { return _window; }
+    uint32_t getDrainRate() const { return _drainRate; }
+
+private:
+    uint32_t _chunkSize;
+    uint32_t _received;       // 受信したチャンク数
+    uint32_t _limit;          // クライアントが送信してよいチャンク数の上限（受信済みを含む）
+    uint16_t _window;
+    uint64_t _drainBytes;     // 前回クレジットを与えてから書き込んだバイト数
+    uint64_t _drainUs;        // 同じ期間の書き込みにかかった時間
+    uint32_t _drainRate;      // 推定した書き込み速度（バイト/秒、0は未計測）
+};
+
+#endif // CREDIT_WINDOW_H
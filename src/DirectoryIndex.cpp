@@ -0,0 +1,768 @@
+#include "DirectoryIndex.h"
+#include <algorithm>
+#include <stddef.h>
+#include <esp_rom_crc.h>
+
+// 変更記録に書ける名前の最大バイト数（UTF-8で1文字最大3バイト）
+static const size_t JOURNAL_MAX_NAME_BYTES = MAX_FILENAME_LENGTH * 3;
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+DirectoryIndex::DirectoryIndex()
+    : _layout(nullptr),
+      _maxEntries(0),
+      _verifyInterval(0),
+      _nameBytes(0),
+      _checksum(0),
+      _generation(0),
+      _rebuilds(0),
+      _externalChanges(0),
+      _lastRebuildMs(0),
+      _lastLoadMs(0),
+      _journalRecords(0),
+      _compactions(0),
+      _persistent(false),
+      _loadedFromFile(false),
+      _valid(false),
+      _verifyBucket(0),
+      _verifyGeneration(0),
+      _verifyCount(0),
+      _verifyChecksum(0),
+      _lastVerify(0) {
+}
+
+DirectoryIndex::~DirectoryIndex() {
+    _releaseEntries();
+}
+
+// ============================================================================
+// 設定・構築
+// ============================================================================
+
+void DirectoryIndex::configure(uint32_t maxEntries, uint32_t verifyIntervalMs, bool persistent) {
+    _maxEntries = maxEntries;
+    _verifyInterval = verifyIntervalMs;
+    _persistent = persistent;
+}
+
+bool DirectoryIndex::open(const char* path) {
+    _releaseEntries();
+    _path = path;
+    if (_maxEntries == 0) return false;
+
+    if (_persistent && _load()) {
+        // 停止中に書き換えられていないか、すぐに検証を始める
+        _lastVerify = millis() - _verifyInterval;
+        return true;
+    }
+    return rebuild(path);
+}
+
+bool DirectoryIndex::rebuild(const char* path) {
+    _releaseEntries();
+    _path = path;
+    _loadedFromFile = false;
+    if (_maxEntries == 0) return false;
+
+    unsigned long startTime = millis();
+
+    // 直下と各バケットのファイルを走査順に追加してから一度だけ並べ替える
+    bool complete = _scan(path, true);
+    for (uint16_t bucket = 0; complete && bucket < _bucketCount(); bucket++) {
+        complete = _scan(_layout->bucketPath(_path, bucket).c_str(), false);
+    }
+
+    if (!complete) {
+        clear();
+        _removeIndexFile();
+        return false;
+    }
+
+    std::sort(_entries.begin(), _entries.end(), [](const DirectoryIndexEntry& a, const DirectoryIndexEntry& b) {
+        return strcasecmp(a.name, b.name) < 0;
+    });
+    _entries.shrink_to_fit();
+    _buildOrders();
+    _valid = true;
+    _generation++;
+    _rebuilds++;
+    _lastRebuildMs = millis() - startTime;
+    _lastVerify = millis();
+
+    if (_persistent && !_writeSnapshot()) {
+        // 古いファイルを次回の起動で読み込まないようにする
+        _removeIndexFile();
+    }
+    return true;
+}
+
+void DirectoryIndex::clear() {
+    _releaseEntries();
+}
+
+// ============================================================================
+// 検索・差分更新
+// ============================================================================
+
+const DirectoryIndexEntry* DirectoryIndex::find(const char* name) const {
+    if (!_valid) return nullptr;
+    size_t pos = _lowerBound(name);
+    if (pos < _entries.size() && strcasecmp(_entries[pos].name, name) == 0) {
+        return &_entries[pos];
+    }
+    return nullptr;
+}
+
+size_t DirectoryIndex::prefixRange(const char* prefix, size_t& count) const {
+    size_t length = strlen(prefix);
+    size_t first = _lowerBound(prefix);
+
+    // 接頭辞が一致する範囲の終端（接頭辞の長さで比べた順序も名前順と同じく単調）
+    size_t low = first;
+    size_t high = _entries.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (strncasecmp(_entries[mid].name, prefix, length) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    count = low - first;
+    return first;
+}
+
+const DirectoryIndexEntry& DirectoryIndex::getEntry(size_t i, DirectoryIndexOrder order) const {
+    switch (order) {
+        case DIRECTORY_INDEX_ORDER_SIZE:
+            return _entries[_bySize[i]];
+        case DIRECTORY_INDEX_ORDER_MODIFIED:
+            return _entries[_byModified[i]];
+        default:
+            return _entries[i];
+    }
+}
+
+size_t DirectoryIndex::lowerBound(DirectoryIndexOrder order, uint32_t value) const {
+    if (order == DIRECTORY_INDEX_ORDER_NAME) return 0;
+
+    const std::vector<uint32_t>& list = order == DIRECTORY_INDEX_ORDER_SIZE ? _bySize : _byModified;
+    size_t low = 0;
+    size_t high = list.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (_orderKey(order, list[mid]) < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void DirectoryIndex::update(const char* name, uint32_t size, uint32_t modified) {
+    if (!_valid) return;
+
+    if (!_update(name, size, modified)) {
+        // 上限超過・メモリ不足の場合は不完全な一覧を返さないよう無効にする
+        clear();
+        _removeIndexFile();
+        return;
+    }
+    _appendJournal('U', name, size, modified);
+}
+
+void DirectoryIndex::remove(const char* name) {
+    if (!_valid) return;
+
+    if (_remove(name)) {
+        _appendJournal('D', name, 0, 0);
+    }
+}
+
+void DirectoryIndex::rename(const char* from, const char* to) {
+    const DirectoryIndexEntry* entry = find(from);
+    if (!entry) return;
+
+    uint32_t size = entry->size;
+    uint32_t modified = entry->modified;
+    remove(from);
+    remove(to);
+    update(to, size, modified);
+}
+
+// ============================================================================
+// 外部変更の検証
+// ============================================================================
+
+bool DirectoryIndex::verifyStep() {
+    if (!_valid || _verifyInterval == 0) return false;
+
+    if (!_verifyDir) {
+        if (millis() - _lastVerify < _verifyInterval) return false;
+        _lastVerify = millis();
+        _verifyDir = SD.open(_path.c_str());
+        if (!_verifyDir || !_verifyDir.isDirectory()) {
+            _stopVerify();
+            return false;
+        }
+        _verifyBucket = 0;
+        _verifyGeneration = _generation;
+        _verifyCount = 0;
+        _verifyChecksum = 0;
+    }
+
+    // ライブラリ側の変更で途中結果が古くなったら、次の間隔まで待ってやり直す
+    if (_generation != _verifyGeneration) {
+        _stopVerify();
+        return false;
+    }
+
+    for (int i = 0; i < DIRECTORY_INDEX_VERIFY_STEP; i++) {
+        File entry = _verifyDir.openNextFile();
+        if (!entry) {
+            // 直下を読み終えたら各バケットを順に読み、全て読み終えたら集計を比べる
+            if (!_nextVerifyDir()) return _finishVerify();
+            continue;
+        }
+        if (!entry.isDirectory()) {
+            _verifyCount++;
+            _verifyChecksum += _entryHash(entry.name(), entry.size());
+        }
+        entry.close();
+    }
+    return false;
+}
+
+DirectoryIndexStats DirectoryIndex::getStats() const {
+    DirectoryIndexStats stats;
+    stats.entries = _entries.size();
+    stats.maxEntries = _maxEntries;
+    stats.memoryUsage = _entries.capacity() * sizeof(DirectoryIndexEntry) +
+                        (_bySize.capacity() + _byModified.capacity()) * sizeof(uint32_t) + _nameBytes;
+    stats.bytesPerEntry = stats.entries > 0 ? stats.memoryUsage / stats.entries : 0;
+    stats.rebuilds = _rebuilds;
+    stats.externalChanges = _externalChanges;
+    stats.lastRebuildMs = _lastRebuildMs;
+    stats.lastLoadMs = _lastLoadMs;
+    stats.journalRecords = _journalRecords;
+    stats.compactions = _compactions;
+    stats.persistent = _persistent;
+    stats.loadedFromFile = _loadedFromFile;
+    stats.valid = _valid;
+    return stats;
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+size_t DirectoryIndex::_lowerBound(const char* name) const {
+    size_t low = 0;
+    size_t high = _entries.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (strcasecmp(_entries[mid].name, name) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+bool DirectoryIndex::_scan(const char* dirPath, bool required) {
+    File dir = SD.open(dirPath);
+    if (!dir || !dir.isDirectory()) {
+        if (dir) dir.close();
+        // まだ作られていないバケットは空として扱う
+        return !required;
+    }
+
+    bool complete = true;
+    File entry = dir.openNextFile();
+    while (entry) {
+        if (!entry.isDirectory()) {
+            const char* name = entry.name();
+            size_t length = strlen(name);
+            char* copy = _entries.size() < _maxEntries ? _allocateName(name, length) : nullptr;
+            if (!copy) {
+                complete = false;
+                entry.close();
+                break;
+            }
+            const char* dot = strrchr(copy, '.');
+            size_t ext = (dot && dot != copy) ? dot - copy + 1 : 0;
+
+            DirectoryIndexEntry item;
+            item.name = copy;
+            item.size = entry.size();
+            item.modified = (uint32_t)entry.getLastWrite();
+            item.extension = ext <= 0xFF ? ext : 0;
+            _entries.push_back(item);
+            _nameBytes += length + 1;
+            _checksum += _entryHash(copy, item.size);
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    dir.close();
+    return complete;
+}
+
+bool DirectoryIndex::_update(const char* name, uint32_t size, uint32_t modified) {
+    _generation++;
+
+    size_t pos = _lowerBound(name);
+    if (pos < _entries.size() && strcasecmp(_entries[pos].name, name) == 0) {
+        // FATは上書き時に既存エントリの名前（大文字小文字）を保つので名前はそのまま
+        DirectoryIndexEntry& entry = _entries[pos];
+        _unlinkOrders(pos);
+        _checksum -= _entryHash(entry.name, entry.size);
+        entry.size = size;
+        entry.modified = modified;
+        _checksum += _entryHash(entry.name, entry.size);
+        _linkOrders(pos);
+        return true;
+    }
+    return _insert(pos, name, size, modified);
+}
+
+bool DirectoryIndex::_remove(const char* name) {
+    _generation++;
+
+    size_t pos = _lowerBound(name);
+    if (pos < _entries.size() && strcasecmp(_entries[pos].name, name) == 0) {
+        _erase(pos);
+        return true;
+    }
+    return false;
+}
+
+bool DirectoryIndex::_insert(size_t pos, const char* name, uint32_t size, uint32_t modified) {
+    if (_entries.size() >= _maxEntries) return false;
+
+    size_t length = strlen(name);
+    char* copy = _allocateName(name, length);
+    if (!copy) return false;
+    const char* dot = strrchr(copy, '.');
+    size_t ext = (dot && dot != copy) ? dot - copy + 1 : 0;
+
+    DirectoryIndexEntry entry;
+    entry.name = copy;
+    entry.size = size;
+    entry.modified = modified;
+    entry.extension = ext <= 0xFF ? ext : 0;
+    _entries.insert(_entries.begin() + pos, entry);
+    _shiftOrders(pos, 1);
+    _linkOrders(pos);
+    _nameBytes += length + 1;
+    _checksum += _entryHash(copy, size);
+    return true;
+}
+
+void DirectoryIndex::_erase(size_t pos) {
+    _unlinkOrders(pos);
+    DirectoryIndexEntry& entry = _entries[pos];
+    _checksum -= _entryHash(entry.name, entry.size);
+    _nameBytes -= strlen(entry.name) + 1;
+    free(entry.name);
+    _entries.erase(_entries.begin() + pos);
+    _shiftOrders(pos + 1, -1);
+}
+
+void DirectoryIndex::_releaseEntries() {
+    _stopVerify();
+    for (auto& entry : _entries) {
+        free(entry.name);
+    }
+    _entries.clear();
+    _entries.shrink_to_fit();
+    _bySize.clear();
+    _bySize.shrink_to_fit();
+    _byModified.clear();
+    _byModified.shrink_to_fit();
+    _nameBytes = 0;
+    _checksum = 0;
+    _generation++;
+    _valid = false;
+}
+
+// ============================================================================
+// プライベートメソッド - サイズ順・更新時刻順
+// ============================================================================
+// 各配列は (キー, 名前順の位置) の昇順。名前順の位置の大小は挿入・削除でずらしても保たれるため、
+// 差分更新は該当位置の付け外しと後続位置の ±1 だけで済む
+
+std::vector<uint32_t>& DirectoryIndex::_orderList(DirectoryIndexOrder order) {
+    return order == DIRECTORY_INDEX_ORDER_SIZE ? _bySize : _byModified;
+}
+
+uint32_t DirectoryIndex::_orderKey(DirectoryIndexOrder order, uint32_t pos) const {
+    return order == DIRECTORY_INDEX_ORDER_SIZE ? _entries[pos].size : _entries[pos].modified;
+}
+
+size_t DirectoryIndex::_orderPosition(DirectoryIndexOrder order, uint32_t pos) const {
+    const std::vector<uint32_t>& list = order == DIRECTORY_INDEX_ORDER_SIZE ? _bySize : _byModified;
+    uint32_t key = _orderKey(order, pos);
+    size_t low = 0;
+    size_t high = list.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        uint32_t midKey = _orderKey(order, list[mid]);
+        if (midKey < key || (midKey == key && list[mid] < pos)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void DirectoryIndex::_buildOrders() {
+    const DirectoryIndexOrder orders[] = {DIRECTORY_INDEX_ORDER_SIZE, DIRECTORY_INDEX_ORDER_MODIFIED};
+    for (DirectoryIndexOrder order : orders) {
+        std::vector<uint32_t>& list = _orderList(order);
+        list.resize(_entries.size());
+        for (uint32_t i = 0; i < list.size(); i++) {
+            list[i] = i;
+        }
+        std::sort(list.begin(), list.end(), [this, order](uint32_t a, uint32_t b) {
+            uint32_t keyA = _orderKey(order, a);
+            uint32_t keyB = _orderKey(order, b);
+            return keyA < keyB || (keyA == keyB && a < b);
+        });
+    }
+}
+
+void DirectoryIndex::_linkOrders(uint32_t pos) {
+    _bySize.insert(_bySize.begin() + _orderPosition(DIRECTORY_INDEX_ORDER_SIZE, pos), pos);
+    _byModified.insert(_byModified.begin() + _orderPosition(DIRECTORY_INDEX_ORDER_MODIFIED, pos), pos);
+}
+
+void DirectoryIndex::_unlinkOrders(uint32_t pos) {
+    _bySize.erase(_bySize.begin() + _orderPosition(DIRECTORY_INDEX_ORDER_SIZE, pos));
+    _byModified.erase(_byModified.begin() + _orderPosition(DIRECTORY_INDEX_ORDER_MODIFIED, pos));
+}
+
+void DirectoryIndex::_shiftOrders(uint32_t from, int delta) {
+    for (uint32_t& pos : _bySize) {
+        if (pos >= from) pos += delta;
+    }
+    for (uint32_t& pos : _byModified) {
+        if (pos >= from) pos += delta;
+    }
+}
+
+// ============================================================================
+// プライベートメソッド - 永続インデックス
+// ============================================================================
+
+String DirectoryIndex::_indexFilePath() const {
+    return _path + "/" DIRECTORY_INDEX_DIR "/" DIRECTORY_INDEX_FILE;
+}
+
+void DirectoryIndex::_fillHeader(DirectoryIndexFileHeader& header, uint32_t stringBytes) const {
+    memset(&header, 0, sizeof(header));
+    header.magic = DIRECTORY_INDEX_MAGIC;
+    header.version = DIRECTORY_INDEX_VERSION;
+    header.recordSize = sizeof(DirectoryIndexFileRecord);
+    header.pathHash = esp_rom_crc32_le(0, (const uint8_t*)_path.c_str(), _path.length());
+    header.volumeSize = (uint32_t)(SD.totalBytes() >> 10);
+    header.count = _entries.size();
+    header.stringBytes = stringBytes;
+    header.checksum = _checksum;
+    header.headerCrc = esp_rom_crc32_le(0, (const uint8_t*)&header, offsetof(DirectoryIndexFileHeader, headerCrc));
+}
+
+bool DirectoryIndex::_load() {
+    unsigned long startTime = millis();
+    String filePath = _indexFilePath();
+    if (!SD.exists(filePath.c_str())) {
+        // 差し替えの途中（古いファイルを削除してリネームする前）で止まった場合は書き終えた一時ファイルを使う
+        // （書き込み途中の一時ファイルは下のヘッダー・レコードの検証で弾かれ、走査に戻る）
+        String tempPath = filePath + ".tmp";
+        if (!SD.exists(tempPath.c_str()) || !SD.rename(tempPath.c_str(), filePath.c_str())) return false;
+    }
+
+    File file = SD.open(filePath.c_str(), FILE_READ);
+    if (!file) return false;
+
+    // 別のディレクトリ・別のカード・壊れたヘッダーのファイルは使わない
+    DirectoryIndexFileHeader header;
+    DirectoryIndexFileHeader expected;
+    bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header);
+    if (ok) {
+        _fillHeader(expected, 0);
+        ok = header.magic == expected.magic &&
+             header.version == expected.version &&
+             header.recordSize == expected.recordSize &&
+             header.pathHash == expected.pathHash &&
+             header.volumeSize == expected.volumeSize &&
+             header.headerCrc == esp_rom_crc32_le(0, (const uint8_t*)&header, offsetof(DirectoryIndexFileHeader, headerCrc)) &&
+             header.count <= _maxEntries;
+    }
+    if (!ok) {
+        file.close();
+        return false;
+    }
+
+    // レコードはブロック単位で読み、名前は2つ目のハンドルで文字列表を先頭から順に読む
+    uint32_t stringsStart = sizeof(header) + header.count * sizeof(DirectoryIndexFileRecord);
+    File strings = SD.open(filePath.c_str(), FILE_READ);
+    ok = strings && strings.seek(stringsStart);
+    _entries.reserve(header.count);
+
+    DirectoryIndexFileRecord records[DIRECTORY_INDEX_IO_BUFFER_SIZE / sizeof(DirectoryIndexFileRecord)];
+    const size_t batch = sizeof(records) / sizeof(records[0]);
+    uint32_t loaded = 0;
+    uint32_t offset = 0;
+    while (ok && loaded < header.count) {
+        size_t n = std::min((size_t)(header.count - loaded), batch);
+        ok = file.read((uint8_t*)records, n * sizeof(DirectoryIndexFileRecord)) == n * sizeof(DirectoryIndexFileRecord);
+        for (size_t i = 0; ok && i < n; i++) {
+            const DirectoryIndexFileRecord& record = records[i];
+            ok = record.nameOffset == offset && record.nameLength > 0 &&
+                 offset + record.nameLength <= header.stringBytes;
+            if (!ok) break;
+
+            char* copy = _allocateName(nullptr, record.nameLength);
+            ok = copy && strings.read((uint8_t*)copy, record.nameLength) == record.nameLength;
+            if (ok) {
+                copy[record.nameLength] = '\0';
+                // 二分探索の前提になる並び順も確かめる
+                ok = _entries.empty() || strcasecmp(_entries.back().name, copy) < 0;
+            }
+            if (!ok) {
+                free(copy);
+                break;
+            }
+
+            DirectoryIndexEntry entry;
+            entry.name = copy;
+            entry.size = record.size;
+            entry.modified = record.modified;
+            entry.extension = record.extension;
+            _entries.push_back(entry);
+            _nameBytes += record.nameLength + 1;
+            _checksum += _entryHash(copy, record.size);
+            offset += record.nameLength;
+        }
+        loaded += n;
+    }
+    if (strings) strings.close();
+
+    ok = ok && offset == header.stringBytes && _checksum == header.checksum;
+    if (ok) _buildOrders();
+    ok = ok && file.seek(stringsStart + header.stringBytes) && _replayJournal(file);
+    // 書き込み途中で途切れた変更記録があれば、その後ろに追記しないよう書き直す
+    bool torn = ok && file.position() != file.size();
+    file.close();
+
+    if (!ok) {
+        _releaseEntries();
+        return false;
+    }
+
+    _valid = true;
+    _loadedFromFile = true;
+    _generation++;
+    if (torn || _journalRecords >= std::max((uint32_t)DIRECTORY_INDEX_COMPACT_THRESHOLD, (uint32_t)_entries.size() / 2)) {
+        _writeSnapshot();
+    }
+    _lastLoadMs = millis() - startTime;
+    return true;
+}
+
+bool DirectoryIndex::_replayJournal(File& file) {
+    DirectoryIndexJournalRecord record;
+    char name[JOURNAL_MAX_NAME_BYTES + 1];
+
+    _journalRecords = 0;
+    while (true) {
+        size_t start = file.position();
+        if (file.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+            file.seek(start);
+            break;
+        }
+        bool complete = record.nameLength > 0 && record.nameLength <= JOURNAL_MAX_NAME_BYTES &&
+                        file.read((uint8_t*)name, record.nameLength) == record.nameLength;
+        if (complete) {
+            uint32_t crc = esp_rom_crc32_le(0, &record.op, sizeof(record) - offsetof(DirectoryIndexJournalRecord, op));
+            crc = esp_rom_crc32_le(crc, (const uint8_t*)name, record.nameLength);
+            complete = crc == record.crc;
+        }
+        if (!complete) {
+            // 末尾の書き込み途中の記録はここで打ち切る
+            file.seek(start);
+            break;
+        }
+        name[record.nameLength] = '\0';
+
+        if (record.op == 'U') {
+            if (!_update(name, record.size, record.modified)) return false;
+        } else if (record.op == 'D') {
+            _remove(name);
+        } else {
+            file.seek(start);
+            break;
+        }
+        _journalRecords++;
+    }
+    return true;
+}
+
+bool DirectoryIndex::_writeSnapshot() {
+    String dirPath = _path + "/" DIRECTORY_INDEX_DIR;
+    if (!SD.exists(dirPath.c_str()) && !SD.mkdir(dirPath.c_str())) return false;
+
+    String filePath = _indexFilePath();
+    String tempPath = filePath + ".tmp";
+    File file = SD.open(tempPath.c_str(), FILE_WRITE);
+    if (!file) return false;
+
+    uint8_t buffer[DIRECTORY_INDEX_IO_BUFFER_SIZE];
+    size_t used = 0;
+    bool ok = true;
+    auto flush = [&]() {
+        if (used > 0 && file.write(buffer, used) != used) ok = false;
+        used = 0;
+    };
+
+    DirectoryIndexFileHeader header;
+    _fillHeader(header, _nameBytes - _entries.size());
+    memcpy(buffer, &header, sizeof(header));
+    used = sizeof(header);
+
+    // 名前順のレコード
+    uint32_t offset = 0;
+    for (const auto& entry : _entries) {
+        if (used + sizeof(DirectoryIndexFileRecord) > sizeof(buffer)) flush();
+        DirectoryIndexFileRecord record;
+        record.nameOffset = offset;
+        record.size = entry.size;
+        record.modified = entry.modified;
+        record.nameLength = strlen(entry.name);
+        record.extension = entry.extension;
+        record.reserved = 0;
+        memcpy(buffer + used, &record, sizeof(record));
+        used += sizeof(record);
+        offset += record.nameLength;
+    }
+
+    // 文字列表（終端文字なし）
+    for (const auto& entry : _entries) {
+        size_t length = strlen(entry.name);
+        if (used + length > sizeof(buffer)) flush();
+        memcpy(buffer + used, entry.name, length);
+        used += length;
+    }
+    flush();
+    file.close();
+
+    if (!ok) {
+        SD.remove(tempPath.c_str());
+        return false;
+    }
+
+    // 書き終えてから差し替える。SD.rename() は上書きできないため古いファイルを先に削除し、
+    // その間に電源が切れた・リネームに失敗した場合は、次回の _load() が残った一時ファイルを使う
+    if (SD.exists(filePath.c_str())) SD.remove(filePath.c_str());
+    if (!SD.rename(tempPath.c_str(), filePath.c_str())) return false;
+
+    _journalRecords = 0;
+    _compactions++;
+    return true;
+}
+
+void DirectoryIndex::_appendJournal(uint8_t op, const char* name, uint32_t size, uint32_t modified) {
+    if (!_persistent || !_valid) return;
+
+    // 変更記録が溜まったら全体を書き直す（この変更はメモリ上に反映済み）
+    if (_journalRecords >= std::max((uint32_t)DIRECTORY_INDEX_COMPACT_THRESHOLD, (uint32_t)_entries.size() / 2)) {
+        if (!_writeSnapshot()) _removeIndexFile();
+        return;
+    }
+
+    size_t length = strlen(name);
+    if (length == 0 || length > JOURNAL_MAX_NAME_BYTES) {
+        _removeIndexFile();
+        return;
+    }
+
+    DirectoryIndexJournalRecord record;
+    record.op = op;
+    record.reserved = 0;
+    record.nameLength = length;
+    record.size = size;
+    record.modified = modified;
+    record.crc = esp_rom_crc32_le(0, &record.op, sizeof(record) - offsetof(DirectoryIndexJournalRecord, op));
+    record.crc = esp_rom_crc32_le(record.crc, (const uint8_t*)name, length);
+
+    String filePath = _indexFilePath();
+    File file = SD.open(filePath.c_str(), FILE_APPEND);
+    if (!file) return;  // ファイルがなければ次回の起動時に走査する
+    file.write((const uint8_t*)&record, sizeof(record));
+    file.write((const uint8_t*)name, length);
+    file.close();
+    _journalRecords++;
+}
+
+void DirectoryIndex::_removeIndexFile() {
+    if (!_persistent || _path.length() == 0) return;
+    String filePath = _indexFilePath();
+    if (SD.exists(filePath.c_str())) SD.remove(filePath.c_str());
+}
+
+// ============================================================================
+// プライベートメソッド - 外部変更の検証
+// ============================================================================
+
+void DirectoryIndex::_stopVerify() {
+    if (_verifyDir) _verifyDir.close();
+    _verifyDir = File();
+}
+
+bool DirectoryIndex::_nextVerifyDir() {
+    if (_verifyDir) _verifyDir.close();
+    while (_verifyBucket < _bucketCount()) {
+        _verifyDir = SD.open(_layout->bucketPath(_path, _verifyBucket++).c_str());
+        if (_verifyDir && _verifyDir.isDirectory()) return true;
+        if (_verifyDir) _verifyDir.close();
+    }
+    _verifyDir = File();
+    return false;
+}
+
+bool DirectoryIndex::_finishVerify() {
+    _stopVerify();
+    if (_verifyCount == _entries.size() && _verifyChecksum == _checksum) {
+        return false;
+    }
+
+    _externalChanges++;
+    String path = _path;
+    rebuild(path.c_str());
+    return true;
+}
+
+uint32_t DirectoryIndex::_entryHash(const char* name, uint32_t size) {
+    // 順序に依存しない和で集計するため、名前のCRC32とサイズを混ぜて1エントリの値にする
+    return esp_rom_crc32_le(0, (const uint8_t*)name, strlen(name)) ^ (size * 2654435761UL);
+}
+
+char* DirectoryIndex::_allocateName(const char* name, size_t length) {
+    char* copy = nullptr;
+    if (psramFound()) {
+        copy = (char*)ps_malloc(length + 1);
+    }
+    if (!copy) {
+        copy = (char*)malloc(length + 1);
+    }
+    if (copy && name) {
+        memcpy(copy, name, length + 1);
+    }
+    return copy;
+}
@@ -0,0 +1,285 @@
+#ifndef DIRECTORY_INDEX_H
+#define DIRECTORY_INDEX_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+#include <vector>
+#include "Config.h"
+#include "ShardedLayout.h"
+
+// ============================================================================
+// インデックスエントリ
+// ============================================================================
+struct DirectoryIndexEntry {
+    char* name;               // ファイル名（インデックスが確保・解放）
+    uint32_t size;            // サイズ（バイト）
+    uint32_t modified;        // 最終更新時刻（UNIXタイムスタンプ）
+    uint8_t extension;        // 拡張子の開始位置（name からのオフセット、拡張子なしは0）
+
+    const char* getExtension() const { return extension ? name + extension : ""; }
+};
+
+// ============================================================================
+// 並び順
+// ============================================================================
+enum DirectoryIndexOrder : uint8_t {
+    DIRECTORY_INDEX_ORDER_NAME = 0,       // 名前順（大文字小文字を区別しない）
+    DIRECTORY_INDEX_ORDER_SIZE = 1,       // サイズ順（同じサイズは名前順）
+    DIRECTORY_INDEX_ORDER_MODIFIED = 2    // 更新時刻順（同じ時刻は名前順）
+};
+
+// ============================================================================
+// インデックス統計情報
+// ============================================================================
+struct DirectoryIndexStats {
+    uint32_t entries;         // エントリ数
+    uint32_t maxEntries;      // 上限（0で無効）
+    size_t memoryUsage;       // エントリ配列・並び順の配列・ファイル名の合計バイト数（アロケータのオーバーヘッドを除く）
+    uint16_t bytesPerEntry;   // 1エントリあたりの平均バイト数
+    uint32_t rebuilds;        // 全走査による再構築の回数
+    uint32_t externalChanges; // 検証で検出した外部からの変更の回数
+    uint32_t lastRebuildMs;   // 直近の再構築にかかった時間（ミリ秒）
+    uint32_t lastLoadMs;      // 永続インデックスの読み込みにかかった時間（ミリ秒）
+    uint32_t journalRecords;  // 永続インデックスに追記済みで未圧縮の変更記録数
+    uint32_t compactions;     // 永続インデックスを書き直した回数
+    bool persistent;          // SDカードに保存するか
+    bool loadedFromFile;      // 起動時に走査せず永続インデックスから読み込んだか
+    bool valid;               // 一覧・存在確認に使える状態か
+};
+
+// ============================================================================
+// 永続インデックスのファイル形式
+// ============================================================================
+// [ヘッダー][固定長レコード x count][文字列表 stringBytes][変更記録...]
+// レコードと文字列表は名前順のスナップショット、以降の変更は変更記録として追記する
+
+#define DIRECTORY_INDEX_MAGIC 0x5844494DUL    // "MIDX"
+#define DIRECTORY_INDEX_VERSION 1
+
+struct DirectoryIndexFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;      // sizeof(DirectoryIndexFileRecord)
+    uint32_t pathHash;        // アップロードディレクトリのパスのCRC32
+    uint32_t volumeSize;      // SDカードの総容量（KB、別のカードとの取り違え防止）
+    uint32_t count;           // レコード数
+    uint32_t stringBytes;     // 文字列表のバイト数
+    uint32_t checksum;        // スナップショット時点の (名前, サイズ) チェックサム
+    uint32_t headerCrc;       // ここまでのCRC32
+};
+
+struct DirectoryIndexFileRecord {
+    uint32_t nameOffset;      // 文字列表内の位置
+    uint32_t size;
+    uint32_t modified;
+    uint16_t nameLength;
+    uint8_t extension;
+    uint8_t reserved;
+};
+
+struct DirectoryIndexJournalRecord {
+    uint32_t crc;             // op 以降（名前を含む）のCRC32（書き込み途中の記録を検出）
+    uint8_t op;               // 'U'=作成・更新, 'D'=削除
+    uint8_t reserved;
+    uint16_t nameLength;      // 直後に続く名前のバイト数
+    uint32_t size;
+    uint32_t modified;
+};
+
+/**
+ * @brief アップロードディレクトリのファイル情報（名前・サイズ・更新時刻・拡張子）を保持するインデックス
+ *
+ * 起動時に一度だけディレクトリを走査（または永続インデックスを読み込み）し、以降はライブラリ自身のアップロード・削除・
+ * リネーム・追記に合わせて差分更新します。エントリは名前順（大文字小文字を区別しない、
+ * FATと同じ規則）に並べ、存在確認は二分探索で行います。サイズ順・更新時刻順の並びも
+ * エントリ位置の配列として差分更新で保ち、並べ替えや範囲の絞り込みにSDカードの走査もソートも要しません。
+ *
+ * バケット配置（ShardedLayout）を設定した場合は、直下と全バケットのファイルを1つの平坦な一覧として扱います。
+ *
+ * ライブラリ外でSDカードが書き換えられた場合に備え、verifyStep() を定期的に呼び出すと
+ * ディレクトリを少しずつ読み直してエントリ数と (名前, サイズ) のチェックサムを比較し、
+ * 食い違いがあれば再構築します。
+ * 上限件数を超えた場合は無効（isValid() == false）になり、呼び出し側はSDカードを直接参照します。
+ *
+ * 永続化を有効にすると、インデックスを DIRECTORY_INDEX_DIR 内のファイルに保存します。
+ * 起動時は open() でディレクトリを走査せずにこのファイルをブロック単位で読み込み、
+ * 差分更新は変更記録として追記、記録が溜まったら全体を書き直して圧縮します。
+ * ライブラリ停止中の変更は、読み込み直後に開始する verifyStep() の検証で検出します。
+ */
+class DirectoryIndex {
+public:
+    DirectoryIndex();
+    ~DirectoryIndex();
+
+    /**
+     * @brief 上限件数と検証間隔を設定（反映は次の open() / rebuild() から）
+     * @param maxEntries 保持する最大件数（0で無効）
+     * @param verifyIntervalMs 外部変更の検証を始める間隔（0で検証しない）
+     * @param persistent true=インデックスをSDカードに保存し、起動時に読み込む
+     */
+    void configure(uint32_t maxEntries, uint32_t verifyIntervalMs, bool persistent = true);
+
+    /**
+     * @brief バケット配置を設定（走査・検証で各バケット内のファイルも対象にする、nullptrで直下のみ）
+     * @note 配置は呼び出し側が保持し、インデックスより長く存在すること
+     */
+    void setLayout(const ShardedLayout* layout) { _layout = layout; }
+
+    /**
+     * @brief 永続インデックスを読み込む（読めない・検証に失敗した場合は rebuild() で走査）
+     * @param path ディレクトリのパス
+     * @return 有効なインデックスを用意できた場合true
+     */
+    bool open(const char* path);
+
+    /**
+     * @brief ディレクトリを走査してインデックスを作り直す（永続化が有効ならファイルも書き直す）
+     * @param path ディレクトリのパス
+     * @return 有効なインデックスを構築できた場合true
+     */
+    bool rebuild(const char* path);
+
+    /**
+     * @brief 全エントリを破棄して無効にする
+     */
+    void clear();
+
+    /**
+     * @brief 一覧・存在確認に使える状態か
+     */
+    bool isValid() const { return _valid; }
+
+    /**
+     * @brief ファイル名でエントリを検索（大文字小文字を区別しない）
+     * @return 見つからない場合nullptr
+     */
+    const DirectoryIndexEntry* find(const char* name) const;
+
+    /**
+     * @brief ファイルが存在するか
+     */
+    bool contains(const char* name) const { return find(name) != nullptr; }
+
+    /**
+     * @brief 名前が prefix で始まるエントリの範囲を取得（大文字小文字を区別しない、二分探索）
+     * @param prefix 接頭辞
+     * @param count 該当件数
+     * @return 名前順での先頭位置
+     * @note 名前順の配列は接頭辞ごとに連続するため、トライ木と同じ範囲を追加のメモリなしで求められる
+     */
+    size_t prefixRange(const char* prefix, size_t& count) const;
+
+    /**
+     * @brief エントリ数を取得
+     */
+    size_t getEntryCount() const { return _entries.size(); }
+
+    /**
+     * @brief 名前順で i 番目のエントリを取得
+     */
+    const DirectoryIndexEntry& getEntry(size_t i) const { return _entries[i]; }
+
+    /**
+     * @brief 指定した並び順（昇順）で i 番目のエントリを取得
+     */
+    const DirectoryIndexEntry& getEntry(size_t i, DirectoryIndexOrder order) const;
+
+    /**
+     * @brief サイズ順・更新時刻順で、値が value 以上になる最初の位置を取得（二分探索）
+     * @return 該当なしの場合 getEntryCount()（名前順では常に0）
+     */
+    size_t lowerBound(DirectoryIndexOrder order, uint32_t value) const;
+
+    /**
+     * @brief ファイルの作成・更新を反映（同名のエントリがあればサイズと更新時刻を上書き）
+     * @note 上限を超える場合はインデックスを無効にする
+     */
+    void update(const char* name, uint32_t size, uint32_t modified);
+
+    /**
+     * @brief ファイルの削除を反映
+     */
+    void remove(const char* name);
+
+    /**
+     * @brief ファイルのリネームを反映（サイズと更新時刻は引き継ぐ）
+     */
+    void rename(const char* from, const char* to);
+
+    /**
+     * @brief 外部からの変更の検証を少しずつ進める（ループ内で定期的に呼び出す）
+     * @return 食い違いを検出してインデックスを作り直した場合true
+     */
+    bool verifyStep();
+
+    /**
+     * @brief 統計情報を取得
+     */
+    DirectoryIndexStats getStats() const;
+
+private:
+    std::vector<DirectoryIndexEntry> _entries;   // 名前順
+    std::vector<uint32_t> _bySize;               // サイズ順の _entries の位置
+    std::vector<uint32_t> _byModified;           // 更新時刻順の _entries の位置
+    String _path;
+    const ShardedLayout* _layout;
+    uint32_t _maxEntries;
+    uint32_t _verifyInterval;
+    size_t _nameBytes;          // ファイル名に確保した合計バイト数
+    uint32_t _checksum;         // 全エントリの _entryHash() の和
+    uint32_t _generation;       // 変更のたびに増加（検証の途中結果を無効にする）
+    uint32_t _rebuilds;
+    uint32_t _externalChanges;
+    uint32_t _lastRebuildMs;
+    uint32_t _lastLoadMs;
+    uint32_t _journalRecords;
+    uint32_t _compactions;
+    bool _persistent;
+    bool _loadedFromFile;
+    bool _valid;
+
+    // 検証パスの状態
+    File _verifyDir;
+    uint16_t _verifyBucket;     // 次に読むバケット
+    uint32_t _verifyGeneration;
+    uint32_t _verifyCount;
+    uint32_t _verifyChecksum;
+    unsigned long _lastVerify;
+
+    size_t _lowerBound(const char* name) const;
+    bool _scan(const char* dirPath, bool required);
+    uint16_t _bucketCount() const { return _layout ? _layout->getBucketCount() : 0; }
+    bool _update(const char* name, uint32_t size, uint32_t modified);
+    bool _remove(const char* name);
+    bool _insert(size_t pos, const char* name, uint32_t size, uint32_t modified);
+    void _erase(size_t pos);
+    void _releaseEntries();
+
+    // サイズ順・更新時刻順の配列
+    std::vector<uint32_t>& _orderList(DirectoryIndexOrder order);
+    uint32_t _orderKey(DirectoryIndexOrder order, uint32_t pos) const;
+    size_t _orderPosition(DirectoryIndexOrder order, uint32_t pos) const;
+    void _buildOrders();
+    void _linkOrders(uint32_t pos);
+    void _unlinkOrders(uint32_t pos);
+    void _shiftOrders(uint32_t from, int delta);
+
+    // 永続インデックス
+    String _indexFilePath() const;
+    void _fillHeader(DirectoryIndexFileHeader& header, uint32_t stringBytes) const;
+    bool _load();
+    bool _replayJournal(File& file);
+    bool _writeSnapshot();
+    void _appendJournal(uint8_t op, const char* name, uint32_t size, uint32_t modified);
+    void _removeIndexFile();
+
+    // 外部変更の検証
+    void _stopVerify();
+    bool _nextVerifyDir();
+    bool _finishVerify();
+    static uint32_t _entryHash(const char* name, uint32_t size);
+    static char* _allocateName(const char* name, size_t length);
+};
+
+#endif // DIRECTORY_INDEX_H
@@ -0,0 +1,203 @@
+#include "DirectoryStats.h"
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+DirectoryStats::DirectoryStats()
+    : _rebuilds(0),
+      _lastRebuildMs(0) {
+    clear();
+    _exact = false;
+}
+
+// ============================================================================
+// 差分更新
+// ============================================================================
+
+void DirectoryStats::clear() {
+    _extensionCount = 0;
+    _otherFiles = 0;
+    _otherBytes = 0;
+    _files = 0;
+    _bytes = 0;
+    _oldest = 0;
+    _newest = 0;
+    _exact = true;
+    _boundsExact = true;
+}
+
+void DirectoryStats::add(const char* name, uint32_t size, uint32_t modified) {
+    ExtensionStats* slot = _find(name, true);
+    if (slot) {
+        slot->files++;
+        slot->bytes += size;
+    } else {
+        _otherFiles++;
+        _otherBytes += size;
+    }
+
+    _files++;
+    _bytes += size;
+    if (modified == 0) return;
+    if (_oldest == 0 || modified < _oldest) _oldest = modified;
+    if (modified > _newest) _newest = modified;
+}
+
+void DirectoryStats::remove(const char* name, uint32_t size, uint32_t modified) {
+    // 数え直していない状態では実際より少なく数えている場合があるので、0で止める
+    ExtensionStats* slot = _find(name, false);
+    if (slot) {
+        slot->files--;
+        slot->bytes -= size < slot->bytes ? size : slot->bytes;
+        if (slot->files == 0) _release(slot);
+    } else if (_otherFiles > 0) {
+        _otherFiles--;
+        _otherBytes -= size < _otherBytes ? size : _otherBytes;
+    }
+
+    if (_files > 0) _files--;
+    _bytes -= size < _bytes ? size : _bytes;
+    if (_files == 0) {
+        _bytes = 0;
+        _oldest = 0;
+        _newest = 0;
+        _boundsExact = true;
+    } else if (modified != 0 && (modified <= _oldest || modified >= _newest)) {
+        // 範囲の端のファイルが消えたので、次に古い（新しい）値はこの集計からは分からない
+        _boundsExact = false;
+    }
+}
+
+void DirectoryStats::resize(const char* name, uint32_t oldSize, uint32_t newSize, uint32_t oldModified,
+                            uint32_t modified) {
+    ExtensionStats* slot = _find(name, false);
+    uint64_t& bytes = slot ? slot->bytes : _otherBytes;
+    bytes = bytes - (oldSize < bytes ? oldSize : bytes) + newSize;
+    _bytes = _bytes - (oldSize < _bytes ? oldSize : _bytes) + newSize;
+
+    // 追記したファイルは最新になる（元の時刻が最古、または不明な場合は最古が分からなくなる）
+    if (modified == 0) return;
+    if (_files == 1) {
+        _oldest = modified;
+    } else if (oldModified == 0 || oldModified <= _oldest) {
+        _boundsExact = false;
+    }
+    if (modified > _newest) _newest = modified;
+}
+
+void DirectoryStats::setBounds(uint32_t oldest, uint32_t newest) {
+    _oldest = oldest;
+    _newest = newest;
+    _boundsExact = true;
+}
+
+// ============================================================================
+// 数え直し
+// ============================================================================
+
+bool DirectoryStats::rebuild(const String& path, const ShardedLayout* layout) {
+    unsigned long startTime = millis();
+    clear();
+
+    bool complete = _scan(path.c_str(), true);
+    uint16_t buckets = layout ? layout->getBucketCount() : 0;
+    for (uint16_t bucket = 0; complete && bucket < buckets; bucket++) {
+        complete = _scan(layout->bucketPath(path, bucket).c_str(), false);
+    }
+
+    _exact = complete;
+    _rebuilds++;
+    _lastRebuildMs = millis() - startTime;
+    return complete;
+}
+
+bool DirectoryStats::_scan(const char* dirPath, bool required) {
+    File dir = SD.open(dirPath);
+    if (!dir || !dir.isDirectory()) {
+        if (dir) dir.close();
+        // まだ作られていないバケットは空として扱う
+        return !required;
+    }
+
+    File entry = dir.openNextFile();
+    while (entry) {
+        if (!entry.isDirectory()) {
+            add(entry.name(), entry.size(), (uint32_t)entry.getLastWrite());
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    dir.close();
+    return true;
+}
+
+// ============================================================================
+// 出力
+// ============================================================================
+
+void DirectoryStats::writeJson(JsonWriter& json) const {
+    json.beginObject();
+    json.field("files", _files);
+    json.field("bytes", (unsigned long long)_bytes);
+    json.field("oldest", _oldest);
+    json.field("newest", _newest);
+    json.field("exact", _exact);
+    json.field("exactBounds", _boundsExact);
+    json.key("extensions");
+    json.beginObject();
+    for (uint8_t i = 0; i < _extensionCount; i++) {
+        json.key(_extensions[i].extension);
+        json.beginObject();
+        json.field("files", _extensions[i].files);
+        json.field("bytes", (unsigned long long)_extensions[i].bytes);
+        json.endObject();
+    }
+    json.endObject();
+    json.key("other");
+    json.beginObject();
+    json.field("files", _otherFiles);
+    json.field("bytes", (unsigned long long)_otherBytes);
+    json.endObject();
+    json.field("rebuilds", _rebuilds);
+    json.field("lastRebuildMs", _lastRebuildMs);
+    json.endObject();
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+ExtensionStats* DirectoryStats::_find(const char* name, bool create) {
+    // 拡張子は DirectoryIndexEntry と同じく最後の '.' 以降（先頭の '.' は拡張子としない）
+    const char* dot = strrchr(name, '.');
+    const char* ext = (dot && dot != name) ? dot + 1 : "";
+    size_t length = strlen(ext);
+    if (length >= DIRECTORY_STATS_EXTENSION_LENGTH) return nullptr;
+
+    char lower[DIRECTORY_STATS_EXTENSION_LENGTH];
+    for (size_t i = 0; i <= length; i++) {
+        lower[i] = tolower((unsigned char)ext[i]);
+    }
+
+    for (uint8_t i = 0; i < _extensionCount; i++) {
+        if (strcmp(_extensions[i].extension, lower) == 0) return &_extensions[i];
+    }
+
+    // 「その他」に数えたファイルが残っている間は新しい拡張子を表に加えない
+    // （同じ拡張子が表と「その他」に分かれると、削除時にどちらから引くか決められない）
+    if (!create || _otherFiles > 0 || _extensionCount >= DIRECTORY_STATS_MAX_EXTENSIONS) return nullptr;
+
+    ExtensionStats* slot = &_extensions[_extensionCount++];
+    memcpy(slot->extension, lower, length + 1);
+    slot->files = 0;
+    slot->bytes = 0;
+    return slot;
+}
+
+void DirectoryStats::_release(ExtensionStats* slot) {
+    // 末尾の要素で埋める（表の順序は意味を持たない）
+    ExtensionStats* last = &_extensions[_extensionCount - 1];
+    if (slot != last) *slot = *last;
+    _extensionCount--;
+}
@@ -0,0 +1,108 @@
+#ifndef DIRECTORY_STATS_H
+#define DIRECTORY_STATS_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+#include "Config.h"
+#include "JsonWriter.h"
+#include "ShardedLayout.h"
+
+// ============================================================================
+// 拡張子ごとの集計
+// ============================================================================
+struct ExtensionStats {
+    char extension[DIRECTORY_STATS_EXTENSION_LENGTH];   // 小文字の拡張子（拡張子なしは空文字列）
+    uint32_t files;
+    uint64_t bytes;
+};
+
+/**
+ * @brief アップロードディレクトリのファイル数・合計サイズ・拡張子ごとの内訳・更新時刻の範囲を保持する集計
+ *
+ * ライブラリ自身のアップロード・削除・追記・リネームに合わせて差分で更新し、
+ * 参照はディレクトリの大きさによらず一定の時間で済みます。
+ * 拡張子の表は DIRECTORY_STATS_MAX_EXTENSIONS 種類までで、あふれた拡張子は「その他」にまとめます。
+ *
+ * 最古・最新の更新時刻は、範囲の端にあったファイルを削除すると次の値が分からなくなるため
+ * hasExactBounds() == false とし、呼び出し側がインデックスなどから setBounds() で補います。
+ * ライブラリ外での変更は検出しないので、必要なときに rebuild() で数え直します。
+ */
+class DirectoryStats {
+public:
+    DirectoryStats();
+
+    /**
+     * @brief 全ての集計を0にする（空のディレクトリとして正確な状態）
+     */
+    void clear();
+
+    /**
+     * @brief 集計が実際の内容と一致している保証がないものとする（起動直後で数え直していない場合など）
+     */
+    void invalidate() { _exact = false; }
+
+    /**
+     * @brief ファイルの追加を反映
+     * @param modified 更新時刻（UNIXタイムスタンプ、0は不明として範囲に含めない）
+     */
+    void add(const char* name, uint32_t size, uint32_t modified);
+
+    /**
+     * @brief ファイルの削除（上書き前の内容を含む）を反映
+     */
+    void remove(const char* name, uint32_t size, uint32_t modified);
+
+    /**
+     * @brief 追記によるサイズ・更新時刻の変化を反映
+     * @param oldModified 追記前の更新時刻（0は不明、最古の値が分からなくなる）
+     */
+    void resize(const char* name, uint32_t oldSize, uint32_t newSize, uint32_t oldModified, uint32_t modified);
+
+    /**
+     * @brief 最古・最新の更新時刻を外部で求めた正確な値にする
+     */
+    void setBounds(uint32_t oldest, uint32_t newest);
+
+    /**
+     * @brief ディレクトリを走査して数え直す（直下と各バケット、サブディレクトリ内は含めない）
+     * @param path ディレクトリのパス
+     * @param layout バケット配置（nullptrで直下のみ）
+     * @return 走査できた場合true
+     */
+    bool rebuild(const String& path, const ShardedLayout* layout);
+
+    /**
+     * @brief JSONオブジェクトとして書き出す
+     */
+    void writeJson(JsonWriter& json) const;
+
+    bool isExact() const { return _exact; }
+    bool hasExactBounds() const { return _boundsExact; }
+    uint32_t getFileCount() const { return _files; }
+    uint64_t getTotalBytes() const { return _bytes; }
+    uint32_t getOldest() const { return _oldest; }
+    uint32_t getNewest() const { return _newest; }
+    uint32_t getRebuildCount() const { return _rebuilds; }
+    uint32_t getLastRebuildMs() const { return _lastRebuildMs; }
+
+private:
+    ExtensionStats _extensions[DIRECTORY_STATS_MAX_EXTENSIONS];
+    uint8_t _extensionCount;
+    uint32_t _otherFiles;         // 表に入らなかった拡張子のファイル
+    uint64_t _otherBytes;
+    uint32_t _files;
+    uint64_t _bytes;
+    uint32_t _oldest;
+    uint32_t _newest;
+    bool _exact;
+    bool _boundsExact;
+    uint32_t _rebuilds;
+    uint32_t _lastRebuildMs;
+
+    ExtensionStats* _find(const char* name, bool create);
+    void _release(ExtensionStats* slot);
+    bool _scan(const char* dirPath, bool required);
+};
+
+#endif // DIRECTORY_STATS_H
@@ -0,0 +1,234 @@
+#include "DownloadStreamer.h"
+
+// リーダータスクへ停止を伝える番兵スロット
+static const uint8_t SLOT_STOP = 0xFF;
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+DownloadStreamer::DownloadStreamer()
+    : _bufferSize(DEFAULT_DOWNLOAD_BUFFER_SIZE),
+      _bufferCount(DEFAULT_DOWNLOAD_BUFFER_COUNT),
+      _file(nullptr),
+      _remaining(0),
+      _abort(false),
+      _freeQueue(nullptr),
+      _filledQueue(nullptr),
+      _readerDone(nullptr),
+      _usedPSRAM(false),
+      _preparedCount(0) {
+    for (uint8_t i = 0; i < MAX_DOWNLOAD_BUFFER_COUNT; i++) {
+        _buffers[i] = nullptr;
+        _lengths[i] = 0;
+    }
+}
+
+DownloadStreamer::~DownloadStreamer() {
+    _release();
+}
+
+// ============================================================================
+// 設定
+// ============================================================================
+
+void DownloadStreamer::configure(size_t bufferSize, uint8_t bufferCount) {
+    // セクタ境界に揃えると、FatFsが複数セクタをまとめてバッファへ直接読み込む
+    if (bufferSize < 512) bufferSize = 512;
+    _bufferSize = (bufferSize + 511) & ~(size_t)511;
+    _bufferCount = constrain(bufferCount, 2, MAX_DOWNLOAD_BUFFER_COUNT);
+}
+
+// ============================================================================
+// 転送
+// ============================================================================
+
+bool DownloadStreamer::prepare() {
+    _release();
+    _usedPSRAM = false;
+
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < _bufferCount; i++) {
+        uint8_t* buf = nullptr;
+        if (psramFound()) {
+            buf = (uint8_t*)ps_malloc(_bufferSize);
+            if (buf) _usedPSRAM = true;
+        }
+        if (!buf) {
+            buf = (uint8_t*)malloc(_bufferSize);
+        }
+        if (!buf) break;
+
+        _buffers[i] = buf;
+        _lengths[i] = 0;
+        count++;
+    }
+
+    // 先読みと送信を重ねるには最低2面必要
+    if (count < 2) {
+        _release();
+        return false;
+    }
+
+    _freeQueue = xQueueCreate(count + 1, sizeof(uint8_t));
+    _filledQueue = xQueueCreate(count, sizeof(uint8_t));
+    _readerDone = xSemaphoreCreateBinary();
+    if (!_freeQueue || !_filledQueue || !_readerDone) {
+        _release();
+        return false;
+    }
+
+    _preparedCount = count;
+    return true;
+}
+
+bool DownloadStreamer::stream(File& file, WiFiClient& client, size_t length, DownloadStats& stats) {
+    stats.bytesSent = 0;
+    stats.elapsedMs = 0;
+    stats.bytesPerSecond = 0.0f;
+    stats.readStallMs = 0;
+    stats.bufferSize = _bufferSize;
+    stats.bufferCount = _preparedCount;
+    stats.usedPSRAM = _usedPSRAM;
+    stats.usedEngine = true;
+    stats.completed = false;
+
+    if (_preparedCount < 2) {
+        return false;
+    }
+
+    _file = &file;
+    _remaining = length;
+    _abort = false;
+    for (uint8_t i = 0; i < _preparedCount; i++) {
+        xQueueSend(_freeQueue, &i, 0);
+    }
+
+    unsigned long startTime = millis();
+    uint32_t stallMs = 0;
+    size_t sent = 0;
+
+    if (xTaskCreate(_readerTask, "dl_reader", DOWNLOAD_READER_STACK_SIZE, this,
+                    uxTaskPriorityGet(nullptr), nullptr) != pdPASS) {
+        // タスクを生成できない場合は同一スレッドで読み込みと送信を交互に行う
+        sent = _streamSync(client, length);
+    } else {
+        while (sent < length) {
+            // 先読み済みのブロックを受け取る（待ち時間はSD読み込みが律速している時間）
+            uint8_t slot;
+            unsigned long waitStart = millis();
+            if (xQueueReceive(_filledQueue, &slot, pdMS_TO_TICKS(DEFAULT_TIMEOUT)) != pdTRUE) {
+                break;
+            }
+            stallMs += millis() - waitStart;
+
+            size_t len = _lengths[slot];
+            if (len == 0) {
+                break;  // 読み込みエラー
+            }
+
+            size_t written = _writeAll(client, _buffers[slot], len);
+            sent += written;
+            if (written < len) {
+                break;  // クライアント切断
+            }
+
+            // 送信済みバッファをリーダーへ返却
+            xQueueSend(_freeQueue, &slot, portMAX_DELAY);
+        }
+
+        // リーダータスクを停止して終了を待つ
+        _abort = true;
+        uint8_t stop = SLOT_STOP;
+        xQueueSend(_freeQueue, &stop, 0);
+        xSemaphoreTake(_readerDone, portMAX_DELAY);
+    }
+
+    stats.bytesSent = sent;
+    stats.elapsedMs = millis() - startTime;
+    stats.bytesPerSecond = stats.elapsedMs > 0 ? (sent * 1000.0f) / stats.elapsedMs : 0.0f;
+    stats.readStallMs = stallMs;
+    stats.completed = (sent == length);
+
+    _release();
+    return stats.completed;
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+void DownloadStreamer::_release() {
+    for (uint8_t i = 0; i < MAX_DOWNLOAD_BUFFER_COUNT; i++) {
+        if (_buffers[i]) {
+            free(_buffers[i]);
+            _buffers[i] = nullptr;
+        }
+    }
+    if (_freeQueue) {
+        vQueueDelete(_freeQueue);
+        _freeQueue = nullptr;
+    }
+    if (_filledQueue) {
+        vQueueDelete(_filledQueue);
+        _filledQueue = nullptr;
+    }
+    if (_readerDone) {
+        vSemaphoreDelete(_readerDone);
+        _readerDone = nullptr;
+    }
+    _file = nullptr;
+    _preparedCount = 0;
+}
+
+size_t DownloadStreamer::_writeAll(WiFiClient& client, const uint8_t* data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        size_t n = client.write(data + written, len - written);
+        if (n == 0) break;
+        written += n;
+    }
+    return written;
+}
+
+size_t DownloadStreamer::_streamSync(WiFiClient& client, size_t length) {
+    size_t sent = 0;
+    while (sent < length) {
+        size_t toRead = (length - sent) < _bufferSize ? (length - sent) : _bufferSize;
+        size_t n = _file->read(_buffers[0], toRead);
+        if (n == 0) break;
+
+        size_t written = _writeAll(client, _buffers[0], n);
+        sent += written;
+        if (written < n) break;
+    }
+    return sent;
+}
+
+void DownloadStreamer::_readerTask(void* arg) {
+    DownloadStreamer* self = static_cast<DownloadStreamer*>(arg);
+
+    while (self->_remaining > 0 && !self->_abort) {
+        uint8_t slot;
+        if (xQueueReceive(self->_freeQueue, &slot, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (slot == SLOT_STOP || self->_abort) {
+            break;
+        }
+
+        // 空きバッファへ次のブロックを順方向に読み込む
+        size_t toRead = self->_remaining < self->_bufferSize ? self->_remaining : self->_bufferSize;
+        size_t n = self->_file->read(self->_buffers[slot], toRead);
+        self->_lengths[slot] = n;
+        self->_remaining -= n;
+        xQueueSend(self->_filledQueue, &slot, portMAX_DELAY);
+
+        if (n == 0) {
+            break;  // 長さ0のブロックで送信側へエラーを伝える
+        }
+    }
+
+    xSemaphoreGive(self->_readerDone);
+    vTaskDelete(nullptr);
+}
@@ -0,0 +1,109 @@
+#ifndef DOWNLOAD_STREAMER_H
+#define DOWNLOAD_STREAMER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <WiFi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "Config.h"
+
+// ============================================================================
+// ダウンロード統計情報
+// ============================================================================
+struct DownloadStats {
+    String filename;          // ファイル名
+    uint32_t bytesSent;       // 送信済みバイト数
+    uint32_t elapsedMs;       // 所要時間（ミリ秒）
+    float bytesPerSecond;     // 実効転送速度（バイト/秒）
+    uint32_t readStallMs;     // 送信側がSD読み込み完了を待った時間（ミリ秒）
+    size_t bufferSize;        // 使用したバッファサイズ
+    uint8_t bufferCount;      // 使用したバッファ数
+    bool usedPSRAM;           // PSRAMバッファを使用したか
+    bool usedEngine;          // true=DownloadStreamer, false=WebServer::streamFile()
+    bool completed;           // 全バイト送信できたか
+};
+
+/**
+ * @brief SD読み込みとTCP送信を並行させるダウンロードエンジン
+ *
+ * 複数の大きなバッファ（PSRAMがあればPSRAM上）を用意し、
+ * リーダータスクが次のブロックをSDから先読みしている間に
+ * 呼び出し側が前のブロックをクライアントへ送信します。
+ */
+class DownloadStreamer {
+public:
+    DownloadStreamer();
+    ~DownloadStreamer();
+
+    // ========================================================================
+    // 設定
+    // ========================================================================
+
+    /**
+     * @brief バッファ構成を設定
+     * @param bufferSize 1バッファのサイズ（セクタ境界に切り上げ）
+     * @param bufferCount バッファ数（2〜MAX_DOWNLOAD_BUFFER_COUNT）
+     */
+    void configure(size_t bufferSize, uint8_t bufferCount);
+
+    /**
+     * @brief バッファサイズを取得
+     */
+    size_t getBufferSize() const { return _bufferSize; }
+
+    /**
+     * @brief バッファ数を取得
+     */
+    uint8_t getBufferCount() const { return _bufferCount; }
+
+    // ========================================================================
+    // 転送
+    // ========================================================================
+
+    /**
+     * @brief バッファとキューを確保（レスポンスヘッダー送信前に呼び出す）
+     * @return 2面以上のバッファを確保できればtrue
+     */
+    bool prepare();
+
+    /**
+     * @brief 確保したバッファを解放（prepare後に送信しない場合）
+     */
+    void release() { _release(); }
+
+    /**
+     * @brief ファイルの現在位置からlengthバイトをクライアントへ送信
+     * @param file 読み込み用に開いたファイル
+     * @param client 送信先クライアント（ヘッダー送信済みであること）
+     * @param length 送信するバイト数
+     * @param stats 統計情報の出力先
+     * @return 全バイト送信できればtrue（終了後バッファは解放される）
+     */
+    bool stream(File& file, WiFiClient& client, size_t length, DownloadStats& stats);
+
+private:
+    size_t _bufferSize;
+    uint8_t _bufferCount;
+
+    // 転送中のみ有効な状態（リーダータスクと共有）
+    uint8_t* _buffers[MAX_DOWNLOAD_BUFFER_COUNT];
+    size_t _lengths[MAX_DOWNLOAD_BUFFER_COUNT];
+    File* _file;
+    size_t _remaining;
+    volatile bool _abort;
+    QueueHandle_t _freeQueue;
+    QueueHandle_t _filledQueue;
+    SemaphoreHandle_t _readerDone;
+    bool _usedPSRAM;
+    uint8_t _preparedCount;
+
+    void _release();
+    size_t _writeAll(WiFiClient& client, const uint8_t* data, size_t len);
+    size_t _streamSync(WiFiClient& client, size_t length);
+    static void _readerTask(void* arg);
+};
+
+#endif // DOWNLOAD_STREAMER_H
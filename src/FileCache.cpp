@@ -0,0 +1,153 @@
+#include "FileCache.h"
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+FileCache::FileCache()
+    : _capacity(0),
+      _maxEntrySize(0),
+      _usedBytes(0),
+      _hits(0),
+      _misses(0),
+      _evictions(0),
+      _invalidations(0) {
+}
+
+FileCache::~FileCache() {
+    clear();
+}
+
+// ============================================================================
+// 設定
+// ============================================================================
+
+void FileCache::configure(size_t capacity, size_t maxEntrySize) {
+    clear();
+    _capacity = capacity;
+    _maxEntrySize = min(maxEntrySize, capacity);
+}
+
+// ============================================================================
+// 検索・追加
+// ============================================================================
+
+const FileCacheEntry* FileCache::lookup(const String& key) {
+    if (_capacity == 0) return nullptr;
+
+    auto found = _index.find(key);
+    if (found == _index.end()) {
+        _misses++;
+        return nullptr;
+    }
+
+    // 最近使用した位置（先頭）へ移動（イテレータは無効にならない）
+    _entries.splice(_entries.begin(), _entries, found->second);
+    _hits++;
+    return &(*found->second);
+}
+
+const FileCacheEntry* FileCache::insert(const String& key, const String& name, File& file,
+                                        uint32_t size, time_t lastWrite, bool gzipEncoded) {
+    if (!accepts(size)) return nullptr;
+
+    auto found = _index.find(key);
+    if (found != _index.end()) {
+        _erase(found->second);
+    }
+
+    // 収まるまで最も古いエントリから追い出す
+    while (!_entries.empty() && _usedBytes + size > _capacity) {
+        _erase(std::prev(_entries.end()));
+        _evictions++;
+    }
+
+    uint8_t* data = _allocate(max(size, (uint32_t)1));
+    if (!data) return nullptr;
+
+    uint32_t loaded = 0;
+    while (loaded < size) {
+        size_t n = file.read(data + loaded, size - loaded);
+        if (n == 0) break;
+        loaded += n;
+    }
+    if (loaded != size) {
+        free(data);
+        return nullptr;
+    }
+
+    FileCacheEntry entry;
+    entry.key = key;
+    entry.name = name;
+    entry.data = data;
+    entry.size = size;
+    entry.lastWrite = lastWrite;
+    entry.gzipEncoded = gzipEncoded;
+    _entries.push_front(entry);
+    _index[key] = _entries.begin();
+    _usedBytes += size;
+    return &_entries.front();
+}
+
+// ============================================================================
+// 無効化
+// ============================================================================
+
+void FileCache::invalidate(const String& name) {
+    // "name.gz" が変更された場合は "name" の圧縮表現も古くなる
+    String baseName = name.endsWith(".gz") ? name.substring(0, name.length() - 3) : name;
+
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        auto next = std::next(it);
+        if (it->name == name || it->name == baseName) {
+            _erase(it);
+            _invalidations++;
+        }
+        it = next;
+    }
+}
+
+void FileCache::clear() {
+    for (auto& entry : _entries) {
+        free(entry.data);
+    }
+    _entries.clear();
+    _index.clear();
+    _usedBytes = 0;
+}
+
+FileCacheStats FileCache::getStats() const {
+    FileCacheStats stats;
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.evictions = _evictions;
+    stats.invalidations = _invalidations;
+    stats.usedBytes = _usedBytes;
+    stats.capacity = _capacity;
+    stats.maxEntrySize = _maxEntrySize;
+    stats.entries = _entries.size();
+    stats.usePSRAM = psramFound();
+    return stats;
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+void FileCache::_erase(std::list<FileCacheEntry>::iterator it) {
+    _usedBytes -= it->size;
+    free(it->data);
+    _index.erase(it->key);
+    _entries.erase(it);
+}
+
+uint8_t* FileCache::_allocate(size_t size) {
+    uint8_t* data = nullptr;
+    if (psramFound()) {
+        data = (uint8_t*)ps_malloc(size);
+    }
+    if (!data) {
+        data = (uint8_t*)malloc(size);
+    }
+    return data;
+}
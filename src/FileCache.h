@@ -0,0 +1,110 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <list>
+#include <map>
+#include "Config.h"
+
+// ============================================================================
+// キャッシュエントリ
+// ============================================================================
+struct FileCacheEntry {
+    String key;               // キャッシュキー（表現ごとに異なる）
+    String name;              // ダウンロード時のファイル名（無効化に使用）
+    uint8_t* data;            // ファイル内容
+    uint32_t size;            // サイズ（バイト）
+    time_t lastWrite;         // キャッシュ時点の更新時刻（ETag用）
+    bool gzipEncoded;         // 事前圧縮された ".gz" の内容か
+};
+
+// ============================================================================
+// キャッシュ統計情報
+// ============================================================================
+struct FileCacheStats {
+    uint32_t hits;            // ヒット数
+    uint32_t misses;          // ミス数
+    uint32_t evictions;       // 容量不足による追い出し数
+    uint32_t invalidations;   // 書き込み・削除による無効化数
+    size_t usedBytes;         // 使用中のバイト数
+    size_t capacity;          // 容量（バイト）
+    size_t maxEntrySize;      // キャッシュ対象とする最大ファイルサイズ
+    uint16_t entries;         // エントリ数
+    bool usePSRAM;            // PSRAMを優先して確保しているか
+};
+
+/**
+ * @brief 小さなファイルを保持するサイズ上限付きLRUキャッシュ
+ *
+ * 頻繁にダウンロードされる小さなファイルをメモリ（PSRAMがあればPSRAM）に保持し、
+ * SDカードへのアクセスなしで配信できるようにします。
+ * 内容の鮮度は書き込み・削除時の invalidate() で保証します。
+ */
+class FileCache {
+public:
+    FileCache();
+    ~FileCache();
+
+    /**
+     * @brief 容量を設定（既存のエントリは破棄される）
+     * @param capacity 全体の上限バイト数（0で無効）
+     * @param maxEntrySize キャッシュ対象とする最大ファイルサイズ
+     */
+    void configure(size_t capacity, size_t maxEntrySize);
+
+    /**
+     * @brief キャッシュ対象となるサイズか判定
+     */
+    bool accepts(uint32_t size) const { return _capacity > 0 && size <= _maxEntrySize; }
+
+    /**
+     * @brief エントリを検索（ヒット時は最近使用した位置へ移動）
+     * @return 見つからない場合nullptr
+     */
+    const FileCacheEntry* lookup(const String& key);
+
+    /**
+     * @brief ファイル内容を読み込んでエントリを追加（必要に応じて古いエントリを追い出す）
+     * @param key キャッシュキー
+     * @param name ダウンロード時のファイル名
+     * @param file 読み込み用に開いたファイル（先頭から size バイトを読む）
+     * @param size ファイルサイズ
+     * @param lastWrite 更新時刻
+     * @param gzipEncoded 事前圧縮ファイルか
+     * @return 追加したエントリ（メモリ不足・読み込み失敗時はnullptr）
+     */
+    const FileCacheEntry* insert(const String& key, const String& name, File& file,
+                                 uint32_t size, time_t lastWrite, bool gzipEncoded);
+
+    /**
+     * @brief ファイル名に対応するエントリ（"name.gz" の変更時は "name" も含む）を破棄
+     */
+    void invalidate(const String& name);
+
+    /**
+     * @brief 全エントリを破棄
+     */
+    void clear();
+
+    /**
+     * @brief 統計情報を取得
+     */
+    FileCacheStats getStats() const;
+
+private:
+    std::list<FileCacheEntry> _entries;   // 先頭が最近使用したエントリ
+    std::map<String, std::list<FileCacheEntry>::iterator> _index;
+    size_t _capacity;
+    size_t _maxEntrySize;
+    size_t _usedBytes;
+    uint32_t _hits;
+    uint32_t _misses;
+    uint32_t _evictions;
+    uint32_t _invalidations;
+
+    void _erase(std::list<FileCacheEntry>::iterator it);
+    uint8_t* _allocate(size_t size);
+};
+
+#endif // FILE_CACHE_H
@@ -0,0 +1,331 @@
+#include "GzipStream.h"
+#include <esp_rom_crc.h>
+
+// ============================================================================
+// Deflate定数（RFC 1951）
+// ============================================================================
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+#define GZIP_HASH_BITS 12
+#define GZIP_HASH_SIZE (1 << GZIP_HASH_BITS)
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+GzipStream::GzipStream()
+    : _output(nullptr),
+      _window(nullptr),
+      _head(nullptr),
+      _prev(nullptr),
+      _windowSize(0),
+      _fill(0),
+      _pos(0),
+      _bitBuffer(0),
+      _bitCount(0),
+      _outLength(0),
+      _crc(0),
+      _inputSize(0),
+      _outputSize(0),
+      _ok(false) {
+}
+
+GzipStream::~GzipStream() {
+    end();
+}
+
+// ============================================================================
+// 圧縮
+// ============================================================================
+
+bool GzipStream::begin(GzipOutputCallback output, uint8_t windowBits) {
+    end();
+
+    // 位置+1をuint16_tで保持するため、2W <= 32768 に制限
+    windowBits = constrain(windowBits, 9, 14);
+    _windowSize = (size_t)1 << windowBits;
+
+    size_t windowBytes = 2 * _windowSize;
+    size_t headBytes = GZIP_HASH_SIZE * sizeof(uint16_t);
+    size_t prevBytes = 2 * _windowSize * sizeof(uint16_t);
+    if (psramFound()) {
+        _window = (uint8_t*)ps_malloc(windowBytes);
+        _head = (uint16_t*)ps_malloc(headBytes);
+        _prev = (uint16_t*)ps_malloc(prevBytes);
+    }
+    if (!_window) _window = (uint8_t*)malloc(windowBytes);
+    if (!_head) _head = (uint16_t*)malloc(headBytes);
+    if (!_prev) _prev = (uint16_t*)malloc(prevBytes);
+    if (!_window || !_head || !_prev) {
+        end();
+        return false;
+    }
+    memset(_head, 0, headBytes);
+    memset(_prev, 0, prevBytes);
+
+    _output = output;
+    _fill = 0;
+    _pos = 0;
+    _bitBuffer = 0;
+    _bitCount = 0;
+    _outLength = 0;
+    _crc = 0;
+    _inputSize = 0;
+    _outputSize = 0;
+    _ok = true;
+
+    // gzipヘッダー（ID1 ID2 CM=deflate FLG=0 MTIME=0 XFL=0 OS=unknown）
+    static const uint8_t header[10] = { 0x1F, 0x8B, 0x08, 0x00, 0, 0, 0, 0, 0x00, 0xFF };
+    for (uint8_t i = 0; i < sizeof(header); i++) {
+        _putByte(header[i]);
+    }
+
+    // 固定ハフマンブロックを開始（BFINAL=0, BTYPE=01）
+    _putBits(0, 1);
+    _putBits(1, 2);
+    return _ok;
+}
+
+bool GzipStream::write(const uint8_t* data, size_t length) {
+    if (!_window || !_ok) return false;
+
+    _crc = esp_rom_crc32_le(_crc, data, length);
+    _inputSize += length;
+
+    while (length > 0 && _ok) {
+        if (_fill == 2 * _windowSize) {
+            _slide();
+        }
+        size_t space = 2 * _windowSize - _fill;
+        size_t n = length < space ? length : space;
+        memcpy(_window + _fill, data, n);
+        _fill += n;
+        data += n;
+        length -= n;
+
+        _compress(false);
+    }
+    return _ok;
+}
+
+bool GzipStream::finish() {
+    if (!_window || !_ok) return false;
+
+    _compress(true);
+    _putSymbol(256);  // ブロック終端
+
+    // 空の最終ブロック（BFINAL=1, BTYPE=01）
+    _putBits(1, 1);
+    _putBits(1, 2);
+    _putSymbol(256);
+    _alignToByte();
+
+    // gzipトレーラー（CRC32・入力サイズ、リトルエンディアン）
+    for (uint8_t i = 0; i < 4; i++) _putByte((_crc >> (8 * i)) & 0xFF);
+    for (uint8_t i = 0; i < 4; i++) _putByte((_inputSize >> (8 * i)) & 0xFF);
+    _flushOutput();
+    return _ok;
+}
+
+void GzipStream::end() {
+    if (_window) {
+        free(_window);
+        _window = nullptr;
+    }
+    if (_head) {
+        free(_head);
+        _head = nullptr;
+    }
+    if (_prev) {
+        free(_prev);
+        _prev = nullptr;
+    }
+    _output = nullptr;
+}
+
+size_t GzipStream::getMemoryUsage(uint8_t windowBits) {
+    windowBits = constrain(windowBits, 9, 14);
+    size_t windowSize = (size_t)1 << windowBits;
+    return 2 * windowSize + GZIP_HASH_SIZE * sizeof(uint16_t) + 2 * windowSize * sizeof(uint16_t);
+}
+
+// ============================================================================
+// プライベートメソッド - LZ77
+// ============================================================================
+
+void GzipStream::_compress(bool flush) {
+    while (_pos < _fill && _ok) {
+        size_t avail = _fill - _pos;
+        // 最長一致を探せるだけの先読みが溜まるまで待つ
+        if (!flush && avail < GZIP_MAX_MATCH) {
+            break;
+        }
+
+        size_t bestLength = 0;
+        size_t bestDistance = 0;
+        if (avail >= GZIP_MIN_MATCH) {
+            size_t maxLength = avail < GZIP_MAX_MATCH ? avail : GZIP_MAX_MATCH;
+            uint16_t candidate = _head[_hash(_pos)];
+            uint8_t chain = GZIP_MAX_CHAIN;
+
+            while (candidate && chain--) {
+                size_t candidatePos = candidate - 1;
+                size_t distance = _pos - candidatePos;
+                if (distance > _windowSize) {
+                    break;
+                }
+
+                const uint8_t* a = _window + candidatePos;
+                const uint8_t* b = _window + _pos;
+                if (a[bestLength] == b[bestLength]) {
+                    size_t length = 0;
+                    while (length < maxLength && a[length] == b[length]) {
+                        length++;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = distance;
+                        if (length == maxLength) break;
+                    }
+                }
+                candidate = _prev[candidatePos];
+            }
+            _insertHash(_pos);
+        }
+
+        if (bestLength >= GZIP_MIN_MATCH) {
+            _putMatch(bestLength, bestDistance);
+            for (size_t i = 1; i < bestLength; i++) {
+                if (_pos + i + GZIP_MIN_MATCH <= _fill) {
+                    _insertHash(_pos + i);
+                }
+            }
+            _pos += bestLength;
+        } else {
+            _putLiteral(_window[_pos]);
+            _pos++;
+        }
+    }
+}
+
+void GzipStream::_slide() {
+    // 後半Wバイトを前半へ移動し、ハッシュ位置をWだけ引き戻す
+    memmove(_window, _window + _windowSize, _fill - _windowSize);
+    _fill -= _windowSize;
+    _pos -= _windowSize;
+
+    for (size_t i = 0; i < GZIP_HASH_SIZE; i++) {
+        _head[i] = _head[i] > _windowSize ? _head[i] - _windowSize : 0;
+    }
+    for (size_t i = 0; i < _windowSize; i++) {
+        uint16_t v = _prev[i + _windowSize];
+        _prev[i] = v > _windowSize ? v - _windowSize : 0;
+    }
+    memset(_prev + _windowSize, 0, _windowSize * sizeof(uint16_t));
+}
+
+void GzipStream::_insertHash(size_t pos) {
+    uint16_t h = _hash(pos);
+    _prev[pos] = _head[h];
+    _head[h] = pos + 1;
+}
+
+uint16_t GzipStream::_hash(size_t pos) const {
+    uint32_t v = _window[pos] | (_window[pos + 1] << 8) | (_window[pos + 2] << 16);
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+// ============================================================================
+// プライベートメソッド - 固定ハフマン符号化
+// ============================================================================
+
+void GzipStream::_putLiteral(uint8_t value) {
+    _putSymbol(value);
+}
+
+void GzipStream::_putMatch(size_t length, size_t distance) {
+    int li = 28;
+    while (LENGTH_BASE[li] > length) li--;
+    _putSymbol(257 + li);
+    if (LENGTH_EXTRA[li]) {
+        _putBits(length - LENGTH_BASE[li], LENGTH_EXTRA[li]);
+    }
+
+    int di = 29;
+    while (DIST_BASE[di] > distance) di--;
+    _putHuffman(di, 5);
+    if (DIST_EXTRA[di]) {
+        _putBits(distance - DIST_BASE[di], DIST_EXTRA[di]);
+    }
+}
+
+void GzipStream::_putSymbol(uint16_t symbol) {
+    if (symbol < 144) {
+        _putHuffman(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        _putHuffman(0x190 + (symbol - 144), 9);
+    } else if (symbol < 280) {
+        _putHuffman(symbol - 256, 7);
+    } else {
+        _putHuffman(0xC0 + (symbol - 280), 8);
+    }
+}
+
+void GzipStream::_putHuffman(uint16_t code, uint8_t bits) {
+    // ハフマン符号はMSBから詰めるため、ビット順を反転してから出力
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < bits; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    _putBits(reversed, bits);
+}
+
+void GzipStream::_putBits(uint32_t value, uint8_t bits) {
+    _bitBuffer |= value << _bitCount;
+    _bitCount += bits;
+    while (_bitCount >= 8) {
+        _putByte(_bitBuffer & 0xFF);
+        _bitBuffer >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+void GzipStream::_putByte(uint8_t value) {
+    _outBuffer[_outLength++] = value;
+    if (_outLength == sizeof(_outBuffer)) {
+        _flushOutput();
+    }
+}
+
+void GzipStream::_alignToByte() {
+    if (_bitCount > 0) {
+        _putByte(_bitBuffer & 0xFF);
+    }
+    _bitBuffer = 0;
+    _bitCount = 0;
+}
+
+void GzipStream::_flushOutput() {
+    if (_outLength > 0 && _ok) {
+        _ok = _output(_outBuffer, _outLength);
+        _outputSize += _outLength;
+    }
+    _outLength = 0;
+}
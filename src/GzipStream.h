@@ -0,0 +1,100 @@
+#ifndef GZIP_STREAM_H
+#define GZIP_STREAM_H
+
+#include <Arduino.h>
+#include <functional>
+#include "Config.h"
+
+// ============================================================================
+// 出力コールバック（falseを返すと圧縮を中断）
+// ============================================================================
+typedef std::function<bool(const uint8_t* data, size_t length)> GzipOutputCallback;
+
+/**
+ * @brief 固定ハフマン符号によるストリーミングgzip圧縮器
+ *
+ * 窓サイズを制限したLZ77（ハッシュチェーン探索）と固定ハフマン符号で
+ * 入力を逐次圧縮し、gzip形式（RFC 1952）で出力します。
+ * 作業メモリは窓サイズに比例して固定され、入力長には依存しません。
+ */
+class GzipStream {
+public:
+    GzipStream();
+    ~GzipStream();
+
+    /**
+     * @brief 作業バッファを確保してgzipヘッダーを出力
+     * @param output 出力コールバック
+     * @param windowBits 窓サイズ（2^windowBits バイト、9〜14）
+     * @return 確保成功時true
+     * @note gzipヘッダーは内部バッファに保持され、最初の出力時にまとめて送られる
+     */
+    bool begin(GzipOutputCallback output, uint8_t windowBits = DEFAULT_GZIP_WINDOW_BITS);
+
+    /**
+     * @brief データを圧縮
+     * @param data 入力データ
+     * @param length 入力長
+     * @return 出力コールバックが失敗した場合false
+     */
+    bool write(const uint8_t* data, size_t length);
+
+    /**
+     * @brief 残りを圧縮してgzipトレーラー（CRC32・サイズ）を出力
+     * @return 出力成功時true
+     */
+    bool finish();
+
+    /**
+     * @brief 作業バッファを解放
+     */
+    void end();
+
+    /**
+     * @brief 入力バイト数を取得
+     */
+    uint32_t getInputSize() const { return _inputSize; }
+
+    /**
+     * @brief 出力バイト数を取得
+     */
+    uint32_t getOutputSize() const { return _outputSize; }
+
+    /**
+     * @brief 作業メモリ量を取得（バイト）
+     * @param windowBits 窓サイズ
+     */
+    static size_t getMemoryUsage(uint8_t windowBits = DEFAULT_GZIP_WINDOW_BITS);
+
+private:
+    GzipOutputCallback _output;
+    uint8_t* _window;        // 入力窓（2W バイト）
+    uint16_t* _head;         // ハッシュ先頭位置（位置+1、0=なし）
+    uint16_t* _prev;         // ハッシュチェーン（位置+1）
+    size_t _windowSize;      // W
+    size_t _fill;            // 窓内の有効バイト数
+    size_t _pos;             // 次に符号化する位置
+    uint32_t _bitBuffer;
+    uint8_t _bitCount;
+    uint8_t _outBuffer[256];
+    size_t _outLength;
+    uint32_t _crc;
+    uint32_t _inputSize;
+    uint32_t _outputSize;
+    bool _ok;
+
+    void _compress(bool flush);
+    void _slide();
+    void _insertHash(size_t pos);
+    uint16_t _hash(size_t pos) const;
+    void _putLiteral(uint8_t value);
+    void _putMatch(size_t length, size_t distance);
+    void _putSymbol(uint16_t symbol);
+    void _putHuffman(uint16_t code, uint8_t bits);
+    void _putBits(uint32_t value, uint8_t bits);
+    void _putByte(uint8_t value);
+    void _alignToByte();
+    void _flushOutput();
+};
+
+#endif // GZIP_STREAM_H
@@ -0,0 +1,366 @@
+#include "JpegEncoder.h"
+#include <math.h>
+
+// ============================================================================
+// 標準テーブル（ITU-T T.81 Annex K）
+// ============================================================================
+
+// ジグザグ順 → 自然順のインデックス
+static const uint8_t ZIGZAG[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static const uint8_t STD_QUANT[2][64] = {
+    {
+        16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99
+    },
+    {
+        17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+    }
+};
+
+// 符号長ごとの符号数（1〜16ビット）
+static const uint8_t DC_COUNTS[2][16] = {
+    { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }
+};
+static const uint8_t DC_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t AC_COUNTS[2][16] = {
+    { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D },
+    { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 }
+};
+static const uint8_t AC_VALUES[2][162] = {
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+        0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+        0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+        0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA
+    },
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+        0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+        0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+        0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+        0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+        0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+        0xF9, 0xFA
+    }
+};
+
+// 1次元DCTの係数 C(u)/2 * cos((2x+1)uπ/16)
+static float s_dctTable[8][8];
+static bool s_dctTableReady = false;
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+JpegEncoder::JpegEncoder()
+    : _output(nullptr),
+      _bitBuffer(0),
+      _bitCount(0),
+      _outLength(0),
+      _outputSize(0),
+      _ok(false) {
+}
+
+// ============================================================================
+// 符号化
+// ============================================================================
+
+bool JpegEncoder::encode(const uint8_t* rgb, uint16_t width, uint16_t height, uint8_t quality, JpegOutputCallback output) {
+    if (!rgb || width == 0 || height == 0) return false;
+
+    _output = output;
+    _bitBuffer = 0;
+    _bitCount = 0;
+    _outLength = 0;
+    _outputSize = 0;
+    _ok = true;
+
+    _setupTables(quality);
+    _writeHeaders(width, height);
+
+    float y[64], cb[64], cr[64];
+    int prevDC[3] = { 0, 0, 0 };
+
+    for (uint16_t by = 0; by < height && _ok; by += 8) {
+        for (uint16_t bx = 0; bx < width && _ok; bx += 8) {
+            // 8x8ブロックを取り出してYCbCrへ変換（右端・下端は端の画素を複製）
+            for (uint8_t row = 0; row < 8; row++) {
+                uint16_t sy = min((uint16_t)(by + row), (uint16_t)(height - 1));
+                for (uint8_t col = 0; col < 8; col++) {
+                    uint16_t sx = min((uint16_t)(bx + col), (uint16_t)(width - 1));
+                    const uint8_t* p = rgb + ((size_t)sy * width + sx) * 3;
+                    float r = p[0], g = p[1], b = p[2];
+                    uint8_t i = row * 8 + col;
+                    y[i] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+                    cb[i] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+                    cr[i] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+                }
+            }
+            _encodeBlock(y, 0, prevDC[0]);
+            _encodeBlock(cb, 1, prevDC[1]);
+            _encodeBlock(cr, 1, prevDC[2]);
+        }
+    }
+
+    // 残りビットを1で埋めてEOIを出力
+    _flushBits();
+    _putByte(0xFF);
+    _putByte(0xD9);
+    _flushOutput();
+    return _ok;
+}
+
+// ============================================================================
+// プライベートメソッド - テーブル・ヘッダー
+// ============================================================================
+
+void JpegEncoder::_setupTables(uint8_t quality) {
+    // IJG方式の品質スケーリング
+    quality = constrain(quality, 1, 100);
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (uint8_t t = 0; t < 2; t++) {
+        for (uint8_t i = 0; i < 64; i++) {
+            int q = (STD_QUANT[t][i] * scale + 50) / 100;
+            _quant[t][i] = constrain(q, 1, 255);
+            _divisor[t][i] = 1.0f / _quant[t][i];
+        }
+
+        memset(_acSize[t], 0, sizeof(_acSize[t]));
+        _buildHuffman(DC_COUNTS[t], DC_VALUES, _dcCode[t], _dcSize[t]);
+        _buildHuffman(AC_COUNTS[t], AC_VALUES[t], _acCode[t], _acSize[t]);
+    }
+
+    if (!s_dctTableReady) {
+        for (uint8_t u = 0; u < 8; u++) {
+            float c = (u == 0) ? sqrtf(0.5f) : 1.0f;
+            for (uint8_t x = 0; x < 8; x++) {
+                s_dctTable[u][x] = 0.5f * c * cosf((2 * x + 1) * u * (float)M_PI / 16.0f);
+            }
+        }
+        s_dctTableReady = true;
+    }
+}
+
+void JpegEncoder::_writeHeaders(uint16_t width, uint16_t height) {
+    // SOI
+    _putWord(0xFFD8);
+
+    // APP0（JFIF 1.01、アスペクト比 1:1）
+    static const uint8_t jfif[] = {
+        0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+    };
+    for (uint8_t b : jfif) _putByte(b);
+
+    // DQT（ジグザグ順）
+    _putWord(0xFFDB);
+    _putWord(2 + 2 * 65);
+    for (uint8_t t = 0; t < 2; t++) {
+        _putByte(t);
+        for (uint8_t i = 0; i < 64; i++) {
+            _putByte(_quant[t][ZIGZAG[i]]);
+        }
+    }
+
+    // SOF0（ベースライン、3成分、サンプリング 1x1）
+    _putWord(0xFFC0);
+    _putWord(17);
+    _putByte(8);
+    _putWord(height);
+    _putWord(width);
+    _putByte(3);
+    for (uint8_t c = 0; c < 3; c++) {
+        _putByte(c + 1);
+        _putByte(0x11);
+        _putByte(c == 0 ? 0 : 1);
+    }
+
+    // DHT（DC輝度・AC輝度・DC色差・AC色差）
+    _putWord(0xFFC4);
+    _putWord(2 + 2 * (17 + 12) + 2 * (17 + 162));
+    for (uint8_t t = 0; t < 2; t++) {
+        _putByte(0x00 | t);
+        for (uint8_t i = 0; i < 16; i++) _putByte(DC_COUNTS[t][i]);
+        for (uint8_t i = 0; i < 12; i++) _putByte(DC_VALUES[i]);
+
+        _putByte(0x10 | t);
+        for (uint8_t i = 0; i < 16; i++) _putByte(AC_COUNTS[t][i]);
+        for (uint8_t i = 0; i < 162; i++) _putByte(AC_VALUES[t][i]);
+    }
+
+    // SOS
+    _putWord(0xFFDA);
+    _putWord(12);
+    _putByte(3);
+    for (uint8_t c = 0; c < 3; c++) {
+        _putByte(c + 1);
+        _putByte(c == 0 ? 0x00 : 0x11);
+    }
+    _putByte(0);
+    _putByte(63);
+    _putByte(0);
+}
+
+void JpegEncoder::_buildHuffman(const uint8_t* counts, const uint8_t* values, uint16_t* codes, uint8_t* sizes) {
+    // 符号長の短い順に連番を割り当てる（T.81 Annex C）
+    uint16_t code = 0;
+    uint8_t k = 0;
+    for (uint8_t length = 1; length <= 16; length++) {
+        for (uint8_t i = 0; i < counts[length - 1]; i++) {
+            codes[values[k]] = code++;
+            sizes[values[k]] = length;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+// ============================================================================
+// プライベートメソッド - ブロック符号化
+// ============================================================================
+
+void JpegEncoder::_forwardDCT(float* block) {
+    float tmp[64];
+
+    // 行方向
+    for (uint8_t row = 0; row < 8; row++) {
+        for (uint8_t u = 0; u < 8; u++) {
+            float sum = 0.0f;
+            for (uint8_t x = 0; x < 8; x++) {
+                sum += s_dctTable[u][x] * block[row * 8 + x];
+            }
+            tmp[row * 8 + u] = sum;
+        }
+    }
+
+    // 列方向
+    for (uint8_t col = 0; col < 8; col++) {
+        for (uint8_t v = 0; v < 8; v++) {
+            float sum = 0.0f;
+            for (uint8_t y = 0; y < 8; y++) {
+                sum += s_dctTable[v][y] * tmp[y * 8 + col];
+            }
+            block[v * 8 + col] = sum;
+        }
+    }
+}
+
+void JpegEncoder::_encodeBlock(float* block, uint8_t table, int& prevDC) {
+    _forwardDCT(block);
+
+    // 量子化してジグザグ順に並べ替え
+    int coef[64];
+    for (uint8_t i = 0; i < 64; i++) {
+        uint8_t n = ZIGZAG[i];
+        coef[i] = constrain((int)lroundf(block[n] * _divisor[table][n]), -1023, 1023);
+    }
+
+    // DC成分（前ブロックとの差分）
+    int diff = coef[0] - prevDC;
+    prevDC = coef[0];
+    uint8_t category = 0;
+    for (int v = abs(diff); v; v >>= 1) category++;
+    _putBits(_dcCode[table][category], _dcSize[table][category]);
+    if (category) {
+        _putBits(diff < 0 ? diff + (1 << category) - 1 : diff, category);
+    }
+
+    // AC成分（ゼロランレングス + 値）
+    uint8_t last = 63;
+    while (last > 0 && coef[last] == 0) last--;
+
+    uint8_t run = 0;
+    for (uint8_t i = 1; i <= last; i++) {
+        if (coef[i] == 0) {
+            run++;
+            continue;
+        }
+        while (run >= 16) {
+            _putBits(_acCode[table][0xF0], _acSize[table][0xF0]);  // ZRL
+            run -= 16;
+        }
+        int value = coef[i];
+        uint8_t size = 0;
+        for (int v = abs(value); v; v >>= 1) size++;
+        uint8_t symbol = (run << 4) | size;
+        _putBits(_acCode[table][symbol], _acSize[table][symbol]);
+        _putBits(value < 0 ? value + (1 << size) - 1 : value, size);
+        run = 0;
+    }
+    if (last < 63) {
+        _putBits(_acCode[table][0x00], _acSize[table][0x00]);  // EOB
+    }
+}
+
+// ============================================================================
+// プライベートメソッド - 出力
+// ============================================================================
+
+void JpegEncoder::_putBits(uint32_t value, uint8_t bits) {
+    // エントロピー符号はMSBから詰める
+    _bitBuffer = (_bitBuffer << bits) | (value & ((1u << bits) - 1));
+    _bitCount += bits;
+    while (_bitCount >= 8) {
+        _putMarkerByte((_bitBuffer >> (_bitCount - 8)) & 0xFF);
+        _bitCount -= 8;
+    }
+}
+
+void JpegEncoder::_putMarkerByte(uint8_t value) {
+    // エントロピー符号中の0xFFには0x00を挿入（バイトスタッフィング）
+    _putByte(value);
+    if (value == 0xFF) {
+        _putByte(0x00);
+    }
+}
+
+void JpegEncoder::_flushBits() {
+    if (_bitCount > 0) {
+        _putBits(0x7F, 8 - _bitCount);
+    }
+    _bitBuffer = 0;
+    _bitCount = 0;
+}
+
+void JpegEncoder::_putWord(uint16_t value) {
+    _putByte(value >> 8);
+    _putByte(value & 0xFF);
+}
+
+void JpegEncoder::_putByte(uint8_t value) {
+    _outBuffer[_outLength++] = value;
+    if (_outLength == sizeof(_outBuffer)) {
+        _flushOutput();
+    }
+}
+
+void JpegEncoder::_flushOutput() {
+    if (_outLength > 0 && _ok) {
+        _ok = _output(_outBuffer, _outLength);
+        _outputSize += _outLength;
+    }
+    _outLength = 0;
+}
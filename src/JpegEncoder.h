@@ -0,0 +1,68 @@
+#ifndef JPEG_ENCODER_H
+#define JPEG_ENCODER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "Config.h"
+
+// ============================================================================
+// 出力コールバック（falseを返すと符号化を中断）
+// ============================================================================
+typedef std::function<bool(const uint8_t* data, size_t length)> JpegOutputCallback;
+
+/**
+ * @brief サムネイル用の小型ベースラインJPEGエンコーダ
+ *
+ * RGB888画像を YCbCr 4:4:4、標準ハフマン表（ITU-T T.81 Annex K）で
+ * ベースラインJPEGに符号化します。サムネイル程度の画像を想定しており、
+ * 作業メモリは固定（約2KB）で画像サイズに依存しません。
+ */
+class JpegEncoder {
+public:
+    JpegEncoder();
+
+    /**
+     * @brief RGB888画像をJPEGに符号化
+     * @param rgb 画素データ（行優先、1画素3バイト）
+     * @param width 幅
+     * @param height 高さ
+     * @param quality 品質（1〜100）
+     * @param output 出力コールバック
+     * @return 出力成功時true
+     */
+    bool encode(const uint8_t* rgb, uint16_t width, uint16_t height, uint8_t quality, JpegOutputCallback output);
+
+    /**
+     * @brief 出力バイト数を取得
+     */
+    uint32_t getOutputSize() const { return _outputSize; }
+
+private:
+    JpegOutputCallback _output;
+    uint8_t _quant[2][64];       // 量子化表（自然順）
+    float _divisor[2][64];       // 1 / (量子化値)（自然順）
+    uint16_t _dcCode[2][12];
+    uint8_t _dcSize[2][12];
+    uint16_t _acCode[2][256];
+    uint8_t _acSize[2][256];
+    uint32_t _bitBuffer;
+    uint8_t _bitCount;
+    uint8_t _outBuffer[256];
+    size_t _outLength;
+    uint32_t _outputSize;
+    bool _ok;
+
+    void _setupTables(uint8_t quality);
+    void _writeHeaders(uint16_t width, uint16_t height);
+    void _encodeBlock(float* block, uint8_t table, int& prevDC);
+    void _putBits(uint32_t value, uint8_t bits);
+    void _putMarkerByte(uint8_t value);
+    void _putByte(uint8_t value);
+    void _putWord(uint16_t value);
+    void _flushBits();
+    void _flushOutput();
+    static void _buildHuffman(const uint8_t* counts, const uint8_t* values, uint16_t* codes, uint8_t* sizes);
+    static void _forwardDCT(float* block);
+};
+
+#endif // JPEG_ENCODER_H
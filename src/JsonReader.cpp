@@ -0,0 +1,369 @@
+#include "JsonReader.h"
+
+// ============================================================================
+// エスケープの解釈
+// ============================================================================
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static uint32_t readHex4(const char* p) {
+    uint32_t code = 0;
+    for (int i = 0; i < 4; i++) {
+        code = (code << 4) | (uint32_t)hexValue(p[i]);
+    }
+    return code;
+}
+
+// p から1文字分を解釈して out に書き込み（最大4バイト）、書き込んだバイト数を返す
+// （構文は JsonReader::_string() で検証済み）
+static size_t decodeChar(const char*& p, const char* end, char* out) {
+    if (*p != '\\') {
+        out[0] = *p++;
+        return 1;
+    }
+    char c = p[1];
+    p += 2;
+    switch (c) {
+        case 'b': out[0] = '\b'; return 1;
+        case 'f': out[0] = '\f'; return 1;
+        case 'n': out[0] = '\n'; return 1;
+        case 'r': out[0] = '\r'; return 1;
+        case 't': out[0] = '\t'; return 1;
+        case 'u': break;
+        default: out[0] = c; return 1;   // " \ /
+    }
+
+    uint32_t code = readHex4(p);
+    p += 4;
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        // サロゲートペア（対になっていなければ U+FFFD にする）
+        if (end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+            uint32_t low = readHex4(p + 2);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                p += 6;
+            } else {
+                code = 0xFFFD;
+            }
+        } else {
+            code = 0xFFFD;
+        }
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+        code = 0xFFFD;
+    }
+
+    // UTF-8 に変換
+    if (code < 0x80) {
+        out[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = (char)(0xC0 | (code >> 6));
+        out[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = (char)(0xE0 | (code >> 12));
+        out[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (code >> 18));
+    out[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+// ============================================================================
+// JsonSpan
+// ============================================================================
+
+bool JsonSpan::equals(const char* text) const {
+    if (!escaped) {
+        return strlen(text) == length && memcmp(data, text, length) == 0;
+    }
+
+    const char* p = data;
+    const char* end = data + length;
+    char decoded[4];
+    while (p < end) {
+        size_t n = decodeChar(p, end, decoded);
+        for (size_t i = 0; i < n; i++) {
+            // \u0000 を含む場合に text の終端を越えて比較しない
+            if (*text == '\0' || *text++ != decoded[i]) return false;
+        }
+    }
+    return *text == '\0';
+}
+
+bool JsonSpan::copyTo(char* out, size_t size) const {
+    if (size == 0) return false;
+
+    if (!escaped) {
+        if (length >= size) {
+            out[0] = '\0';
+            return false;
+        }
+        memcpy(out, data, length);
+        out[length] = '\0';
+        return true;
+    }
+
+    const char* p = data;
+    const char* end = data + length;
+    size_t used = 0;
+    char decoded[4];
+    while (p < end) {
+        size_t n = decodeChar(p, end, decoded);
+        if (used + n >= size) {
+            out[0] = '\0';
+            return false;
+        }
+        memcpy(out + used, decoded, n);
+        used += n;
+    }
+    out[used] = '\0';
+    return true;
+}
+
+bool JsonSpan::toUInt32(uint32_t& value) const {
+    if (length == 0) return false;
+
+    uint64_t result = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (c < '0' || c > '9') return false;
+        result = result * 10 + (c - '0');
+        if (result > 0xFFFFFFFFULL) return false;
+    }
+    value = (uint32_t)result;
+    return true;
+}
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+JsonReader::JsonReader(const char* data, size_t length)
+    : _data(data),
+      _length(data ? length : 0),
+      _pos(0),
+      _span{nullptr, 0, false},
+      _inObject(0),
+      _depth(0),
+      _state(STATE_VALUE) {
+}
+
+// ============================================================================
+// 読み出し
+// ============================================================================
+
+JsonToken JsonReader::next() {
+    _skipWhitespace();
+
+    switch (_state) {
+        case STATE_SEPARATOR: {
+            if (_depth == 0) {
+                // 最上位の値の後ろは空白以外を許さない
+                if (_pos < _length) return _fail();
+                _state = STATE_DONE;
+                return JSON_TOKEN_END;
+            }
+            if (_pos >= _length) return _fail();
+            bool inObject = (_inObject >> (_depth - 1)) & 1;
+            char c = _data[_pos];
+            if (c == (inObject ? '}' : ']')) return _pop();
+            if (c != ',') return _fail();
+            _pos++;
+            _skipWhitespace();
+            if (!inObject) return _value();
+            // オブジェクト内なら次はキー
+        }
+            // fall through
+        case STATE_KEY:
+        case STATE_KEY_OR_END: {
+            if (_pos >= _length) return _fail();
+            if (_state == STATE_KEY_OR_END && _data[_pos] == '}') return _pop();
+            if (_data[_pos] != '"' || !_string()) return _fail();
+            _skipWhitespace();
+            if (_pos >= _length || _data[_pos] != ':') return _fail();
+            _pos++;
+            _state = STATE_VALUE;
+            return JSON_TOKEN_KEY;
+        }
+
+        case STATE_VALUE_OR_END:
+            if (_pos < _length && _data[_pos] == ']') return _pop();
+            return _value();
+
+        case STATE_VALUE:
+            return _value();
+
+        case STATE_DONE:
+            return JSON_TOKEN_END;
+
+        default:
+            return JSON_TOKEN_ERROR;
+    }
+}
+
+bool JsonReader::skip() {
+    JsonToken token = next();
+    if (token == JSON_TOKEN_BEGIN_OBJECT || token == JSON_TOKEN_BEGIN_ARRAY) {
+        return skipContainer();
+    }
+    return token != JSON_TOKEN_ERROR && token != JSON_TOKEN_END &&
+           token != JSON_TOKEN_END_OBJECT && token != JSON_TOKEN_END_ARRAY;
+}
+
+bool JsonReader::skipContainer() {
+    if (_depth == 0) return !hasError();
+    uint8_t target = _depth - 1;
+    while (_depth > target) {
+        JsonToken token = next();
+        if (token == JSON_TOKEN_ERROR || token == JSON_TOKEN_END) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+JsonToken JsonReader::_value() {
+    if (_pos >= _length) return _fail();
+
+    char c = _data[_pos];
+    if (c == '{') return _push(true);
+    if (c == '[') return _push(false);
+
+    JsonToken token;
+    if (c == '"') {
+        if (!_string()) return _fail();
+        token = JSON_TOKEN_STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        if (!_number()) return _fail();
+        token = JSON_TOKEN_NUMBER;
+    } else if (c == 't') {
+        if (!_literal("true", 4)) return _fail();
+        token = JSON_TOKEN_TRUE;
+    } else if (c == 'f') {
+        if (!_literal("false", 5)) return _fail();
+        token = JSON_TOKEN_FALSE;
+    } else if (c == 'n') {
+        if (!_literal("null", 4)) return _fail();
+        token = JSON_TOKEN_NULL;
+    } else {
+        return _fail();
+    }
+    _state = STATE_SEPARATOR;
+    return token;
+}
+
+JsonToken JsonReader::_push(bool object) {
+    if (_depth >= 32) return _fail();
+    if (object) {
+        _inObject |= (1UL << _depth);
+    } else {
+        _inObject &= ~(1UL << _depth);
+    }
+    _depth++;
+    _pos++;
+    _state = object ? STATE_KEY_OR_END : STATE_VALUE_OR_END;
+    return object ? JSON_TOKEN_BEGIN_OBJECT : JSON_TOKEN_BEGIN_ARRAY;
+}
+
+JsonToken JsonReader::_pop() {
+    _depth--;
+    bool object = (_inObject >> _depth) & 1;
+    _pos++;
+    _state = STATE_SEPARATOR;
+    return object ? JSON_TOKEN_END_OBJECT : JSON_TOKEN_END_ARRAY;
+}
+
+JsonToken JsonReader::_fail() {
+    _state = STATE_ERROR;
+    return JSON_TOKEN_ERROR;
+}
+
+bool JsonReader::_string() {
+    // _data[_pos] は開き引用符
+    size_t start = ++_pos;
+    bool escaped = false;
+    while (_pos < _length) {
+        unsigned char c = (unsigned char)_data[_pos];
+        if (c == '"') {
+            _span = {_data + start, _pos - start, escaped};
+            _pos++;
+            return true;
+        }
+        if (c < 0x20) return false;
+        if (c == '\\') {
+            escaped = true;
+            if (_pos + 1 >= _length) return false;
+            char e = _data[_pos + 1];
+            if (e == 'u') {
+                if (_pos + 6 > _length) return false;
+                for (int i = 2; i < 6; i++) {
+                    if (hexValue(_data[_pos + i]) < 0) return false;
+                }
+                _pos += 6;
+                continue;
+            }
+            if (e == '\0' || !strchr("\"\\/bfnrt", e)) return false;
+            _pos += 2;
+            continue;
+        }
+        _pos++;
+    }
+    return false;
+}
+
+bool JsonReader::_number() {
+    size_t start = _pos;
+    if (_data[_pos] == '-') _pos++;
+
+    // 整数部（先頭の0の後ろに数字は続かない）
+    if (_pos >= _length || !isdigit((unsigned char)_data[_pos])) return false;
+    if (_data[_pos] == '0') {
+        _pos++;
+    } else {
+        while (_pos < _length && isdigit((unsigned char)_data[_pos])) _pos++;
+    }
+
+    if (_pos < _length && _data[_pos] == '.') {
+        _pos++;
+        if (_pos >= _length || !isdigit((unsigned char)_data[_pos])) return false;
+        while (_pos < _length && isdigit((unsigned char)_data[_pos])) _pos++;
+    }
+
+    if (_pos < _length && (_data[_pos] == 'e' || _data[_pos] == 'E')) {
+        _pos++;
+        if (_pos < _length && (_data[_pos] == '+' || _data[_pos] == '-')) _pos++;
+        if (_pos >= _length || !isdigit((unsigned char)_data[_pos])) return false;
+        while (_pos < _length && isdigit((unsigned char)_data[_pos])) _pos++;
+    }
+
+    _span = {_data + start, _pos - start, false};
+    return true;
+}
+
+bool JsonReader::_literal(const char* word, size_t length) {
+    if (_length - _pos < length || memcmp(_data + _pos, word, length) != 0) return false;
+    _pos += length;
+    return true;
+}
+
+void JsonReader::_skipWhitespace() {
+    while (_pos < _length) {
+        char c = _data[_pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+        _pos++;
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <Arduino.h>
+
+// JsonReader::next() が返すトークンの種類
+enum JsonToken : uint8_t {
+    JSON_TOKEN_BEGIN_OBJECT,
+    JSON_TOKEN_END_OBJECT,
+    JSON_TOKEN_BEGIN_ARRAY,
+    JSON_TOKEN_END_ARRAY,
+    JSON_TOKEN_KEY,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_TRUE,
+    JSON_TOKEN_FALSE,
+    JSON_TOKEN_NULL,
+    JSON_TOKEN_END,     // 入力の終わり（最上位の値を読み終えた）
+    JSON_TOKEN_ERROR    // 構文エラー（以降も ERROR を返す）
+};
+
+/**
+ * @brief 入力バッファ内の文字列・数値の範囲
+ *
+ * 引用符を除いた生の範囲を指し、エスケープはコピー・比較するときにだけ解釈します。
+ * 入力バッファより長く保持しないでください。
+ */
+struct JsonSpan {
+    const char* data;
+    size_t length;
+    bool escaped;       // バックスラッシュを含む（data をそのまま文字列として使えない）
+
+    /**
+     * @brief エスケープを解釈した値が text と一致するか
+     */
+    bool equals(const char* text) const;
+
+    /**
+     * @brief エスケープを解釈して out にコピー（NUL終端）
+     * @return 収まった場合true（収まらない場合は途中で切らずに空文字列にする）
+     */
+    bool copyTo(char* out, size_t size) const;
+
+    /**
+     * @brief 0以上の整数として取得（小数・指数・範囲外はfalse）
+     */
+    bool toUInt32(uint32_t& value) const;
+};
+
+/**
+ * @brief リクエストボディをその場で読むJSONプルパーサー
+ *
+ * 呼び出し側のバッファを先頭から1トークンずつ読み、文字列・数値は JsonSpan として返します。
+ * ヒープを使わず、読み出しのための一時オブジェクトも作りません。
+ * 構文（カンマ・コロン・括弧の対応、入れ子は最大32段）は読みながら検証します。
+ *
+ * 例:
+ * @code
+ * JsonReader reader(body.c_str(), body.length());
+ * char filename[JSON_REQUEST_MAX_STRING];
+ * if (reader.next() != JSON_TOKEN_BEGIN_OBJECT) return false;
+ * while (reader.next() == JSON_TOKEN_KEY) {
+ *     if (reader.span().equals("filename") && reader.next() == JSON_TOKEN_STRING) {
+ *         reader.span().copyTo(filename, sizeof(filename));
+ *     } else {
+ *         reader.skip();
+ *     }
+ * }
+ * @endcode
+ */
+class JsonReader {
+public:
+    JsonReader(const char* data, size_t length);
+
+    /**
+     * @brief 次のトークンを読む
+     */
+    JsonToken next();
+
+    /**
+     * @brief 直前に読んだキー・文字列・数値の範囲
+     */
+    const JsonSpan& span() const { return _span; }
+
+    /**
+     * @brief 次の値を入れ子ごと読み飛ばす（キーの直後・配列の要素の前で使う）
+     * @return 構文エラーがなければtrue
+     */
+    bool skip();
+
+    /**
+     * @brief 直前の next() で開いたオブジェクト・配列の終わりまで読み飛ばす
+     * @return 構文エラーがなければtrue
+     */
+    bool skipContainer();
+
+    /**
+     * @brief 現在の入れ子の深さ（最上位が0）
+     */
+    uint8_t getDepth() const { return _depth; }
+
+    /**
+     * @brief 構文エラーがあったか
+     */
+    bool hasError() const { return _state == STATE_ERROR; }
+
+    /**
+     * @brief 構文エラーの位置（入力の先頭からのバイト数）
+     */
+    size_t getErrorOffset() const { return _pos; }
+
+private:
+    enum State : uint8_t {
+        STATE_VALUE,            // 値を待つ
+        STATE_VALUE_OR_END,     // '[' の直後
+        STATE_KEY,              // オブジェクト内の ',' の直後
+        STATE_KEY_OR_END,       // '{' の直後
+        STATE_SEPARATOR,        // 値の直後（',' か閉じ括弧）
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    const char* _data;
+    size_t _length;
+    size_t _pos;
+    JsonSpan _span;
+    uint32_t _inObject;       // 深さごとに「オブジェクトの中」であることを示すビット
+    uint8_t _depth;
+    State _state;
+
+    JsonToken _value();
+    JsonToken _push(bool object);
+    JsonToken _pop();
+    JsonToken _fail();
+    bool _string();
+    bool _number();
+    bool _literal(const char* word, size_t length);
+    void _skipWhitespace();
+};
+
+#endif // JSON_READER_H
@@ -0,0 +1,178 @@
+#include "JsonWriter.h"
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+JsonWriter::JsonWriter(char* buffer, size_t size, JsonOutputCallback output)
+    : _buffer(buffer),
+      _size(size),
+      _used(0),
+      _output(output),
+      _bytesWritten(0),
+      _hasItems(0),
+      _depth(0),
+      _afterKey(false),
+      _error(false) {
+}
+
+// ============================================================================
+// 構造
+// ============================================================================
+
+void JsonWriter::beginObject() {
+    _push('{');
+}
+
+void JsonWriter::endObject() {
+    _pop('}');
+}
+
+void JsonWriter::beginArray() {
+    _push('[');
+}
+
+void JsonWriter::endArray() {
+    _pop(']');
+}
+
+void JsonWriter::key(const char* name) {
+    _string(name, strlen(name));
+    _put(':');
+    _afterKey = true;
+}
+
+// ============================================================================
+// 値
+// ============================================================================
+
+void JsonWriter::value(const char* text) {
+    if (!text) {
+        valueNull();
+        return;
+    }
+    _string(text, strlen(text));
+}
+
+void JsonWriter::value(bool b) {
+    _separator();
+    if (b) {
+        _write("true", 4);
+    } else {
+        _write("false", 5);
+    }
+}
+
+void JsonWriter::valueNull() {
+    _separator();
+    _write("null", 4);
+}
+
+bool JsonWriter::flush() {
+    if (_used > 0) {
+        if (!_output || !_output(_buffer, _used)) {
+            _error = true;
+        }
+        _used = 0;
+    }
+    return !_error;
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+void JsonWriter::_separator() {
+    // キーの直後はカンマ不要、それ以外は同じ階層の2つ目以降の要素の前にカンマを入れる
+    if (_afterKey) {
+        _afterKey = false;
+        return;
+    }
+    uint32_t bit = 1UL << (_depth & 31);
+    if (_hasItems & bit) {
+        _put(',');
+    }
+    _hasItems |= bit;
+}
+
+void JsonWriter::_push(char open) {
+    _separator();
+    _put(open);
+    _depth++;
+    _hasItems &= ~(1UL << (_depth & 31));
+}
+
+void JsonWriter::_pop(char close) {
+    _put(close);
+    if (_depth > 0) _depth--;
+}
+
+void JsonWriter::_string(const char* text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    _separator();
+    _put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = (uint8_t)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        // エスケープ不要な部分はまとめてコピー
+        _write(text + start, i - start);
+        start = i + 1;
+        _put('\\');
+        switch (c) {
+            case '"':  _put('"'); break;
+            case '\\': _put('\\'); break;
+            case '\n': _put('n'); break;
+            case '\r': _put('r'); break;
+            case '\t': _put('t'); break;
+            case '\b': _put('b'); break;
+            case '\f': _put('f'); break;
+            default:
+                _write("u00", 3);
+                _put(hex[c >> 4]);
+                _put(hex[c & 0x0F]);
+                break;
+        }
+    }
+    _write(text + start, length - start);
+    _put('"');
+}
+
+void JsonWriter::_signed(long long number) {
+    _separator();
+    if (number < 0) {
+        _put('-');
+        _digits(0ULL - (unsigned long long)number);
+    } else {
+        _digits((unsigned long long)number);
+    }
+}
+
+void JsonWriter::_unsigned(unsigned long long number) {
+    _separator();
+    _digits(number);
+}
+
+void JsonWriter::_digits(unsigned long long number) {
+    char digits[20];
+    size_t pos = sizeof(digits);
+    do {
+        digits[--pos] = '0' + (number % 10);
+        number /= 10;
+    } while (number > 0);
+    _write(digits + pos, sizeof(digits) - pos);
+}
+
+void JsonWriter::_write(const char* data, size_t length) {
+    while (length > 0) {
+        if (_used == _size) flush();
+        size_t n = min(length, _size - _used);
+        memcpy(_buffer + _used, data, n);
+        _used += n;
+        _bytesWritten += n;
+        data += n;
+        length -= n;
+    }
+}
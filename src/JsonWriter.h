@@ -0,0 +1,102 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// JSON出力先コールバック（バッファが一杯になったとき・flush() 時に呼ばれる）
+typedef std::function<bool(const char* data, size_t length)> JsonOutputCallback;
+
+/**
+ * @brief 呼び出し側が用意した固定長バッファに書き込むJSONライター
+ *
+ * String を使わずに直接バッファへ書き込み、一杯になるたびにコールバックへ渡します。
+ * 文字列は JSON の規則どおりにエスケープし、数値は一時オブジェクトなしで整形します。
+ * カンマ・コロンは入れ子の深さ（最大32段）ごとに自動で挿入します。
+ *
+ * 例:
+ * @code
+ * char buffer[512];
+ * JsonWriter json(buffer, sizeof(buffer), callback);
+ * json.beginObject();
+ * json.field("name", "a\"b.txt");
+ * json.field("size", 1024u);
+ * json.endObject();
+ * json.flush();
+ * @endcode
+ */
+class JsonWriter {
+public:
+    JsonWriter(char* buffer, size_t size, JsonOutputCallback output);
+
+    // 構造
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const char* name);
+
+    // 値
+    void value(const char* text);
+    void value(const String& text) { _string(text.c_str(), text.length()); }
+    void value(bool b);
+    void value(int number) { _signed(number); }
+    void value(long number) { _signed(number); }
+    void value(long long number) { _signed(number); }
+    void value(unsigned int number) { _unsigned(number); }
+    void value(unsigned long number) { _unsigned(number); }
+    void value(unsigned long long number) { _unsigned(number); }
+    void valueNull();
+
+    /**
+     * @brief キーと値を書き込む
+     */
+    template <typename T>
+    void field(const char* name, T v) {
+        key(name);
+        value(v);
+    }
+
+    /**
+     * @brief バッファに残っている内容を出力
+     * @return 出力コールバックがすべて成功した場合true
+     */
+    bool flush();
+
+    /**
+     * @brief これまでに書き込んだバイト数を取得
+     */
+    uint32_t getBytesWritten() const { return _bytesWritten; }
+
+    /**
+     * @brief 出力コールバックが失敗したか
+     */
+    bool hasError() const { return _error; }
+
+private:
+    char* _buffer;
+    size_t _size;
+    size_t _used;
+    JsonOutputCallback _output;
+    uint32_t _bytesWritten;
+    uint32_t _hasItems;       // 深さごとに「既に要素がある」ことを示すビット
+    uint8_t _depth;
+    bool _afterKey;
+    bool _error;
+
+    void _separator();
+    void _push(char open);
+    void _pop(char close);
+    void _string(const char* text, size_t length);
+    void _signed(long long number);
+    void _unsigned(unsigned long long number);
+    void _digits(unsigned long long number);
+    void _write(const char* data, size_t length);
+    void _put(char c) {
+        if (_used == _size) flush();
+        _buffer[_used++] = c;
+        _bytesWritten++;
+    }
+};
+
+#endif // JSON_WRITER_H
@@ -1,6 +1,9 @@
 #include "M5StackWiFiUploader.h"
 #include <WiFi.h>
 #include <cstdarg>
+#include <time.h>
+#include <esp_rom_crc.h>
+#include <set>
 
 // ============================================================================
 // コンストラクタ・デストラクタ
@@ -20,12 +23,36 @@ M5StackWiFiUploader::M5StackWiFiUploader(uint16_t port)
       _webSocketEnabled(false),
 #endif
       _overwriteProtection(false),
+      _keepAliveEnabled(true),
+      _keepAliveMaxRequests(DEFAULT_KEEP_ALIVE_MAX_REQUESTS),
+      _keepAliveTimeout(DEFAULT_KEEP_ALIVE_TIMEOUT),
       _totalUploaded(0),
+      _dirGeneration(0),
+      _bootId(0),
+#if ENABLE_DOWNLOAD_ENGINE
+      _downloadEngineEnabled(true),
+#endif
+#if ENABLE_ADVANCED_ENDPOINTS
+      _gzipOnTheFly(false),
+      _gzipMinSize(DEFAULT_GZIP_MIN_SIZE),
+#endif
+#if ENABLE_FILE_CACHE
+      _fileCacheConfigured(false),
+#endif
+#if ENABLE_DIRECTORY_INDEX
+      _directoryIndexConfigured(false),
+#endif
       _nextSessionId(0),
       _onUploadStart(nullptr),
       _onUploadProgress(nullptr),
       _onUploadComplete(nullptr),
       _onUploadError(nullptr) {
+#if ENABLE_ADVANCED_ENDPOINTS
+    _lastDownloadStats = DownloadStats();
+#endif
+#if ENABLE_DIRECTORY_INDEX && ENABLE_SHARDED_STORAGE
+    _directoryIndex.setLayout(&_storageLayout);
+#endif
     // デフォルト許可拡張子を設定
     _allowedExtensions = {
         "jpg", "jpeg", "png", "gif", "bmp",
@@ -46,25 +73,47 @@ bool M5StackWiFiUploader::begin(uint16_t port, const char* uploadPath) {
 #if ENABLE_WEBSOCKET
     if (_webSocketEnabled) {
         _wsHandler = new WebSocketHandler(DEFAULT_WS_PORT);
+        _wsHandler->setDebugLevel(_debugLevel);
         _wsHandler->begin();
-        _wsHandler->onData([this](uint8_t clientId, const uint8_t* data, size_t length) {
-            // WebSocketデータ受信処理
+        _wsHandler->onFileInfo([this](uint8_t clientId, const WSFileInfo& info) {
+            _handleWebSocketFileInfo(clientId, info);
+        });
+        _wsHandler->onData([this](uint8_t clientId, uint8_t channel, uint16_t sequence, const uint8_t* data,
+                                  size_t length) {
+            _handleWebSocketData(clientId, channel, sequence, data, length);
+        });
+        _wsHandler->onCancel([this](uint8_t clientId, int16_t channel) {
+            _abortWebSocketUpload(clientId, channel, ERR_CANCELLED, "Upload cancelled");
+        });
+        _wsHandler->onDisconnect([this](uint8_t clientId) {
+            _abortWebSocketUpload(clientId, -1, ERR_CONNECTION_LOST, nullptr);
         });
     }
 #endif
     _port = port;
     _uploadPath = uploadPath;
+    _bootId = esp_random();
+#if ENABLE_CHANGE_FEED
+    _changeFeed.setFeedId(_bootId);
+#endif
+#if ENABLE_FILE_CACHE
+    if (!_fileCacheConfigured) {
+        _fileCache.configure(psramFound() ? DEFAULT_FILE_CACHE_SIZE_PSRAM : DEFAULT_FILE_CACHE_SIZE,
+                             DEFAULT_FILE_CACHE_MAX_ENTRY_SIZE);
+    }
+#endif
 
     // WebServerインスタンスを作成
     if (_webServer != nullptr) {
         delete _webServer;
     }
-    _webServer = new WebServer(_port);
+    _webServer = new UploaderWebServer(_port);
 
     if (_webServer == nullptr) {
         _log(1, "Failed to create WebServer instance");
         return false;
     }
+    _webServer->setKeepAlive(_keepAliveEnabled, _keepAliveMaxRequests, _keepAliveTimeout);
 
     // ルートハンドラーを登録
     _webServer->on("/", HTTP_GET, [this]() { _handleRoot(); });
@@ -75,21 +124,61 @@ bool M5StackWiFiUploader::begin(uint16_t port, const char* uploadPath) {
     _webServer->on("/api/files", HTTP_GET, [this]() { _handleListFiles(); });
 #if ENABLE_ADVANCED_ENDPOINTS
     _webServer->on("/api/files/list", HTTP_GET, [this]() { _handleFileListDetailed(); });
+    _webServer->on("/api/search", HTTP_GET, [this]() { _handleSearch(); });
     _webServer->on("/api/download", HTTP_GET, [this]() { _handleFileDownload(); });
+    _webServer->on("/api/download/archive", HTTP_GET, [this]() { _handleArchiveDownload(); });
+    _webServer->on("/api/download/archive", HTTP_POST, [this]() { _handleArchiveDownload(); });
+#endif
+#if ENABLE_THUMBNAILS
+    _webServer->on("/api/thumb", HTTP_GET, [this]() { _handleThumbnail(); });
+#endif
+#if ENABLE_TAIL
+    _webServer->on("/api/tail", HTTP_GET, [this]() { _handleTail(); });
+#endif
+#if ENABLE_CHANGE_FEED
+    _webServer->on("/api/changes", HTTP_GET, [this]() { _handleChanges(); });
+#endif
+#if ENABLE_DIRECTORY_STATS
+    _webServer->on("/api/stats/reconcile", HTTP_POST, [this]() { _handleStatsReconcile(); });
 #endif
     _webServer->on("/api/delete", HTTP_DELETE, [this]() { _handleDeleteFile(); });
     _webServer->on("/api/delete", HTTP_POST, [this]() { _handleDeleteFile(); });
+#if ENABLE_ADVANCED_ENDPOINTS
+    _webServer->on("/api/batch", HTTP_POST, [this]() { _handleBatch(); });
+#endif
     _webServer->on("/api/status", HTTP_GET, [this]() { _handleStatus(); });
 #if ENABLE_ADVANCED_ENDPOINTS
     _webServer->on("/api/debug", HTTP_POST, [this]() { _handleDebugLog(); });
 #endif
 
+    // 条件付きGET・圧縮ネゴシエーションで参照するリクエストヘッダーを収集
+    static const char* headerKeys[] = { "If-None-Match", "If-Modified-Since", "Accept-Encoding" };
+    _webServer->collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
+
     // アップロードディレクトリを確認・作成
     if (!_ensureUploadDirectory()) {
         _log(1, "Failed to create upload directory: %s", _uploadPath.c_str());
         return false;
     }
 
+#if ENABLE_SHARDED_STORAGE
+    // 直下に置かれたファイルや、前回と異なるバケット数で保存されたファイルを現在の配置へ移す
+    if (_storageLayout.isSharded() || SD.exists((_uploadPath + "/" SHARD_DIR).c_str())) {
+        migrateStorage();
+    }
+#endif
+
+#if ENABLE_DIRECTORY_INDEX
+    // 以降の一覧・存在確認はこのインデックスで処理し、SDカードの走査は起動時の一度だけにする
+    // （前回保存したインデックスがあれば走査せずに読み込む）
+    if (!_directoryIndexConfigured) {
+        _directoryIndex.configure(psramFound() ? DEFAULT_DIRECTORY_INDEX_MAX_ENTRIES_PSRAM
+                                               : DEFAULT_DIRECTORY_INDEX_MAX_ENTRIES,
+                                  DEFAULT_DIRECTORY_INDEX_VERIFY_INTERVAL);
+    }
+    _rebuildDirectoryIndex();
+#endif
+
     // サーバーを開始
     _webServer->begin();
     _isRunning = true;
@@ -104,14 +193,51 @@ bool M5StackWiFiUploader::begin(uint16_t port, const char* uploadPath) {
 void M5StackWiFiUploader::handleClient() {
     if (!_isRunning) return;
     if (_webServer) _webServer->handleClient();
+#if ENABLE_TAIL
+    _tailManager.loop();
+#endif
+#if ENABLE_CHANGE_FEED
+    _changeFeed.loop();
+#endif
+#if ENABLE_DIRECTORY_INDEX
+    // 受信中のファイルはSD上のサイズ（flushごとに増える）がインデックスのサイズ0と食い違い、
+    // 外部からの変更と誤検出するので、全ての受信が終わるまで検証を進めない
+    bool uploading = !_activeSessions.empty() || _uploadFile;
+    if (!uploading && _directoryIndex.verifyStep()) {
+        // ライブラリ外での変更を検出したので、一覧のETagとキャッシュ済みの内容も古いものとして扱う
+        _markDirectoryChanged();
+        _seedDirectoryStats();
+#if ENABLE_FILE_CACHE
+        _fileCache.clear();
+#endif
+#if ENABLE_CHANGE_FEED
+        // 個々の変更は分からないので、待機中・以降のクライアントには一覧の取り直しを求める
+        _changeFeed.reset();
+#endif
+        _log(3, "Directory index rebuilt after external change (%u entries)",
+             (unsigned int)_directoryIndex.getEntryCount());
+    }
+#endif
 #if ENABLE_WEBSOCKET
-    if (_wsHandler) _wsHandler->handleClient();
+    if (_wsHandler) {
+        _wsHandler->handleClient();
+        _checkWebSocketTimeouts();
+    }
 #endif
 }
 
 void M5StackWiFiUploader::end() {
 #if ENABLE_WEBSOCKET
     if (_wsHandler) {
+        // 受信途中のファイルは完全なものとして残さない
+        while (!_activeSessions.empty()) {
+            UploadSession& session = _activeSessions.begin()->second;
+            if (session.isActive) {
+                _abortWebSocketUpload(session.clientId, session.channel, ERR_CANCELLED, "Server stopped");
+            } else {
+                _closeSession(session.sessionId);
+            }
+        }
         _wsHandler->end();
         delete _wsHandler;
         _wsHandler = nullptr;
@@ -119,6 +245,12 @@ void M5StackWiFiUploader::end() {
 #endif
     if (_webServer != nullptr) {
         _closeAllSessions();
+#if ENABLE_TAIL
+        _tailManager.closeAll();
+#endif
+#if ENABLE_CHANGE_FEED
+        _changeFeed.closeAll();
+#endif
         _webServer->stop();
         delete _webServer;
         _webServer = nullptr;
@@ -147,6 +279,28 @@ void M5StackWiFiUploader::setAllowedExtensions(const char** extensions, uint8_t
 void M5StackWiFiUploader::setUploadPath(const char* path) {
     _uploadPath = path;
     _ensureUploadDirectory();
+    _markDirectoryChanged();
+#if ENABLE_FILE_CACHE
+    _fileCache.clear();
+#endif
+#if ENABLE_CHANGE_FEED
+    _changeFeed.reset();
+#endif
+#if ENABLE_DIRECTORY_STATS
+    // 新しいディレクトリの内容は数え直すまで分からない（インデックスがあれば読み込んだエントリから数える）
+    _directoryStats.clear();
+    _directoryStats.invalidate();
+#endif
+#if ENABLE_SHARDED_STORAGE
+    if (_isRunning && (_storageLayout.isSharded() || SD.exists((_uploadPath + "/" SHARD_DIR).c_str()))) {
+        migrateStorage();
+    }
+#endif
+#if ENABLE_DIRECTORY_INDEX
+    if (_isRunning) {
+        _rebuildDirectoryIndex();
+    }
+#endif
     _log(3, "Upload path set to: %s", path);
 }
 
@@ -168,6 +322,132 @@ void M5StackWiFiUploader::setOverwriteProtection(bool enable) {
     _log(3, "Overwrite protection %s", enable ? "enabled" : "disabled");
 }
 
+void M5StackWiFiUploader::setKeepAlive(bool enable, uint16_t maxRequests, uint32_t idleTimeoutMs) {
+    _keepAliveEnabled = enable;
+    _keepAliveMaxRequests = maxRequests;
+    _keepAliveTimeout = idleTimeoutMs;
+    if (_webServer) {
+        _webServer->setKeepAlive(enable, maxRequests, idleTimeoutMs);
+    }
+    _log(3, "Keep-alive %s (max %u requests, idle timeout: %u ms)", enable ? "enabled" : "disabled",
+         maxRequests, (unsigned int)idleTimeoutMs);
+}
+
+#if ENABLE_ADVANCED_ENDPOINTS
+void M5StackWiFiUploader::setOnTheFlyCompression(bool enable, uint32_t minSize) {
+    _gzipOnTheFly = enable;
+    _gzipMinSize = minSize;
+#if ENABLE_FILE_CACHE
+    // キャッシュ済みの表現（非圧縮）が新しい設定と食い違わないよう破棄
+    _fileCache.clear();
+#endif
+    _log(3, "On-the-fly gzip %s (min size: %u bytes, work memory: %u bytes)",
+         enable ? "enabled" : "disabled", minSize, (unsigned int)GzipStream::getMemoryUsage());
+}
+#endif
+
+#if ENABLE_DOWNLOAD_ENGINE
+void M5StackWiFiUploader::enableDownloadEngine(bool enable) {
+    _downloadEngineEnabled = enable;
+    _log(3, "Download engine %s", enable ? "enabled" : "disabled");
+}
+
+void M5StackWiFiUploader::setDownloadBuffers(size_t bufferSize, uint8_t bufferCount) {
+    _downloadStreamer.configure(bufferSize, bufferCount);
+    _log(3, "Download buffers set to %u x %u bytes",
+         _downloadStreamer.getBufferCount(), (unsigned int)_downloadStreamer.getBufferSize());
+}
+#endif
+
+#if ENABLE_FILE_CACHE
+void M5StackWiFiUploader::setFileCache(size_t capacity, size_t maxEntrySize) {
+    _fileCache.configure(capacity, maxEntrySize);
+    _fileCacheConfigured = true;
+    _log(3, "File cache set to %u bytes (max entry: %u bytes)", (unsigned int)capacity, (unsigned int)maxEntrySize);
+}
+
+void M5StackWiFiUploader::clearFileCache() {
+    _fileCache.clear();
+}
+#endif
+
+#if ENABLE_DIRECTORY_INDEX
+void M5StackWiFiUploader::setDirectoryIndex(uint32_t maxEntries, uint32_t verifyIntervalMs, bool persistent) {
+    _directoryIndex.configure(maxEntries, verifyIntervalMs, persistent);
+    _directoryIndexConfigured = true;
+    _log(3, "Directory index set to %u entries (verify interval: %u ms, persistent: %s)",
+         (unsigned int)maxEntries, (unsigned int)verifyIntervalMs, persistent ? "yes" : "no");
+    if (_isRunning) {
+        _rebuildDirectoryIndex();
+    }
+}
+
+void M5StackWiFiUploader::rescanDirectoryIndex() {
+    _rebuildDirectoryIndex(true);
+    _markDirectoryChanged();
+#if ENABLE_CHANGE_FEED
+    _changeFeed.reset();
+#endif
+}
+#endif
+
+#if ENABLE_DIRECTORY_STATS
+bool M5StackWiFiUploader::reconcileDirectoryStats() {
+#if ENABLE_SHARDED_STORAGE
+    const ShardedLayout* layout = &_storageLayout;
+#else
+    const ShardedLayout* layout = nullptr;
+#endif
+    bool complete = _directoryStats.rebuild(_uploadPath, layout);
+    _log(3, "Directory stats reconciled: %u files, %llu bytes (%u ms)%s",
+         (unsigned int)_directoryStats.getFileCount(), (unsigned long long)_directoryStats.getTotalBytes(),
+         (unsigned int)_directoryStats.getLastRebuildMs(), complete ? "" : " - scan failed");
+    return complete;
+}
+#endif
+
+#if ENABLE_SHARDED_STORAGE
+void M5StackWiFiUploader::setShardedStorage(uint16_t buckets) {
+    _storageLayout.configure(buckets);
+    _log(3, "Sharded storage %s (%u buckets)", buckets > 0 ? "enabled" : "disabled",
+         _storageLayout.getBucketCount());
+    if (_isRunning) {
+        migrateStorage();
+    }
+}
+
+uint32_t M5StackWiFiUploader::migrateStorage() {
+    // 名前空間は変わらないので、インデックス・キャッシュ・サムネイルはそのまま使える
+    unsigned long startTime = millis();
+    uint32_t conflicts = 0;
+    uint32_t moved = _storageLayout.migrate(_uploadPath, conflicts);
+    if (moved > 0) {
+        _markDirectoryChanged();
+    }
+    if (conflicts > 0) {
+        _log(2, "Storage migration: %u files could not be moved (name conflict or rename failure)",
+             (unsigned int)conflicts);
+    }
+    _log(3, "Storage migration: %u files moved (%u buckets, %u ms)", (unsigned int)moved,
+         _storageLayout.getBucketCount(), (unsigned int)(millis() - startTime));
+    return moved;
+}
+#endif
+
+#if ENABLE_TAIL
+void M5StackWiFiUploader::setTailLimits(uint8_t maxFollowers, uint32_t idleTimeoutMs) {
+    _tailManager.configure(maxFollowers, idleTimeoutMs);
+    _log(3, "Tail limits set to %u followers (idle timeout: %u ms)", maxFollowers, (unsigned int)idleTimeoutMs);
+}
+#endif
+
+#if ENABLE_CHANGE_FEED
+void M5StackWiFiUploader::setChangeFeedLimits(uint16_t capacity, uint8_t maxWaiters) {
+    _changeFeed.configure(capacity, maxWaiters);
+    _log(3, "Change feed limits set to %u changes, %u waiters", capacity, maxWaiters);
+}
+#endif
+
 // ============================================================================
 // ステータス取得
 // ============================================================================
@@ -203,46 +483,162 @@ uint32_t M5StackWiFiUploader::getSDTotalSpace() const {
 }
 
 bool M5StackWiFiUploader::fileExists(const char* filename) const {
-    String fullPath = _uploadPath + "/" + filename;
+#if ENABLE_DIRECTORY_INDEX
+    if (_directoryIndex.isValid() && !strchr(filename, '/')) {
+        return _directoryIndex.contains(filename);
+    }
+#endif
+    String fullPath = _storagePath(filename);
     return SD.exists(fullPath.c_str());
 }
 
 bool M5StackWiFiUploader::deleteFile(const char* filename) {
-    String fullPath = _uploadPath + "/" + filename;
-    Serial.printf("[DEBUG] deleteFile called with: '%s'\n", filename);
-    Serial.printf("[DEBUG] Full path to delete: '%s'\n", fullPath.c_str());
-    Serial.printf("[DEBUG] File exists before delete: %s\n", SD.exists(fullPath.c_str()) ? "true" : "false");
+    String fullPath = _storagePath(filename);
+    _log(4, "Deleting: %s", fullPath.c_str());
+    uint32_t oldSize = 0, oldModified = 0;
+    bool counted = _statFile(filename, oldSize, oldModified);
     
     if (SD.remove(fullPath.c_str())) {
-        Serial.printf("[DEBUG] SD.remove() returned true for: %s\n", fullPath.c_str());
-        Serial.printf("[DEBUG] File exists after delete: %s\n", SD.exists(fullPath.c_str()) ? "true" : "false");
+        _onFileChanged(filename);
+        if (counted) _uncountFile(filename, oldSize, oldModified);
+        _unindexFile(filename);
+#if ENABLE_THUMBNAILS
+        _invalidateThumbnails(filename);
+#endif
+#if ENABLE_TAIL
+        _tailManager.notifyRemove(filename);
+#endif
+#if ENABLE_CHANGE_FEED
+        _recordChange(CHANGE_DELETE, filename, 0);
+#endif
         _log(3, "File deleted: %s", filename);
         return true;
     } else {
-        Serial.printf("[DEBUG] SD.remove() returned false for: %s\n", fullPath.c_str());
         _log(2, "Failed to delete file: %s", filename);
         return false;
     }
 }
 
+bool M5StackWiFiUploader::appendFile(const char* filename, const uint8_t* data, size_t length) {
+    if (!_isValidFilename(filename)) {
+        _log(2, "Invalid filename: %s", filename);
+        return false;
+    }
+
+    String fullPath = _storagePath(filename);
+    File file = SD.open(fullPath.c_str(), FILE_APPEND);
+    if (!file) {
+        _log(1, "Failed to open file for appending: %s", fullPath.c_str());
+        return false;
+    }
+
+    uint32_t offset = file.size();
+    size_t written = file.write(data, length);
+    file.close();
+    _onFileChanged(filename);
+    _recountFile(filename, offset, offset + written);
+    _indexFile(filename, offset + written);
+#if ENABLE_CHANGE_FEED
+    _recordChange(offset == 0 ? CHANGE_CREATE : CHANGE_MODIFY, filename, offset + written);
+#endif
+
+    if (written != length) {
+        _log(1, "Append error: expected %u, wrote %u", (unsigned int)length, (unsigned int)written);
+        return false;
+    }
+#if ENABLE_TAIL
+    // SDを読み直さず、書き込んだデータをそのままフォロワーへ送る
+    _tailManager.notifyAppend(filename, offset, data, length);
+#endif
+    return true;
+}
+
+bool M5StackWiFiUploader::renameFile(const char* from, const char* to) {
+    if (!_isValidFilename(from) || !_isValidFilename(to) || _sanitizeFilename(from) != from ||
+        _sanitizeFilename(to) != to) {
+        _log(2, "Invalid filename: %s -> %s", from, to);
+        return false;
+    }
+    if (!_isValidExtension(to)) {
+        _log(2, "Invalid file extension: %s", to);
+        return false;
+    }
+
+    String fromPath = _storagePath(from);
+    String toPath = _storagePath(to);
+    uint32_t size = 0, modified = 0;
+    bool counted = _statFile(from, size, modified);
+    if (!SD.rename(fromPath.c_str(), toPath.c_str())) {
+        _log(2, "Failed to rename file: %s -> %s", from, to);
+        return false;
+    }
+
+    _onFileChanged(from);
+    _onFileChanged(to);
+    if (counted) {
+        _uncountFile(from, size, modified);
+        _countFile(to, size, modified);
+    }
+#if ENABLE_DIRECTORY_INDEX
+    _directoryIndex.rename(from, to);
+#endif
+#if ENABLE_THUMBNAILS
+    _invalidateThumbnails(from);
+    _invalidateThumbnails(to);
+#endif
+#if ENABLE_CHANGE_FEED
+    _recordChange(CHANGE_DELETE, from, 0);
+    _recordChange(CHANGE_CREATE, to);
+#endif
+    _log(3, "File renamed: %s -> %s", from, to);
+    return true;
+}
+
 std::vector<String> M5StackWiFiUploader::listFiles(const char* path) {
     std::vector<String> files;
     const char* searchPath = path ? path : _uploadPath.c_str();
-    
-    File dir = SD.open(searchPath);
-    if (!dir || !dir.isDirectory()) {
-        _log(2, "Failed to open directory: %s", searchPath);
+
+#if ENABLE_DIRECTORY_INDEX
+    if (_directoryIndex.isValid() && _uploadPath == searchPath) {
+        size_t count = min(_directoryIndex.getEntryCount(), (size_t)MAX_FILE_LIST_SIZE);
+        files.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            files.push_back(_directoryIndex.getEntry(i).name);
+        }
+        _log(3, "Listed %d files in %s (index)", files.size(), searchPath);
         return files;
     }
+#endif
+    
+    for (const auto& dirPath : _storageDirectories(searchPath)) {
+        File dir = SD.open(dirPath.c_str());
+        if (!dir || !dir.isDirectory()) {
+            if (dir) dir.close();
+            if (dirPath == searchPath) {
+                _log(2, "Failed to open directory: %s", searchPath);
+                return files;
+            }
+            continue;
+        }
 
-    File file = dir.openNextFile();
-    while (file) {
-        if (!file.isDirectory()) {
-            files.push_back(file.name());
+        bool truncated = false;
+        File file = dir.openNextFile();
+        while (file) {
+            if (!file.isDirectory()) {
+                if (files.size() >= MAX_FILE_LIST_SIZE) {
+                    _log(2, "File list truncated to %d entries: %s", MAX_FILE_LIST_SIZE, searchPath);
+                    file.close();
+                    truncated = true;
+                    break;
+                }
+                files.push_back(file.name());
+            }
+            file.close();
+            file = dir.openNextFile();
         }
-        file = dir.openNextFile();
+        dir.close();
+        if (truncated) break;
     }
-    dir.close();
 
     _log(3, "Listed %d files in %s", files.size(), searchPath);
     return files;
@@ -253,7 +649,20 @@ std::vector<String> M5StackWiFiUploader::listFiles(const char* path) {
 // ============================================================================
 
 void M5StackWiFiUploader::_handleRoot() {
-    String html = R"RAWHTML(
+    // ページ内容はビルド時に固定されるため、ビルド識別子をETagとする
+    // （ETagに使えない空白・コロンはハイフンに置換）
+    static String uiETag;
+    if (uiETag.length() == 0) {
+        uiETag = "\"ui-" WEB_UI_BUILD_ID "\"";
+        uiETag.replace(" ", "-");
+        uiETag.replace(":", "-");
+    }
+    if (_checkNotModified(uiETag)) {
+        return;
+    }
+
+    // 固定のページなので String へコピーせず、フラッシュ上の内容をそのまま送信
+    static const char html[] PROGMEM = R"RAWHTML(
 <!DOCTYPE html>
 <html>
 <head>
@@ -287,6 +696,7 @@ void M5StackWiFiUploader::_handleRoot() {
         .file-name:hover { text-decoration: underline; }
         .file-size { color: #666; }
         .file-date { color: #999; font-size: 0.9em; }
+        .thumb { width: 48px; height: 48px; object-fit: cover; vertical-align: middle; margin-right: 8px; border-radius: 4px; background: #eee; }
         .progress { width: 100%; height: 20px; background: #e0e0e0; border-radius: 4px; margin: 10px 0; overflow: hidden; }
         .progress-bar { height: 100%; background: #4CAF50; width: 0%; transition: width 0.3s; }
         .status { padding: 10px; margin: 10px 0; border-radius: 4px; }
@@ -296,6 +706,8 @@ void M5StackWiFiUploader::_handleRoot() {
         .actions { display: flex; gap: 5px; }
         .no-files { text-align: center; padding: 20px; color: #999; }
         .loading { text-align: center; padding: 20px; }
+        .load-more { display: block; margin: 10px auto; }
+        .search { width: 100%; box-sizing: border-box; padding: 8px; margin: 10px 0; border: 1px solid #ccc; border-radius: 4px; font-size: 14px; }
         
         /* モバイル対応 */
         @media (max-width: 768px) {
@@ -369,6 +781,9 @@ void M5StackWiFiUploader::_handleRoot() {
         <div class="file-list">
             <h2 id="fileListTitle">SDカード内のファイル</h2>
             <button onclick="loadFilesList()" class="success" id="refreshBtn">更新</button>
+            <button onclick="downloadSelected('zip')" id="downloadSelectedBtn">選択したファイルをダウンロード (ZIP)</button>
+            <button onclick="deleteSelected()" class="danger" id="deleteSelectedBtn">選択したファイルを削除</button>
+            <input type="search" id="searchInput" class="search" placeholder="ファイル名で検索（例: cam1_2026-10-*）">
             <div id="filesList" class="loading">読み込み中...</div>
         </div>
     </div>
@@ -393,7 +808,16 @@ void M5StackWiFiUploader::_handleRoot() {
                 uploadError: 'ファイルのアップロードに失敗しました',
                 deleteSuccess: 'ファイルが正常に削除されました',
                 deleteError: 'ファイルの削除に失敗しました',
-                listError: 'ファイル一覧の取得に失敗しました'
+                listError: 'ファイル一覧の取得に失敗しました',
+                downloadSelected: '選択したファイルをダウンロード (ZIP)',
+                deleteSelected: '選択したファイルを削除',
+                deleteSelectedConfirm: '個のファイルを削除しますか？',
+                batchDeleted: '個のファイルを削除しました',
+                batchFailed: '個のファイルを削除できませんでした',
+                noSelection: 'ファイルが選択されていません',
+                archiveDownloading: '個のファイルをまとめてダウンロード中...',
+                loadMore: 'さらに読み込む',
+                searchPlaceholder: 'ファイル名で検索（例: cam1_2026-10-*）'
             },
             en: {
                 title: 'WiFi File Uploader',
@@ -412,7 +836,16 @@ void M5StackWiFiUploader::_handleRoot() {
                 uploadError: 'Failed to upload file',
                 deleteSuccess: 'File deleted successfully',
                 deleteError: 'Failed to delete file',
-                listError: 'Failed to get file list'
+                listError: 'Failed to get file list',
+                downloadSelected: 'Download Selected (ZIP)',
+                deleteSelected: 'Delete Selected',
+                deleteSelectedConfirm: ' files will be deleted. Continue?',
+                batchDeleted: ' files deleted',
+                batchFailed: ' files could not be deleted',
+                noSelection: 'No files selected',
+                archiveDownloading: ' files downloading as archive...',
+                loadMore: 'Load more',
+                searchPlaceholder: 'Search by filename (e.g. cam1_2026-10-*)'
             }
         };
 
@@ -433,6 +866,9 @@ void M5StackWiFiUploader::_handleRoot() {
             document.querySelector('#uploadArea button').textContent = t.selectFile;
             document.getElementById('fileListTitle').textContent = t.fileListTitle;
             document.getElementById('refreshBtn').textContent = t.refresh;
+            document.getElementById('downloadSelectedBtn').textContent = t.downloadSelected;
+            document.getElementById('deleteSelectedBtn').textContent = t.deleteSelected;
+            document.getElementById('searchInput').placeholder = t.searchPlaceholder;
             
             // ファイル一覧を再読み込み
             loadFilesList();
@@ -499,7 +935,7 @@ void M5StackWiFiUploader::_handleRoot() {
                     const t = translations[currentLang];
                     showStatus('success', `${file.name} ${t.uploadSuccess}`);
                     document.getElementById(progressId).remove();
-                    loadFilesList();
+                    refreshAfterChange();
                 } else {
                     const t = translations[currentLang];
                     showStatus('error', `${file.name} ${t.uploadError}: ${xhr.status}`);
@@ -515,20 +951,62 @@ void M5StackWiFiUploader::_handleRoot() {
             xhr.send(formData);
         }
 
+        // 一覧はページ単位（カーソル方式）で取得し、続きは「さらに読み込む」で追加する
+        const FILE_LIST_PAGE_SIZE = 100;
+
+        // 検索欄の入力中は /api/search で絞り込む（* か ? を含めばワイルドカード、それ以外は接頭辞）
+        const searchInput = document.getElementById('searchInput');
+        let searchTimer = null;
+        let listRequestId = 0;
+
+        searchInput.addEventListener('input', () => {
+            clearTimeout(searchTimer);
+            searchTimer = setTimeout(loadFilesList, 150);
+        });
+
+        function fileListUrl() {
+            const query = searchInput.value.trim();
+            if (!query) {
+                return `/api/files/list?limit=${FILE_LIST_PAGE_SIZE}`;
+            }
+            const param = /[*?]/.test(query) ? 'glob' : 'prefix';
+            return `/api/search?${param}=${encodeURIComponent(query)}&limit=${FILE_LIST_PAGE_SIZE}`;
+        }
+
         function loadFilesList() {
             const t = translations[currentLang];
             filesListDiv.innerHTML = `<div class="loading">${t.loading}</div>`;
-            
-            fetch('/api/files/list')
+            loadFilesPage(null);
+        }
+
+        function loadFilesPage(cursor) {
+            const t = translations[currentLang];
+            let url = fileListUrl();
+            if (cursor) {
+                url += `&cursor=${encodeURIComponent(cursor)}`;
+            }
+
+            // 入力が続いた場合は古い検索結果を表示しない
+            const requestId = ++listRequestId;
+            fetch(url)
                 .then(response => response.json())
                 .then(data => {
-                    filesListDiv.innerHTML = '';
-                    if (data.files && data.files.length > 0) {
+                    if (requestId !== listRequestId) return;
+                    const moreBtn = document.getElementById('loadMoreBtn');
+                    if (moreBtn) moreBtn.remove();
+
+                    if (!cursor) {
+                        filesListDiv.innerHTML = '';
+                        if (!data.files || data.files.length === 0) {
+                            filesListDiv.innerHTML = `<div class="no-files">${t.noFiles}</div>`;
+                            return;
+                        }
                         const table = document.createElement('table');
                         table.className = 'file-table';
                         table.innerHTML = `
                             <thead>
                                 <tr>
+                                    <th><input type="checkbox" id="selectAll" onclick="toggleSelectAll(this.checked)"></th>
                                     <th>${currentLang === 'ja' ? 'ファイル名' : 'Filename'}</th>
                                     <th>${currentLang === 'ja' ? 'サイズ' : 'Size'}</th>
                                     <th>${currentLang === 'ja' ? '更新日時' : 'Modified'}</th>
@@ -538,28 +1016,47 @@ void M5StackWiFiUploader::_handleRoot() {
                             <tbody id="filesTableBody"></tbody>
                         `;
                         filesListDiv.appendChild(table);
-                        
-                        const tbody = document.getElementById('filesTableBody');
-                        data.files.forEach(file => {
-                            const row = document.createElement('tr');
-                            row.innerHTML = `
-                                <td><span class="file-name" onclick="downloadFile('${file.name}')">${file.name}</span></td>
-                                <td class="file-size">${formatFileSize(file.size)}</td>
-                                <td class="file-date">${formatDate(file.modified)}</td>
-                                <td class="actions">
-                                    <button onclick="downloadFile('${file.name}')" class="success">${t.download}</button>
-                                    <button onclick="deleteFile('${file.name}')" class="danger">${t.delete}</button>
-                                </td>
-                            `;
-                            tbody.appendChild(row);
-                        });
-                    } else {
-                        filesListDiv.innerHTML = `<div class="no-files">${t.noFiles}</div>`;
+                    }
+
+                    const tbody = document.getElementById('filesTableBody');
+                    (data.files || []).forEach(file => {
+                        const row = document.createElement('tr');
+                        // JPEGはサムネイルを表示（画面内に入ったときだけ読み込む）
+                        const ext = (file.extension || '').toLowerCase();
+                        const thumb = (ext === 'jpg' || ext === 'jpeg')
+                            ? `<img class="thumb" loading="lazy" src="/api/thumb?filename=${encodeURIComponent(file.name)}&size=96" onerror="this.remove()">`
+                            : '';
+                        row.innerHTML = `
+                            <td><input type="checkbox" class="file-select" value="${file.name}"></td>
+                            <td>${thumb}<span class="file-name" onclick="downloadFile('${file.name}')">${file.name}</span></td>
+                            <td class="file-size">${formatFileSize(file.size)}</td>
+                            <td class="file-date">${formatDate(file.modified)}</td>
+                            <td class="actions">
+                                <button onclick="downloadFile('${file.name}')" class="success">${t.download}</button>
+                                <button onclick="deleteFile('${file.name}')" class="danger">${t.delete}</button>
+                            </td>
+                        `;
+                        tbody.appendChild(row);
+                    });
+
+                    if (data.nextCursor) {
+                        const button = document.createElement('button');
+                        button.id = 'loadMoreBtn';
+                        button.className = 'load-more';
+                        button.textContent = t.loadMore;
+                        button.onclick = () => {
+                            button.disabled = true;
+                            loadFilesPage(data.nextCursor);
+                        };
+                        filesListDiv.appendChild(button);
                     }
                 })
                 .catch(error => {
+                    if (requestId !== listRequestId) return;
                     const t = translations[currentLang];
-                    filesListDiv.innerHTML = `<div class="no-files">${t.listError}</div>`;
+                    if (!cursor) {
+                        filesListDiv.innerHTML = `<div class="no-files">${t.listError}</div>`;
+                    }
                     showStatus('error', t.listError);
                 });
         }
@@ -570,6 +1067,60 @@ void M5StackWiFiUploader::_handleRoot() {
             showStatus('info', `${filename}${t.downloading}`);
         }
 
+        function toggleSelectAll(checked) {
+            document.querySelectorAll('.file-select').forEach(cb => cb.checked = checked);
+        }
+
+        function downloadSelected(format) {
+            const t = translations[currentLang];
+            const names = Array.from(document.querySelectorAll('.file-select:checked')).map(cb => cb.value);
+            if (names.length === 0) {
+                showStatus('error', t.noSelection);
+                return;
+            }
+
+            // 多数のファイル名でもURL長の制限を受けないようフォームでPOSTする
+            const form = document.createElement('form');
+            form.method = 'POST';
+            form.action = '/api/download/archive';
+            [['format', format], ['files', names.join('\n')]].forEach(([name, value]) => {
+                const input = document.createElement('input');
+                input.type = 'hidden';
+                input.name = name;
+                input.value = value;
+                form.appendChild(input);
+            });
+            document.body.appendChild(form);
+            form.submit();
+            form.remove();
+            showStatus('info', `${names.length}${t.archiveDownloading}`);
+        }
+
+        function deleteSelected() {
+            const t = translations[currentLang];
+            const names = Array.from(document.querySelectorAll('.file-select:checked')).map(cb => cb.value);
+            if (names.length === 0) {
+                showStatus('error', t.noSelection);
+                return;
+            }
+            if (!confirm(`${names.length}${t.deleteSelectedConfirm}`)) return;
+
+            // 1リクエストでまとめて削除し、一覧の再読み込みも最後の1回だけにする
+            fetch('/api/batch', {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify({ operations: names.map(name => ({ op: 'delete', filename: name })) })
+            })
+                .then(response => response.json())
+                .then(data => {
+                    if (data.succeeded > 0) showStatus('success', `${data.succeeded}${t.batchDeleted}`);
+                    if (data.failed > 0) showStatus('error', `${data.failed}${t.batchFailed}`);
+                    if (data.message) showStatus('error', data.message);
+                    refreshAfterChange();
+                })
+                .catch(error => showStatus('error', t.deleteError));
+        }
+
         function deleteFile(filename) {
             const t = translations[currentLang];
             console.log(`[DEBUG] deleteFile called with: ${filename}`);
@@ -592,7 +1143,7 @@ if (confirm(currentLang === 'ja' ? `${filename} を削除しますか？` : `Del
                     console.log(`[DEBUG] Response data:`, data);
                     if (data.success) {
                         showStatus('success', `${filename} ${t.deleteSuccess}`);
-                        loadFilesList();
+                        refreshAfterChange();
                     } else {
                         showStatus('error', `${filename} ${t.deleteError}`);
                     }
@@ -631,13 +1182,52 @@ if (confirm(currentLang === 'ja' ? `${filename} を削除しますか？` : `Del
             setTimeout(() => status.remove(), 5000);
         }
 
+        // 変更フィード（/api/changes）を待ち受け、他のクライアントやデバイス側での変更も一覧に反映する
+        // 無効な構成（404）では待ち受けず、操作のたびに一覧を読み直す
+        let changeFeedActive = false;
+        let changeSeq = null;
+        let changeFeedId = null;
+        let changeReloadTimer = null;
+
+        function refreshAfterChange() {
+            if (!changeFeedActive) loadFilesList();
+        }
+
+        function watchChanges() {
+            const url = changeSeq === null ? '/api/changes' : `/api/changes?since=${changeSeq}&wait=30`;
+            fetch(url)
+                .then(response => {
+                    if (response.status === 404) return null;
+                    if (!response.ok) throw new Error(response.status);
+                    return response.json();
+                })
+                .then(data => {
+                    if (!data) return;
+                    changeFeedActive = true;
+                    const restarted = changeFeedId !== null && data.feedId !== changeFeedId;
+                    if (changeSeq !== null && (restarted || data.reset || data.changes.length > 0)) {
+                        // 続けて届く変更（複数ファイルのアップロードなど）は1回の再読み込みにまとめる
+                        clearTimeout(changeReloadTimer);
+                        changeReloadTimer = setTimeout(loadFilesList, 300);
+                    }
+                    changeFeedId = data.feedId;
+                    changeSeq = data.latest;
+                    watchChanges();
+                })
+                .catch(error => {
+                    changeFeedActive = false;
+                    setTimeout(watchChanges, 5000);
+                });
+        }
+
         loadFilesList();
+        watchChanges();
     </script>
 </body>
 </html>
     )RAWHTML";
-    
-    _webServer->send(200, "text/html; charset=utf-8", html);
+
+    _webServer->send_P(200, "text/html; charset=utf-8", html, sizeof(html) - 1);
 }
 
 void M5StackWiFiUploader::_handleUploadHTTP() {
@@ -648,19 +1238,18 @@ void M5StackWiFiUploader::_handleUploadHTTP() {
 
 void M5StackWiFiUploader::_handleUploadData() {
     HTTPUpload& upload = _webServer->upload();
-    static File uploadFile;
-    static String currentFilename;
     static uint32_t currentFilesize;
     static uint32_t lastProgressSize = 0;
     static uint32_t lastFlushSize = 0;
+    static bool replacing = false;  // 既存のファイルを上書きしているか（変更フィードの種類に使う）
     
     if (upload.status == UPLOAD_FILE_START) {
         // 既存のファイルハンドルが開いている場合はクローズ
-        if (uploadFile) {
-            uploadFile.close();
+        if (_uploadFile) {
+            _uploadFile.close();
         }
         
-        currentFilename = upload.filename;
+        _uploadFilename = upload.filename;
         currentFilesize = 0;
         
         // 進捗カウンタとフラッシュカウンタをリセット
@@ -677,287 +1266,2189 @@ void M5StackWiFiUploader::_handleUploadData() {
         uint32_t freeHeap = ESP.getFreeHeap();
         uint32_t minFreeHeap = ESP.getMinFreeHeap();
         
-        _log(3, "Upload Start: %s", currentFilename.c_str());
+        _log(3, "Upload Start: %s", _uploadFilename.c_str());
         _log(3, "SD Card - Total: %llu MB, Used: %llu MB, Free: %llu MB", totalBytes, usedBytes, freeBytes);
         _log(3, "Heap - Free: %u bytes, Min Free: %u bytes", freeHeap, minFreeHeap);
         
-        // ファイル名を検証
-        if (!_isValidFilename(currentFilename.c_str())) {
-            _log(2, "Invalid filename: %s", currentFilename.c_str());
-            return;
-        }
-        
-        currentFilename = _sanitizeFilename(currentFilename.c_str());
-        
-        // 拡張子を検証
-        if (!_isValidExtension(currentFilename.c_str())) {
-            _log(2, "Invalid file extension: %s", currentFilename.c_str());
-            return;
-        }
-        
-        // ファイルパスを作成
-        String fullPath = _uploadPath + "/" + currentFilename;
-        
-        // 上書き保護をチェック
-        if (_overwriteProtection && SD.exists(fullPath.c_str())) {
-            _log(2, "File already exists (overwrite protection): %s", currentFilename.c_str());
-            return;
-        }
-        
-        // ファイルを開く
-        uploadFile = SD.open(fullPath.c_str(), FILE_WRITE);
-        if (!uploadFile) {
-            _log(1, "Failed to open file for writing: %s", fullPath.c_str());
+        // ファイル名・保存先を検証して開く（?path= で指定したサブディレクトリに保存）
+        uint8_t errorCode;
+        if (_openUpload(_uploadFilename, _webServer->arg("path"), _uploadFile, replacing, errorCode)) {
             return;
         }
         
         // コールバック: アップロード開始
         // 注: upload.totalSizeはマルチパートの全体サイズなので、個別ファイルサイズとしては使えない
         if (_onUploadStart != nullptr) {
-            _onUploadStart(currentFilename.c_str(), 0);  // サイズは不明なので0を渡す
+            _onUploadStart(_uploadFilename.c_str(), 0);  // サイズは不明なので0を渡す
         }
         
     } else if (upload.status == UPLOAD_FILE_WRITE) {
-        if (uploadFile) {
+        if (_uploadFile) {
             // ファイルサイズをチェック
             currentFilesize += upload.currentSize;
             if (currentFilesize > _maxFileSize) {
                 _log(2, "File too large: %d bytes (max: %d)", currentFilesize, _maxFileSize);
-                uploadFile.close();
-                String fullPath = _uploadPath + "/" + currentFilename;
-                SD.remove(fullPath.c_str());
+                _discardUpload(_uploadFile, _uploadFilename, replacing);
                 return;
             }
             
             // データを書き込み
-            size_t written = uploadFile.write(upload.buf, upload.currentSize);
+            size_t written = _uploadFile.write(upload.buf, upload.currentSize);
             if (written != upload.currentSize) {
                 uint32_t freeHeap = ESP.getFreeHeap();
                 _log(1, "Write error: expected %d, wrote %d (Free heap: %u bytes)", upload.currentSize, written, freeHeap);
-                uploadFile.close();
-                String fullPath = _uploadPath + "/" + currentFilename;
-                SD.remove(fullPath.c_str());
+                _discardUpload(_uploadFile, _uploadFilename, replacing);
                 
                 // コールバック: エラー
                 if (_onUploadError) {
-                    _onUploadError(currentFilename.c_str(), ERR_SD_WRITE_FAILED, "SD write failed");
+                    _onUploadError(_uploadFilename.c_str(), ERR_SD_WRITE_FAILED, "SD write failed");
                 }
                 return;
             }
+#if ENABLE_TAIL
+            _tailManager.notifyAppend(_uploadFilename, currentFilesize - upload.currentSize,
+                                      upload.buf, upload.currentSize);
+#endif
             
             // 256KBごとにflushしてSDカードへの書き込みを確実にする
             if (currentFilesize - lastFlushSize >= 262144 || currentFilesize < lastFlushSize) {
-                uploadFile.flush();
+                _uploadFile.flush();
                 delay(10);  // SDカードの書き込み完了を待つ
                 lastFlushSize = currentFilesize;
             }
             
             // コールバック: 進捗 (64KBごとに呼び出してメモリ負荷を軽減)
             if (_onUploadProgress && (currentFilesize - lastProgressSize >= 65536 || currentFilesize < lastProgressSize)) {
-                _onUploadProgress(currentFilename.c_str(), currentFilesize, currentFilesize);
+                _onUploadProgress(_uploadFilename.c_str(), currentFilesize, currentFilesize);
                 lastProgressSize = currentFilesize;
             }
         }
         
     } else if (upload.status == UPLOAD_FILE_END) {
-        if (uploadFile) {
-            uploadFile.close();
-            _totalUploaded += currentFilesize;
-            _log(3, "Upload Complete: %s (%d bytes)", currentFilename.c_str(), currentFilesize);
+        if (_uploadFile) {
+            _finishUpload(_uploadFile, _uploadFilename, currentFilesize, replacing);
+            _log(3, "Upload Complete: %s (%d bytes)", _uploadFilename.c_str(), currentFilesize);
             
             // コールバック: アップロード完了
             if (_onUploadComplete) {
-                _onUploadComplete(currentFilename.c_str(), currentFilesize, true);
+                _onUploadComplete(_uploadFilename.c_str(), currentFilesize, true);
             }
         }
         
     } else if (upload.status == UPLOAD_FILE_ABORTED) {
-        if (uploadFile) {
-            uploadFile.close();
-            String fullPath = _uploadPath + "/" + currentFilename;
-            SD.remove(fullPath.c_str());
-            _log(2, "Upload Aborted: %s", currentFilename.c_str());
+        if (_uploadFile) {
+            _discardUpload(_uploadFile, _uploadFilename, replacing);
+            _log(2, "Upload Aborted: %s", _uploadFilename.c_str());
             
             // コールバック: エラー
             if (_onUploadError) {
-                _onUploadError(currentFilename.c_str(), ERR_UNKNOWN, "Upload aborted");
+                _onUploadError(_uploadFilename.c_str(), ERR_UNKNOWN, "Upload aborted");
             }
         }
     }
 }
 
-void M5StackWiFiUploader::_handleListFiles() {
-    std::vector<String> files = listFiles();
-    
-    String json = "{\"success\": true, \"files\": [";
-    for (size_t i = 0; i < files.size(); i++) {
-        json += "\"" + files[i] + "\"";
-        if (i < files.size() - 1) {
-            json += ", ";
-        }
+#if ENABLE_WEBSOCKET
+void M5StackWiFiUploader::_handleWebSocketFileInfo(uint8_t clientId, const WSFileInfo& info) {
+    // 同じチャンネルで前のファイルを送り終える前に次の file_info が届いた場合は、前のファイルを中止する
+    if (_findClientSession(clientId, info.channel)) {
+        _abortWebSocketUpload(clientId, info.channel, ERR_CANCELLED, "Upload superseded by new file_info");
     }
-    json += "]}";
 
-    _webServer->send(200, "application/json", json);
-}
-
-void M5StackWiFiUploader::_handleDeleteFile() {
-    Serial.println("[DEBUG] _handleDeleteFile called");
-    Serial.printf("[DEBUG] HTTP method: %d\n", _webServer->method());
-    
-    if (_webServer->method() != HTTP_DELETE && _webServer->method() != HTTP_POST) {
-        Serial.println("[DEBUG] Method not allowed");
-        _sendJSONResponse(false, "Method not allowed");
+    _log(3, "WebSocket upload start: %s (%u bytes, client %u, channel %u)", info.filename.c_str(),
+         (unsigned int)info.filesize, clientId, info.channel);
+    if (info.filesize > _maxFileSize) {
+        _log(2, "File too large: %u bytes (max: %u)", (unsigned int)info.filesize, (unsigned int)_maxFileSize);
+        _wsHandler->sendError(clientId, ERR_FILE_TOO_LARGE, "File too large", info.channel);
         return;
     }
 
-    String filename;
-    
-    // DELETEメソッドの場合はクエリパラメータから取得
-    if (_webServer->method() == HTTP_DELETE) {
-        filename = _webServer->arg("filename");
-        Serial.printf("[DEBUG] DELETE method, filename from query: '%s'\n", filename.c_str());
-    } else {
-        // POSTメソッドの場合はJSONボディから取得
-        String body = _webServer->arg("plain");
-        Serial.printf("[DEBUG] POST method, body: '%s'\n", body.c_str());
-        
-        int filenamePos = body.indexOf("\"filename\"");
-        if (filenamePos == -1) {
-            Serial.println("[DEBUG] No filename in JSON body");
-            _sendJSONResponse(false, "No filename provided");
-            return;
-        }
-        
-        int startPos = body.indexOf("\"", filenamePos + 11) + 1;
-        int endPos = body.indexOf("\"", startPos);
-        filename = body.substring(startPos, endPos);
-        Serial.printf("[DEBUG] Extracted filename: '%s'\n", filename.c_str());
-    }
-
-    if (filename.length() == 0) {
-        Serial.println("[DEBUG] Empty filename");
-        _sendJSONResponse(false, "No filename provided");
+    // 同時に開くファイルはSDライブラリの上限（既定5）に収まる数までとし、クライアントは完了を待って次を送る
+    if (_activeSessions.size() >= MAX_CONCURRENT_UPLOADS) {
+        _log(2, "Too many concurrent uploads (max: %u)", (unsigned int)MAX_CONCURRENT_UPLOADS);
+        _wsHandler->sendError(clientId, ERR_INVALID_REQUEST, "Too many concurrent uploads", info.channel);
         return;
     }
 
-    // ファイル名を検証
-    if (!_isValidFilename(filename.c_str())) {
-        Serial.printf("[DEBUG] Invalid filename: '%s'\n", filename.c_str());
-        _sendJSONResponse(false, "Invalid filename");
+    String filename = info.filename;
+    File file;
+    bool replacing = false;
+    uint8_t errorCode;
+    const char* error = _openUpload(filename, info.path, file, replacing, errorCode);
+    if (error) {
+        _wsHandler->sendError(clientId, errorCode, error, info.channel);
         return;
     }
 
-    String fullPath = _uploadPath + "/" + filename;
-    Serial.printf("[DEBUG] Full path: '%s'\n", fullPath.c_str());
-    Serial.printf("[DEBUG] File exists: %s\n", SD.exists(fullPath.c_str()) ? "true" : "false");
-
-    if (deleteFile(filename.c_str())) {
-        Serial.printf("[DEBUG] File deleted successfully: %s\n", filename.c_str());
-        _sendJSONResponse(true, "File deleted successfully", filename.c_str());
-    } else {
-        Serial.printf("[DEBUG] Failed to delete file: %s\n", filename.c_str());
-        _sendJSONResponse(false, "Failed to delete file");
+    UploadSession* session = _getSession(_createSession(filename.c_str(), info.filesize));
+    session->file = file;
+    session->clientId = clientId;
+    session->channel = info.channel;
+    session->nextSequence = 0;
+    session->replacing = replacing;
+    session->lastProgress = 0;
+    session->lastFlush = 0;
+    session->lastActivity = millis();
+    uint32_t chunkSize = info.chunkSize > 0 && info.chunkSize < DEFAULT_WS_MAX_CHUNK_SIZE ? info.chunkSize
+                                                                                       : DEFAULT_WS_MAX_CHUNK_SIZE;
+    uint16_t credit = session->credit.begin(chunkSize);
+
+    // コールバック: アップロード開始（WebSocketでは file_info でサイズが分かる）
+    if (_onUploadStart != nullptr) {
+        _onUploadStart(filename.c_str(), info.filesize);
     }
-}
-
-void M5StackWiFiUploader::_handleStatus() {
-    String json = "{";
-    json += "\"running\": " + String(_isRunning ? "true" : "false") + ", ";
-    json += "\"activeUploads\": " + String(getActiveUploads()) + ", ";
-    json += "\"totalUploaded\": " + String(_totalUploaded) + ", ";
-    json += "\"sdFreeSpace\": " + String(getSDFreeSpace()) + ", ";
-    json += "\"sdTotalSpace\": " + String(getSDTotalSpace()) + ", ";
-    json += "\"serverIP\": \"" + getServerIP() + "\", ";
-    json += "\"serverPort\": " + String(_port);
-    json += "}";
 
-    _webServer->send(200, "application/json", json);
+    // 受け付けの応答で最初のクレジットとチャンクの上限を通知し、クライアントは以降のバイナリフレームを送る
+    _wsHandler->sendAck(clientId, filename.c_str(), 0, 0, credit, chunkSize, info.channel);
+    if (info.filesize == 0) {
+        _handleWebSocketData(clientId, info.channel, 0, nullptr, 0);
+    }
 }
 
-#if ENABLE_ADVANCED_ENDPOINTS
-void M5StackWiFiUploader::_handleFileListDetailed() {
-    _log(3, "Handling detailed file list request");
-    
-    std::vector<FileInfo> files = SDCardManager::listFilesWithInfo(_uploadPath.c_str(), false);
-    
-    String json = "{";
-    json += "\"files\": [";
-    
-    for (size_t i = 0; i < files.size(); i++) {
-        if (i > 0) json += ", ";
-        json += "{";
-        json += "\"name\": \"" + files[i].name + "\", ";
-        json += "\"size\": " + String(files[i].size) + ", ";
-        json += "\"modified\": " + String(files[i].modified) + ", ";
-        json += "\"isDirectory\": " + String(files[i].isDirectory ? "true" : "false") + ", ";
-        json += "\"extension\": \"" + files[i].extension + "\"";
-        json += "}";
+void M5StackWiFiUploader::_handleWebSocketData(uint8_t clientId, uint8_t channel, uint16_t sequence,
+                                               const uint8_t* data, size_t length) {
+    UploadSession* session = _findClientSession(clientId, channel);
+    if (!session) {
+        // 拒否した file_info に続くフレームは、エラーを返し済みなので読み捨てる
+        _log(4, "WebSocket data without upload session (client %u, channel %u, %u bytes)", clientId, channel,
+             (unsigned int)length);
+        return;
     }
-    
-    json += "], ";
-    json += "\"total\": " + String(files.size());
-    json += "}";
-    
-    _webServer->send(200, "application/json", json);
-}
-#endif
 
-#if ENABLE_ADVANCED_ENDPOINTS
-void M5StackWiFiUploader::_handleFileDownload() {
-    if (!_webServer->hasArg("filename")) {
-        _sendJSONResponse(false, "Missing filename parameter", nullptr);
+    // TCP上で順序は保たれるので、番号の飛びはクライアントがフレームを取りこぼしたか混同したもの
+    if (sequence != session->nextSequence) {
+        _log(2, "WebSocket sequence mismatch: expected %u, got %u (channel %u)", session->nextSequence, sequence,
+             channel);
+        _abortWebSocketUpload(clientId, channel, ERR_INVALID_DATA, "Sequence mismatch");
         return;
     }
+    session->nextSequence++;
+
+    if (length > session->filesize - session->uploaded) {
+        _abortWebSocketUpload(clientId, channel, ERR_INVALID_DATA, "More data than filesize");
+        return;
+    }
+
+    if (length > 0) {
+        // クレジットを守らないクライアントのデータは受信バッファに溜まる前提が崩れるので中止する
+        if (length > session->credit.getChunkSize()) {
+            _abortWebSocketUpload(clientId, channel, ERR_INVALID_DATA, "Frame larger than chunkSize");
+            return;
+        }
+        if (!session->credit.consume()) {
+            _abortWebSocketUpload(clientId, channel, ERR_INVALID_DATA, "Credit exceeded");
+            return;
+        }
+
+        unsigned long writeStart = micros();
+        size_t written = session->file.write(data, length);
+        if (written != length) {
+            _log(1, "Write error: expected %u, wrote %u (Free heap: %u bytes)", (unsigned int)length,
+                 (unsigned int)written, ESP.getFreeHeap());
+            _abortWebSocketUpload(clientId, channel, ERR_SD_WRITE_FAILED, "SD write failed");
+            return;
+        }
+#if ENABLE_TAIL
+        _tailManager.notifyAppend(session->filename, session->uploaded, data, length);
+#endif
+        session->uploaded += length;
+        session->lastActivity = millis();
+
+        // 256KBごとにflushしてSDカードへの書き込みを確実にする
+        if (session->uploaded - session->lastFlush >= 262144) {
+            session->file.flush();
+            session->lastFlush = session->uploaded;
+        }
+        session->credit.recordDrain(length, micros() - writeStart);
+    }
+
+    if (session->uploaded < session->filesize) {
+        // コールバック・クライアントへの進捗通知は64KBごと
+        if (session->uploaded - session->lastProgress >= 65536) {
+            if (_onUploadProgress) {
+                _onUploadProgress(session->filename.c_str(), session->uploaded, session->filesize);
+            }
+            _wsHandler->sendProgress(clientId, session->filename.c_str(), session->uploaded, session->filesize,
+                                     channel);
+            session->lastProgress = session->uploaded;
+        }
+        // 書き込みを終えたチャンクの分だけクレジットを与え直す（同時に書き込む転送とウィンドウを分け合う）
+        if (session->credit.needsGrant()) {
+            uint16_t credit = session->credit.grant(_activeSessions.size());
+            _wsHandler->sendAck(clientId, session->filename.c_str(), session->credit.getReceived(),
+                                session->uploaded, credit, 0, channel);
+        }
+        return;
+    }
+
+    // file_info で通知されたサイズに達したら完了
+    String filename = session->filename;
+    uint32_t filesize = session->filesize;
+    _log(3, "WebSocket upload complete: %s (%u bytes, SD drain %u KB/s, window %u chunks)", filename.c_str(),
+         (unsigned int)filesize, (unsigned int)(session->credit.getDrainRate() / 1024), session->credit.getWindow());
+    _finishUpload(session->file, filename, filesize, session->replacing);
+    _closeSession(session->sessionId);
+
+    // コールバック: アップロード完了
+    if (_onUploadComplete) {
+        _onUploadComplete(filename.c_str(), filesize, true);
+    }
+    _wsHandler->sendComplete(clientId, filename.c_str(), true, channel);
+}
+
+void M5StackWiFiUploader::_abortWebSocketUpload(uint8_t clientId, int16_t channel, uint8_t errorCode,
+                                                const char* message) {
+    // channel が負の場合（切断・チャンネルを指定しない cancel）はクライアントの全ての転送を中止する
+    UploadSession* session;
+    while ((session = _findClientSession(clientId, channel)) != nullptr) {
+        String filename = session->filename;
+        uint8_t sessionChannel = session->channel;
+        _discardUpload(session->file, filename, session->replacing);
+        _closeSession(session->sessionId);
+        _log(2, "WebSocket upload aborted: %s (channel %u, %s)", filename.c_str(), sessionChannel,
+             message ? message : "client disconnected");
+
+        // コールバック: エラー（切断時はクライアントへ通知しない）
+        if (_onUploadError) {
+            _onUploadError(filename.c_str(), errorCode, message ? message : "Connection lost");
+        }
+        if (message && _wsHandler) {
+            _wsHandler->sendError(clientId, errorCode, message, sessionChannel);
+            _wsHandler->sendComplete(clientId, filename.c_str(), false, sessionChannel);
+        }
+    }
+}
+
+void M5StackWiFiUploader::_checkWebSocketTimeouts() {
+    // 切断を検出できないまま送信が止まったクライアントのファイルを閉じる
+    unsigned long now = millis();
+    for (auto& entry : _activeSessions) {
+        UploadSession& session = entry.second;
+        if (session.isActive && now - session.lastActivity >= DEFAULT_WS_TIMEOUT) {
+            _abortWebSocketUpload(session.clientId, session.channel, ERR_TIMEOUT, "Upload timed out");
+            return;  // セッションを削除したので残りは次回に確認する
+        }
+    }
+}
+
+UploadSession* M5StackWiFiUploader::_findClientSession(uint8_t clientId, int16_t channel) {
+    for (auto& entry : _activeSessions) {
+        if (entry.second.isActive && entry.second.clientId == clientId &&
+            (channel < 0 || entry.second.channel == channel)) {
+            return &entry.second;
+        }
+    }
+    return nullptr;
+}
+#endif
+
+void M5StackWiFiUploader::_handleListFiles() {
+    if (_checkNotModified(_listingETag())) {
+        return;
+    }
+
+    File dir;
+    uint32_t position;
+    uint32_t limit;
+    ListingQuery query;
+    if (!_openListing(dir, position, limit, query)) {
+        return;
+    }
+
+    // 一覧を溜め込まず、ディレクトリを読みながら固定長バッファ単位でチャンク転送する
+    char buffer[CHUNKED_RESPONSE_BUFFER_SIZE];
+    ChunkedResponseWriter out(*_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(buffer, sizeof(buffer), out.sink());
+    json.beginObject();
+    json.field("success", true);
+    json.key("files");
+    json.beginArray();
+    String nextCursor;
+    uint32_t count = _writeFileEntries(json, dir, position, limit, query, false, nextCursor);
+    json.endArray();
+    _writeCursor(json, nextCursor);
+    json.endObject();
+    json.flush();
+    out.end();
+
+    _log(4, "Listed %u files (%u bytes)", (unsigned int)count, (unsigned int)out.getBytesWritten());
+}
+
+void M5StackWiFiUploader::_handleDeleteFile() {
+    if (_webServer->method() != HTTP_DELETE && _webServer->method() != HTTP_POST) {
+        _sendJSONResponse(false, "Method not allowed");
+        return;
+    }
+
+    String filename;
     
-    String filename = _webServer->arg("filename");
-    String fullPath = _uploadPath + "/" + filename;
+    // DELETEメソッドの場合はクエリパラメータから取得
+    if (_webServer->method() == HTTP_DELETE) {
+        filename = _webServer->arg("filename");
+    } else {
+        // POSTメソッドの場合はJSONボディから取得（受信済みのボディをその場で読む）
+        String body = _webServer->arg("plain");
+
+        char value[JSON_REQUEST_MAX_STRING] = {0};
+        JsonReader reader(body.c_str(), body.length());
+        bool valid = reader.next() == JSON_TOKEN_BEGIN_OBJECT;
+        while (valid && reader.next() == JSON_TOKEN_KEY) {
+            if (!reader.span().equals("filename")) {
+                valid = reader.skip();
+            } else if (reader.next() != JSON_TOKEN_STRING) {
+                valid = false;
+            } else if (!reader.span().copyTo(value, sizeof(value))) {
+                _sendJSONResponse(false, "Invalid filename");
+                return;
+            }
+        }
+        if (!valid || reader.hasError()) {
+            _log(2, "Delete: invalid JSON body");
+            _sendJSONResponse(false, "Invalid JSON");
+            return;
+        }
+        filename = value;
+    }
+
+    if (filename.length() == 0) {
+        _sendJSONResponse(false, "No filename provided");
+        return;
+    }
+
+    // ファイル名を検証（サブディレクトリ内の相対パスは可）
+    String requested = filename;
+    if (!_resolvePath(requested.c_str(), filename)) {
+        _log(2, "Invalid filename: %s", requested.c_str());
+        _sendJSONResponse(false, "Invalid filename");
+        return;
+    }
+
+    // ディレクトリはバケットに分けないので、アップロードディレクトリからの相対パスのまま削除する
+    String dirPath = _uploadPath + "/" + filename;
+    if (deleteFile(filename.c_str())) {
+        _sendJSONResponse(true, "File deleted successfully", filename.c_str());
+    } else if (SD.rmdir(dirPath.c_str())) {
+        // 空になったサブディレクトリも同じAPIで削除できる
+        _markDirectoryChanged();
+#if ENABLE_CHANGE_FEED
+        _recordChange(CHANGE_DELETE, filename.c_str(), 0);
+#endif
+        _log(3, "Directory deleted: %s", filename.c_str());
+        _sendJSONResponse(true, "Directory deleted successfully", filename.c_str());
+    } else {
+        _sendJSONResponse(false, "Failed to delete file");
+    }
+}
+
+#if ENABLE_ADVANCED_ENDPOINTS
+void M5StackWiFiUploader::_handleBatch() {
+    // {"operations":[{"op":"delete","filename":"a.jpg"},{"op":"rename","from":"b.jpg","to":"c.jpg"},
+    //                {"op":"move","from":"d.jpg","to":"cam1"}]}
+    String body = _webServer->arg("plain");
+
+    // 1回目: 実行する前に全体の構文を検証し、操作数を数える（ボディはコピーせずその場で読む）
+    JsonReader reader(body.c_str(), body.length());
+    bool found = _findJsonArray(reader, "operations");
+    uint32_t total = 0;
+    JsonToken token = found ? reader.next() : JSON_TOKEN_NULL;
+    while (token == JSON_TOKEN_BEGIN_OBJECT && reader.skipContainer()) {
+        total++;
+        token = reader.next();
+    }
+    if (found && token != JSON_TOKEN_END_ARRAY) {
+        _sendJSONResponse(false, "Invalid JSON");
+        return;
+    }
+    while (token != JSON_TOKEN_END && token != JSON_TOKEN_ERROR) {
+        token = reader.next();
+    }
+    if (reader.hasError()) {
+        _sendJSONResponse(false, "Invalid JSON");
+        return;
+    }
+    if (total == 0) {
+        _sendJSONResponse(false, "No operations provided");
+        return;
+    }
+    if (total > MAX_BATCH_OPERATIONS) {
+        _sendJSONResponse(false, "Too many operations");
+        return;
+    }
+
+    // 各操作の結果を実行しながら書き出し、キャッシュ・サムネイル・一覧のETagは最後にまとめて更新する
+    char buffer[CHUNKED_RESPONSE_BUFFER_SIZE];
+    ChunkedResponseWriter out(*_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(buffer, sizeof(buffer), out.sink());
+    json.beginObject();
+    json.key("results");
+    json.beginArray();
+
+    unsigned long startTime = millis();
+    std::vector<String> changed;
+    uint32_t succeeded = 0;
+
+    // 2回目: 操作を1つずつ読みながら実行する
+    char op[16];
+    char from[JSON_REQUEST_MAX_STRING];
+    char to[JSON_REQUEST_MAX_STRING];
+    JsonReader operations(body.c_str(), body.length());
+    _findJsonArray(operations, "operations");
+    while (operations.next() == JSON_TOKEN_BEGIN_OBJECT) {
+        _readBatchOperation(operations, op, sizeof(op), from, to, sizeof(to));
+        bool remove = strcmp(op, "delete") == 0;
+
+        String source;
+        String target;
+        const char* message = _runBatchOperation(op, from, to, source, target, changed);
+        json.beginObject();
+        json.field("op", op);
+        if (remove) {
+            json.field("filename", source.length() > 0 ? source.c_str() : from);
+        } else {
+            json.field("from", source.length() > 0 ? source.c_str() : from);
+            json.field("to", target.length() > 0 ? target.c_str() : to);
+        }
+        json.field("success", message == nullptr);
+        if (message) json.field("message", message);
+        json.endObject();
+        if (!message) succeeded++;
+    }
+    json.endArray();
+
+    if (!changed.empty()) {
+        _markDirectoryChanged();
+#if ENABLE_FILE_CACHE
+        for (const auto& name : changed) {
+            _fileCache.invalidate(name);
+        }
+#endif
+#if ENABLE_THUMBNAILS
+        _invalidateThumbnails(changed);
+#endif
+    }
+
+    json.field("success", succeeded == total);
+    json.field("total", total);
+    json.field("succeeded", succeeded);
+    json.field("failed", total - succeeded);
+    json.endObject();
+    json.flush();
+    out.end();
+
+    _log(3, "Batch: %u of %u operations succeeded (%u ms)", (unsigned int)succeeded, (unsigned int)total,
+         (unsigned int)(millis() - startTime));
+}
+
+bool M5StackWiFiUploader::_findJsonArray(JsonReader& reader, const char* key) {
+    // 最上位のオブジェクトから key の配列を探し、その '[' の直後で止める
+    if (reader.next() != JSON_TOKEN_BEGIN_OBJECT) return false;
+    while (reader.next() == JSON_TOKEN_KEY) {
+        if (!reader.span().equals(key)) {
+            if (!reader.skip()) return false;
+            continue;
+        }
+        JsonToken token = reader.next();
+        if (token == JSON_TOKEN_BEGIN_ARRAY) return true;
+        if (token == JSON_TOKEN_BEGIN_OBJECT && !reader.skipContainer()) return false;
+    }
+    return false;
+}
+
+void M5StackWiFiUploader::_readBatchOperation(JsonReader& reader, char* op, size_t opSize,
+                                              char* from, char* to, size_t size) {
+    // {"op":..,"filename":..} / {"op":..,"from":..,"to":..}（文字列でない値・長すぎる値は空として扱う）
+    op[0] = '\0';
+    from[0] = '\0';
+    to[0] = '\0';
+    while (reader.next() == JSON_TOKEN_KEY) {
+        JsonSpan key = reader.span();
+        JsonToken token = reader.next();
+        if (token == JSON_TOKEN_BEGIN_OBJECT || token == JSON_TOKEN_BEGIN_ARRAY) {
+            reader.skipContainer();
+        } else if (token != JSON_TOKEN_STRING) {
+            continue;
+        } else if (key.equals("op")) {
+            reader.span().copyTo(op, opSize);
+        } else if (key.equals("filename") || key.equals("from")) {
+            reader.span().copyTo(from, size);
+        } else if (key.equals("to")) {
+            reader.span().copyTo(to, size);
+        }
+    }
+}
+
+const char* M5StackWiFiUploader::_runBatchOperation(const char* op, const char* from, const char* to,
+                                                    String& source, String& target,
+                                                    std::vector<String>& changed) {
+    bool remove = strcmp(op, "delete") == 0;
+    bool move = strcmp(op, "move") == 0;
+    if (!remove && !move && strcmp(op, "rename") != 0) {
+        return "Unknown operation (delete, rename or move)";
+    }
+    if (!_resolvePath(from, source)) {
+        source = "";
+        return "Invalid filename";
+    }
+
+    if (remove) {
+        String fullPath = _storagePath(source.c_str());
+        uint32_t size = 0, modified = 0;
+        bool counted = _statFile(source.c_str(), size, modified);
+        if (SD.remove(fullPath.c_str())) {
+            if (counted) _uncountFile(source.c_str(), size, modified);
+            _unindexFile(source.c_str());
+#if ENABLE_TAIL
+            _tailManager.notifyRemove(source);
+#endif
+        } else {
+            // 空になったサブディレクトリも削除できる（ディレクトリはバケットに分けない）
+            String dirPath = _uploadPath + "/" + source;
+            if (!SD.rmdir(dirPath.c_str())) return "Failed to delete file";
+        }
+#if ENABLE_CHANGE_FEED
+        _recordChange(CHANGE_DELETE, source.c_str(), 0);
+#endif
+        changed.push_back(source);
+        return nullptr;
+    }
+
+    // rename: 同じディレクトリ内で名前を変える / move: 名前を保ったまま別のディレクトリへ移す（"" で直下）
+    int slash = source.lastIndexOf('/');
+    String requested;
+    if (move) {
+        requested = String(to) + "/" + source.substring(slash + 1);
+    } else {
+        if (strchr(to, '/')) return "Invalid destination (use move to change directory)";
+        requested = source.substring(0, slash + 1) + to;
+    }
+    if (!_resolvePath(requested.c_str(), target)) {
+        target = "";
+        return "Invalid destination";
+    }
+    if (!_isValidExtension(target.c_str())) return "Invalid file extension";
+    if (target == source) return nullptr;
+
+    int targetSlash = target.lastIndexOf('/');
+    if (targetSlash > 0 && !_ensureSubdirectory(target.substring(0, targetSlash))) {
+        return "Failed to create directory";
+    }
+
+    // 同じボリューム内なのでコピーせずディレクトリエントリだけを書き換える（移動先に同名のファイルがあれば失敗）
+    String fromPath = _storagePath(source.c_str());
+    String toPath = _storagePath(target.c_str());
+    uint32_t size = 0, modified = 0;
+    bool counted = _statFile(source.c_str(), size, modified);
+    if (!SD.rename(fromPath.c_str(), toPath.c_str())) {
+        return "Failed to rename (missing source or destination exists)";
+    }
+
+    // インデックスはアップロードディレクトリ直下のファイルのみ
+    bool fromTop = slash < 0;
+    bool toTop = targetSlash < 0;
+    if (fromTop && toTop) {
+#if ENABLE_DIRECTORY_INDEX
+        _directoryIndex.rename(source.c_str(), target.c_str());
+#endif
+    } else if (fromTop) {
+        _unindexFile(source.c_str());
+    } else if (toTop) {
+        _indexFile(target.c_str());
+    }
+    // サブディレクトリから直下へ移したファイルは、移動先のサイズと更新時刻で数える
+    if (counted) _uncountFile(source.c_str(), size, modified);
+    if (toTop && (counted || _statFile(target.c_str(), size, modified))) {
+        _countFile(target.c_str(), size, modified);
+    }
+#if ENABLE_CHANGE_FEED
+    _recordChange(CHANGE_DELETE, source.c_str(), 0);
+    _recordChange(CHANGE_CREATE, target.c_str());
+#endif
+    changed.push_back(source);
+    changed.push_back(target);
+    return nullptr;
+}
+#endif
+
+void M5StackWiFiUploader::_handleStatus() {
+    char buffer[CHUNKED_RESPONSE_BUFFER_SIZE];
+    ChunkedResponseWriter out(*_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(buffer, sizeof(buffer), out.sink());
+    json.beginObject();
+    json.field("running", _isRunning);
+    json.field("activeUploads", getActiveUploads());
+    json.field("totalUploaded", _totalUploaded);
+    json.field("sdFreeSpace", getSDFreeSpace());
+    json.field("sdTotalSpace", getSDTotalSpace());
+    json.field("serverIP", getServerIP());
+    json.field("serverPort", _port);
+
+    const KeepAliveStats& keepAlive = _webServer->getKeepAliveStats();
+    json.key("keepAlive");
+    json.beginObject();
+    json.field("enabled", _webServer->isKeepAliveEnabled());
+    json.field("connections", keepAlive.connections);
+    json.field("requests", keepAlive.requests);
+    json.field("reusedRequests", keepAlive.reusedRequests);
+    json.endObject();
+#if ENABLE_ADVANCED_ENDPOINTS
+    // 直近ダウンロードの転送速度（streamFile() との比較用）
+    json.key("lastDownload");
+    json.beginObject();
+    json.field("filename", _lastDownloadStats.filename);
+    json.field("bytes", _lastDownloadStats.bytesSent);
+    json.field("elapsedMs", _lastDownloadStats.elapsedMs);
+    json.field("bytesPerSecond", (uint32_t)_lastDownloadStats.bytesPerSecond);
+    json.field("engine", _lastDownloadStats.usedEngine);
+    json.endObject();
+#endif
+#if ENABLE_FILE_CACHE
+    FileCacheStats cache = _fileCache.getStats();
+    json.key("fileCache");
+    json.beginObject();
+    json.field("hits", cache.hits);
+    json.field("misses", cache.misses);
+    json.field("evictions", cache.evictions);
+    json.field("invalidations", cache.invalidations);
+    json.field("entries", cache.entries);
+    json.field("usedBytes", cache.usedBytes);
+    json.field("capacity", cache.capacity);
+    json.field("psram", cache.usePSRAM);
+    json.endObject();
+#endif
+#if ENABLE_TAIL
+    json.field("tailFollowers", _tailManager.getFollowerCount());
+    json.field("maxTailFollowers", _tailManager.getMaxFollowers());
+#endif
+#if ENABLE_CHANGE_FEED
+    json.field("changeSequence", _changeFeed.getLatestSequence());
+    json.field("changeWaiters", _changeFeed.getWaiterCount());
+#endif
+#if ENABLE_DIRECTORY_INDEX
+    DirectoryIndexStats index = _directoryIndex.getStats();
+    json.key("directoryIndex");
+    json.beginObject();
+    json.field("valid", index.valid);
+    json.field("entries", index.entries);
+    json.field("maxEntries", index.maxEntries);
+    json.field("memoryBytes", index.memoryUsage);
+    json.field("bytesPerEntry", index.bytesPerEntry);
+    json.field("rebuilds", index.rebuilds);
+    json.field("externalChanges", index.externalChanges);
+    json.field("lastRebuildMs", index.lastRebuildMs);
+    json.field("persistent", index.persistent);
+    json.field("loadedFromFile", index.loadedFromFile);
+    json.field("lastLoadMs", index.lastLoadMs);
+    json.field("journalRecords", index.journalRecords);
+    json.field("compactions", index.compactions);
+    json.endObject();
+#endif
+#if ENABLE_DIRECTORY_STATS
+#if ENABLE_DIRECTORY_INDEX
+    // 範囲の端のファイルを削除した後は、インデックスの更新時刻順の両端から取り直す
+    if (!_directoryStats.hasExactBounds() && _directoryIndex.isValid() && _directoryIndex.getEntryCount() > 0) {
+        size_t last = _directoryIndex.getEntryCount() - 1;
+        _directoryStats.setBounds(_directoryIndex.getEntry(0, DIRECTORY_INDEX_ORDER_MODIFIED).modified,
+                                  _directoryIndex.getEntry(last, DIRECTORY_INDEX_ORDER_MODIFIED).modified);
+    }
+#endif
+    json.key("directoryStats");
+    _directoryStats.writeJson(json);
+#endif
+#if ENABLE_SHARDED_STORAGE
+    json.field("shardBuckets", _storageLayout.getBucketCount());
+#endif
+    json.endObject();
+    json.flush();
+    out.end();
+}
+
+#if ENABLE_ADVANCED_ENDPOINTS
+void M5StackWiFiUploader::_handleFileListDetailed() {
+    _log(3, "Handling detailed file list request");
+
+    if (_checkNotModified(_listingETag())) {
+        return;
+    }
+
+    ListingQuery query;
+    if (_parseListingQuery(query)) {
+        _sendFileList(query);
+    }
+}
+
+void M5StackWiFiUploader::_handleSearch() {
+    _log(3, "Handling search request");
+
+    if (_checkNotModified(_listingETag())) {
+        return;
+    }
+
+    ListingQuery query;
+    if (!_parseListingQuery(query)) {
+        return;
+    }
+    if (query.prefix.length() == 0 && query.glob.length() == 0) {
+        _sendJSONResponse(false, "prefix or glob is required");
+        return;
+    }
+    _sendFileList(query);
+}
+
+void M5StackWiFiUploader::_sendFileList(ListingQuery& query) {
+    File dir;
+    uint32_t position;
+    uint32_t limit;
+    if (!_openListing(dir, position, limit, query)) {
+        return;
+    }
+
+    // 開いているエントリからサイズ・更新時刻を取り、1件ずつ書き込む
+    char buffer[CHUNKED_RESPONSE_BUFFER_SIZE];
+    ChunkedResponseWriter out(*_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(buffer, sizeof(buffer), out.sink());
+    json.beginObject();
+    json.key("files");
+    json.beginArray();
+    String nextCursor;
+    uint32_t count = _writeFileEntries(json, dir, position, limit, query, true, nextCursor);
+    json.endArray();
+    json.field("total", count);
+    _writeCursor(json, nextCursor);
+    json.endObject();
+    json.flush();
+    out.end();
+}
+#endif
+
+#if ENABLE_ADVANCED_ENDPOINTS
+void M5StackWiFiUploader::_handleFileDownload() {
+    if (!_webServer->hasArg("filename")) {
+        _sendJSONResponse(false, "Missing filename parameter", nullptr);
+        return;
+    }
+    
+    String requested = _webServer->arg("filename");
+    _log(3, "Download request for: %s", requested.c_str());
+    
+    // パストラバーサル攻撃を防止（サブディレクトリ内の相対パスは可）
+    String filename;
+    if (!_resolvePath(requested.c_str(), filename)) {
+        _log(1, "Invalid filename (path traversal attempt): %s", requested.c_str());
+        _sendJSONResponse(false, "Invalid filename", requested.c_str());
+        return;
+    }
+    String fullPath = _storagePath(filename.c_str());
+    
+    String contentType = _getContentType(filename.c_str());
+    bool compressible = _isCompressibleType(contentType);
+    bool acceptsGzip = compressible && _clientAcceptsGzip();
+
+#if ENABLE_FILE_CACHE
+    // 小さなファイルはSDカードを開かずにRAMから配信（gzip受け入れ可否で表現が異なるためキーを分ける）
+    String cacheKey = acceptsGzip ? filename + "|gz" : filename;
+    const FileCacheEntry* cachedEntry = _fileCache.lookup(cacheKey);
+    if (cachedEntry) {
+        _sendCachedFile(*cachedEntry, contentType, compressible);
+        return;
+    }
+#endif
+
+    // インデックスにないファイルはSDカードを開かずに応答
+    if (_knownMissing(filename.c_str())) {
+        _log(1, "File not found: %s", fullPath.c_str());
+        _sendJSONResponse(false, "File not found", filename.c_str());
+        return;
+    }
+
+    // 事前圧縮された "name.gz" が隣にあればそちらを配信
+    File file;
+    bool precompressed = false;
+    if (acceptsGzip && !_knownMissing((filename + ".gz").c_str())) {
+        String gzPath = fullPath + ".gz";
+        file = SD.open(gzPath.c_str(), FILE_READ);
+        precompressed = file && !file.isDirectory();
+        if (file && !precompressed) file.close();
+
+        // 元のファイルが後から更新（再アップロード・追記）されていれば、古い圧縮版は配信しない
+        if (precompressed) {
+            File original = SD.open(fullPath.c_str(), FILE_READ);
+            if (original && !original.isDirectory() && original.getLastWrite() > file.getLastWrite()) {
+                _log(3, "Precompressed file is stale: %s.gz", filename.c_str());
+                file.close();
+                precompressed = false;
+            }
+            if (original) original.close();
+        }
+    }
+
+    // 存在確認を兼ねて一度だけ開き、サイズと更新時刻からETagを生成
+    if (!precompressed) {
+        file = SD.open(fullPath.c_str(), FILE_READ);
+        if (!file || file.isDirectory()) {
+            if (file) file.close();
+            _log(1, "File not found: %s", fullPath.c_str());
+            _sendJSONResponse(false, "File not found", filename.c_str());
+            return;
+        }
+    }
     
-    _log(3, "Download request for: %s", filename.c_str());
+    size_t fileSize = file.size();
+    time_t lastWrite = file.getLastWrite();
+    bool compressOnTheFly = acceptsGzip && !precompressed && _gzipOnTheFly && fileSize >= _gzipMinSize;
+
+    // 表現ごとに異なるETagを付与（非圧縮 / 事前圧縮 / オンザフライ圧縮）
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%x-%lx%s\"", (unsigned int)fileSize, (unsigned long)lastWrite,
+             precompressed ? "-gz" : (compressOnTheFly ? "-z" : ""));
+    if (compressible) {
+        _webServer->sendHeader("Vary", "Accept-Encoding");
+    }
+    if (_checkNotModified(etag, lastWrite)) {
+        file.close();
+        _log(3, "Not modified: %s", filename.c_str());
+        return;
+    }
     
+    _webServer->sendHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
+
+    DownloadStats& stats = _lastDownloadStats;
+    stats = DownloadStats();
+    stats.filename = filename;
+    bool streamed = false;
+    const char* mode = "streamFile";
+
+    if (compressOnTheFly) {
+        streamed = _streamGzip(file, contentType, stats);
+        if (streamed) mode = "gzip";
+    }
+
+#if ENABLE_FILE_CACHE
+    // キャッシュに読み込めた場合はそのままRAMから送信
+    if (!streamed && _fileCache.accepts(fileSize)) {
+        const FileCacheEntry* entry = _fileCache.insert(cacheKey, filename, file, fileSize, lastWrite, precompressed);
+        if (entry) {
+            if (precompressed) {
+                _webServer->sendHeader("Content-Encoding", "gzip");
+            }
+            unsigned long startTime = millis();
+            _webServer->setContentLength(entry->size);
+            _webServer->send(200, contentType, "");
+            _webServer->sendContent((const char*)entry->data, entry->size);
+            stats.bytesSent = entry->size;
+            stats.elapsedMs = millis() - startTime;
+            stats.bytesPerSecond = stats.elapsedMs > 0 ? (stats.bytesSent * 1000.0f) / stats.elapsedMs : 0.0f;
+            stats.completed = _webServer->client().connected();
+            streamed = true;
+            mode = "cache";
+        } else {
+            file.seek(0);
+        }
+    }
+#endif
+
+#if ENABLE_DOWNLOAD_ENGINE
+    // バッファを確保できた場合のみエンジンを使用（ヘッダー送信前に判定）
+    if (!streamed && _downloadEngineEnabled && _downloadStreamer.prepare()) {
+        if (precompressed) {
+            _webServer->sendHeader("Content-Encoding", "gzip");
+        }
+        _webServer->setContentLength(fileSize);
+        _webServer->send(200, contentType, "");
+        _downloadStreamer.stream(file, _webServer->client(), fileSize, stats);
+        streamed = true;
+        mode = "engine";
+    }
+#endif
+
+    if (!streamed) {
+        // streamFile() は ".gz" で終わるファイル名に Content-Encoding: gzip を自動付与する
+        unsigned long startTime = millis();
+        stats.bytesSent = _webServer->streamFile(file, contentType);
+        stats.elapsedMs = millis() - startTime;
+        stats.bytesPerSecond = stats.elapsedMs > 0 ? (stats.bytesSent * 1000.0f) / stats.elapsedMs : 0.0f;
+        stats.completed = (stats.bytesSent == fileSize);
+    }
+    
+    file.close();
+    if (!stats.completed) {
+        // Content-Length に満たない本文の後に次のレスポンスを送らないよう接続を閉じる
+        _webServer->closeAfterResponse();
+    }
+    _log(3, "File download %s: %s (%u/%u bytes, %u ms, %.1f KB/s, %s)",
+         stats.completed ? "completed" : "incomplete", filename.c_str(),
+         stats.bytesSent, (unsigned int)fileSize, stats.elapsedMs,
+         stats.bytesPerSecond / 1024.0f,
+         mode);
+}
+
+bool M5StackWiFiUploader::_streamGzip(File& file, const String& contentType, DownloadStats& stats) {
+    // 作業バッファを確保できない場合は非圧縮で送信する（ヘッダー送信前に判定）
+    GzipStream gzip;
+    bool started = gzip.begin([this](const uint8_t* data, size_t length) {
+        _webServer->sendContent((const char*)data, length);
+        return (bool)_webServer->client().connected();
+    });
+    uint8_t* readBuffer = started ? (uint8_t*)malloc(DEFAULT_BUFFER_SIZE) : nullptr;
+    if (!readBuffer) {
+        gzip.end();
+        return false;
+    }
+
+    // 圧縮後のサイズは事前に分からないためチャンク転送で送信
+    _webServer->sendHeader("Content-Encoding", "gzip");
+    _webServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    _webServer->send(200, contentType, "");
+
+    unsigned long startTime = millis();
+    size_t n;
+    bool ok = true;
+    while (ok && (n = file.read(readBuffer, DEFAULT_BUFFER_SIZE)) > 0) {
+        ok = gzip.write(readBuffer, n);
+    }
+    ok = ok && gzip.finish();
+    _webServer->sendContent("");
+
+    free(readBuffer);
+    gzip.end();
+
+    stats.bytesSent = gzip.getOutputSize();
+    stats.elapsedMs = millis() - startTime;
+    // 速度は他の方式と同じく実際に送信したバイト数（圧縮後）で求める
+    stats.bytesPerSecond = stats.elapsedMs > 0 ? (stats.bytesSent * 1000.0f) / stats.elapsedMs : 0.0f;
+    stats.completed = ok && gzip.getInputSize() == file.size();
+    _log(3, "Gzip: %u -> %u bytes", gzip.getInputSize(), gzip.getOutputSize());
+    return true;
+}
+
+#if ENABLE_FILE_CACHE
+void M5StackWiFiUploader::_sendCachedFile(const FileCacheEntry& entry, const String& contentType, bool compressible) {
+    // ETagはSDから配信する場合と同じ形式（キャッシュ時点のサイズ・更新時刻）
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%x-%lx%s\"", (unsigned int)entry.size, (unsigned long)entry.lastWrite,
+             entry.gzipEncoded ? "-gz" : "");
+    if (compressible) {
+        _webServer->sendHeader("Vary", "Accept-Encoding");
+    }
+    if (_checkNotModified(etag, entry.lastWrite)) {
+        _log(3, "Not modified (cache): %s", entry.name.c_str());
+        return;
+    }
+
+    _webServer->sendHeader("Content-Disposition", "attachment; filename=\"" + entry.name + "\"");
+    if (entry.gzipEncoded) {
+        _webServer->sendHeader("Content-Encoding", "gzip");
+    }
+
+    unsigned long startTime = millis();
+    _webServer->setContentLength(entry.size);
+    _webServer->send(200, contentType, "");
+    _webServer->sendContent((const char*)entry.data, entry.size);
+
+    DownloadStats& stats = _lastDownloadStats;
+    stats = DownloadStats();
+    stats.filename = entry.name;
+    stats.bytesSent = entry.size;
+    stats.elapsedMs = millis() - startTime;
+    stats.bytesPerSecond = stats.elapsedMs > 0 ? (stats.bytesSent * 1000.0f) / stats.elapsedMs : 0.0f;
+    stats.completed = _webServer->client().connected();
+    _log(3, "File download completed (cache): %s (%u bytes, %u ms)", entry.name.c_str(), entry.size, stats.elapsedMs);
+}
+#endif
+
+void M5StackWiFiUploader::_handleArchiveDownload() {
+    ArchiveFormat format = _webServer->arg("format") == "tar" ? ARCHIVE_TAR : ARCHIVE_ZIP;
+
+    // "files" は複数指定・カンマ区切り・改行区切り（POSTフォーム）・JSONのマニフェストのいずれも受け付ける
+    std::vector<String> names;
+    if (_webServer->method() == HTTP_POST && _webServer->hasArg("plain") &&
+        !_readArchiveManifest(_webServer->arg("plain"), names, format)) {
+        _sendJSONResponse(false, "Invalid JSON", nullptr);
+        return;
+    }
+    for (int i = 0; i < _webServer->args(); i++) {
+        if (_webServer->argName(i) != "files") continue;
+        String value = _webServer->arg(i);
+        value.replace("\r", "");
+        value.replace("\n", ",");
+        int start = 0;
+        while (start <= (int)value.length()) {
+            int sep = value.indexOf(',', start);
+            if (sep < 0) sep = value.length();
+            String name = value.substring(start, sep);
+            name.trim();
+            if (name.length() > 0) names.push_back(name);
+            start = sep + 1;
+        }
+    }
+    for (const auto& name : names) {
+        // パストラバーサル攻撃を防止
+        if (name.indexOf("..") >= 0 || name.indexOf("/") >= 0 || name.indexOf("\\") >= 0) {
+            _log(1, "Invalid filename (path traversal attempt): %s", name.c_str());
+            _sendJSONResponse(false, "Invalid filename", name.c_str());
+            return;
+        }
+    }
+
+    bool wholeDirectory = names.empty() && _webServer->hasArg("all");
+    if (names.empty() && !wholeDirectory) {
+        _sendJSONResponse(false, "Missing files parameter", nullptr);
+        return;
+    }
+    if (names.size() > MAX_ARCHIVE_ENTRIES) {
+        _sendJSONResponse(false, "Too many files", nullptr);
+        return;
+    }
+#if ENABLE_DIRECTORY_INDEX
+    // ディレクトリ全体はインデックスがあればヘッダー送信前にファイル数を確認する
+    // （インデックスがない場合は上限を超えた分を除いて終端まで出力する）
+    if (wholeDirectory && _directoryIndex.isValid() && _directoryIndex.getEntryCount() > MAX_ARCHIVE_ENTRIES) {
+        _sendJSONResponse(false, "Too many files", nullptr);
+        return;
+    }
+#endif
+
+    // 作業バッファを確保できることを確認してからヘッダーを送信
+    ArchiveStreamer archive;
+    bool started = archive.begin(format, [this](const uint8_t* data, size_t length) {
+        _webServer->sendContent((const char*)data, length);
+        return (bool)_webServer->client().connected();
+    });
+    if (!started) {
+        _sendJSONResponse(false, "Insufficient memory", nullptr);
+        return;
+    }
+
+    String dirName = _uploadPath.substring(_uploadPath.lastIndexOf('/') + 1);
+    if (dirName.length() == 0) dirName = "files";
+    String archiveName = dirName + "." + ArchiveStreamer::getExtension(format);
+
+    // 全体サイズは事前に分からないためチャンク転送で送信（一時ファイルは作らない）
+    _webServer->sendHeader("Content-Disposition", "attachment; filename=\"" + archiveName + "\"");
+    _webServer->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    _webServer->send(200, ArchiveStreamer::getContentType(format), "");
+
+    unsigned long startTime = millis();
+    uint16_t skipped = 0;
+    bool ok = true;
+
+    if (wholeDirectory) {
+        // ディレクトリ走査で得たハンドルをそのまま使い、ファイルごとの再オープンを省く
+        for (const auto& dirPath : _storageDirectories(_uploadPath.c_str())) {
+            if (!ok) break;
+            File dir = SD.open(dirPath.c_str());
+            if (dir && dir.isDirectory()) {
+                File file = dir.openNextFile();
+                while (file && ok) {
+                    if (!file.isDirectory()) {
+                        String name = file.name();
+                        name = name.substring(name.lastIndexOf('/') + 1);
+                        if (!archive.addFile(name, file)) {
+                            ok = archive.isOk();
+                            if (ok) {
+                                _log(2, "Archive: skipping file over limit: %s", name.c_str());
+                                skipped++;
+                            }
+                        }
+                    }
+                    file.close();
+                    file = dir.openNextFile();
+                }
+                if (file) file.close();
+            }
+            if (dir) dir.close();
+        }
+    } else {
+        for (size_t i = 0; i < names.size() && ok; i++) {
+            String fullPath = _storagePath(names[i].c_str());
+            File file = _knownMissing(names[i].c_str()) ? File() : SD.open(fullPath.c_str(), FILE_READ);
+            if (!file || file.isDirectory()) {
+                if (file) file.close();
+                _log(2, "Archive: skipping missing file: %s", names[i].c_str());
+                skipped++;
+                continue;
+            }
+            if (!archive.addFile(names[i], file)) {
+                ok = archive.isOk();
+                if (ok) {
+                    _log(2, "Archive: skipping file over limit: %s", names[i].c_str());
+                    skipped++;
+                }
+            }
+            file.close();
+        }
+    }
+
+    // 上限で除いたファイルがあっても、展開できるよう終端レコードは必ず出力する
+    ok = ok && archive.finish();
+    _webServer->sendContent("");
+
+    DownloadStats& stats = _lastDownloadStats;
+    stats = DownloadStats();
+    stats.filename = archiveName;
+    stats.bytesSent = archive.getOutputSize();
+    stats.elapsedMs = millis() - startTime;
+    stats.bytesPerSecond = stats.elapsedMs > 0 ? (stats.bytesSent * 1000.0f) / stats.elapsedMs : 0.0f;
+    stats.completed = ok;
+    archive.end();
+
+    _log(3, "Archive download %s: %s (%u files, %u skipped, %u bytes, %u ms, %.1f KB/s)",
+         ok ? "completed" : "incomplete", archiveName.c_str(), archive.getEntryCount(), skipped,
+         stats.bytesSent, stats.elapsedMs, stats.bytesPerSecond / 1024.0f);
+}
+
+bool M5StackWiFiUploader::_readArchiveManifest(const String& body, std::vector<String>& names,
+                                               ArchiveFormat& format) {
+    // {"files":["a.jpg","b.jpg"],"format":"tar"}（フォームなどJSONのオブジェクトでないボディは対象外）
+    char name[JSON_REQUEST_MAX_STRING];
+    JsonReader reader(body.c_str(), body.length());
+    if (reader.next() != JSON_TOKEN_BEGIN_OBJECT) return true;
+    while (reader.next() == JSON_TOKEN_KEY) {
+        if (reader.span().equals("files")) {
+            if (reader.next() != JSON_TOKEN_BEGIN_ARRAY) return false;
+            JsonToken token = reader.next();
+            while (token == JSON_TOKEN_STRING) {
+                // 上限を超えた分は保持しない（呼び出し側で Too many files にする）
+                if (names.size() <= MAX_ARCHIVE_ENTRIES) {
+                    if (!reader.span().copyTo(name, sizeof(name))) return false;
+                    if (name[0] != '\0') names.push_back(name);
+                }
+                token = reader.next();
+            }
+            if (token != JSON_TOKEN_END_ARRAY) return false;
+        } else if (reader.span().equals("format")) {
+            if (reader.next() != JSON_TOKEN_STRING) return false;
+            format = reader.span().equals("tar") ? ARCHIVE_TAR : ARCHIVE_ZIP;
+        } else if (!reader.skip()) {
+            return false;
+        }
+    }
+    return !reader.hasError() && reader.next() == JSON_TOKEN_END;
+}
+#endif
+
+#if ENABLE_THUMBNAILS
+void M5StackWiFiUploader::_handleThumbnail() {
+    if (!_webServer->hasArg("filename")) {
+        _sendJSONResponse(false, "Missing filename parameter", nullptr);
+        return;
+    }
+
+    String requested = _webServer->arg("filename");
+
+    // パストラバーサル攻撃を防止（サブディレクトリ内の相対パスは可）
+    String filename;
+    if (!_resolvePath(requested.c_str(), filename)) {
+        _log(1, "Invalid filename (path traversal attempt): %s", requested.c_str());
+        _sendJSONResponse(false, "Invalid filename", requested.c_str());
+        return;
+    }
+    if (_getContentType(filename.c_str()) != "image/jpeg") {
+        _sendJSONResponse(false, "Unsupported image type", filename.c_str());
+        return;
+    }
+
+    uint16_t size = DEFAULT_THUMBNAIL_SIZE;
+    if (_webServer->hasArg("size")) {
+        size = constrain(_webServer->arg("size").toInt(), MIN_THUMBNAIL_SIZE, MAX_THUMBNAIL_SIZE);
+    }
+
+    String fullPath = _storagePath(filename.c_str());
+    File source = SD.open(fullPath.c_str(), FILE_READ);
+    if (!source || source.isDirectory()) {
+        if (source) source.close();
+        _sendJSONResponse(false, "File not found", filename.c_str());
+        return;
+    }
+
+    // キャッシュ名: <ファイル名のCRC32>-<サイズ>-<更新時刻>-<ピクセル数>.jpg
+    time_t lastWrite = source.getLastWrite();
+    char cacheName[48];
+    snprintf(cacheName, sizeof(cacheName), "%s-%x-%lx-%u", _thumbnailKey(filename).c_str(),
+             (unsigned int)source.size(), (unsigned long)lastWrite, size);
+    if (_checkNotModified(String("\"t") + cacheName + "\"", lastWrite)) {
+        source.close();
+        return;
+    }
+
+    String cacheDir = _uploadPath + "/" THUMBNAIL_CACHE_DIR;
+    String cachePath = cacheDir + "/" + cacheName + ".jpg";
+    File cached = SD.open(cachePath.c_str(), FILE_READ);
+    if (cached && !cached.isDirectory() && cached.size() > 0) {
+        source.close();
+        _webServer->streamFile(cached, "image/jpeg");
+        cached.close();
+        _log(4, "Thumbnail cache hit: %s", filename.c_str());
+        return;
+    }
+    if (cached) cached.close();
+
+    // キャッシュミス: 一時ファイルへ生成してからリネーム（途中失敗で壊れたキャッシュを残さない）
+    if (!SD.exists(cacheDir.c_str()) && !SD.mkdir(cacheDir.c_str())) {
+        source.close();
+        _log(1, "Failed to create thumbnail directory: %s", cacheDir.c_str());
+        _sendJSONResponse(false, "Failed to create thumbnail", filename.c_str());
+        return;
+    }
+    String tempPath = cachePath + ".tmp";
+    File out = SD.open(tempPath.c_str(), FILE_WRITE);
+    if (!out) {
+        source.close();
+        _sendJSONResponse(false, "Failed to create thumbnail", filename.c_str());
+        return;
+    }
+
+    unsigned long startTime = millis();
+    ThumbnailGenerator generator;
+    bool ok = generator.generate(source, size, DEFAULT_THUMBNAIL_QUALITY, [&out](const uint8_t* data, size_t length) {
+        return out.write(data, length) == length;
+    });
+    source.close();
+    out.close();
+
+    if (!ok || !SD.rename(tempPath.c_str(), cachePath.c_str())) {
+        SD.remove(tempPath.c_str());
+        _log(2, "Thumbnail generation failed (progressive or corrupt JPEG?): %s", filename.c_str());
+        _sendJSONResponse(false, "Thumbnail generation failed", filename.c_str());
+        return;
+    }
+    _log(3, "Thumbnail generated: %s %ux%u -> %ux%u (1/%u, %lu ms)", filename.c_str(),
+         generator.getSourceWidth(), generator.getSourceHeight(),
+         generator.getWidth(), generator.getHeight(), 1 << generator.getScale(), millis() - startTime);
+
+    cached = SD.open(cachePath.c_str(), FILE_READ);
+    _webServer->streamFile(cached, "image/jpeg");
+    cached.close();
+}
+
+String M5StackWiFiUploader::_thumbnailKey(const String& filename) const {
+    char key[9];
+    snprintf(key, sizeof(key), "%08x", (unsigned int)esp_rom_crc32_le(0, (const uint8_t*)filename.c_str(), filename.length()));
+    return String(key);
+}
+
+void M5StackWiFiUploader::_invalidateThumbnails(const char* filename) {
+    _invalidateThumbnails(std::vector<String>{String(filename)});
+}
+
+void M5StackWiFiUploader::_invalidateThumbnails(const std::vector<String>& filenames) {
+    String cacheDir = _uploadPath + "/" THUMBNAIL_CACHE_DIR;
+    File dir = SD.open(cacheDir.c_str());
+    if (!dir || !dir.isDirectory()) {
+        if (dir) dir.close();
+        return;
+    }
+
+    // 同じ元ファイルのサムネイル（全サイズ・旧バージョン）を削除（複数のファイルでも走査は1回）
+    std::set<String> keys;
+    for (const auto& filename : filenames) {
+        keys.insert(_thumbnailKey(filename));
+    }
+    std::vector<String> stale;
+    File entry = dir.openNextFile();
+    while (entry) {
+        String name = entry.name();
+        name = name.substring(name.lastIndexOf('/') + 1);
+        int dash = name.indexOf('-');
+        if (dash > 0 && keys.count(name.substring(0, dash))) {
+            stale.push_back(cacheDir + "/" + name);
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    dir.close();
+
+    for (const auto& path : stale) {
+        SD.remove(path.c_str());
+    }
+    if (!stale.empty()) {
+        _log(4, "Thumbnails invalidated: %u source files (%u thumbnails)",
+             (unsigned int)filenames.size(), (unsigned int)stale.size());
+    }
+}
+#endif
+
+#if ENABLE_TAIL
+void M5StackWiFiUploader::_handleTail() {
+    if (!_webServer->hasArg("filename")) {
+        _sendJSONResponse(false, "Missing filename parameter", nullptr);
+        return;
+    }
+
+    String filename = _webServer->arg("filename");
+
     // パストラバーサル攻撃を防止
     if (filename.indexOf("..") >= 0 || filename.indexOf("/") >= 0 || filename.indexOf("\\") >= 0) {
         _log(1, "Invalid filename (path traversal attempt): %s", filename.c_str());
         _sendJSONResponse(false, "Invalid filename", filename.c_str());
         return;
     }
-    
-    if (!SDCardManager::fileExists(fullPath.c_str())) {
-        _log(1, "File not found: %s", fullPath.c_str());
-        _sendJSONResponse(false, "File not found", filename.c_str());
+
+    String follow = _webServer->arg("follow");
+    bool following = (follow == "1" || follow == "true");
+    // 追記はフォロワーへチャンクとして直接書き込むため、チャンク転送を解釈できない HTTP/1.0 では追跡しない
+    if (following && !_webServer->acceptsChunked()) {
+        _sendJSONResponse(false, "follow requires HTTP/1.1", filename.c_str());
+        return;
+    }
+    if (following && !_tailManager.canAccept()) {
+        _webServer->sendHeader("Retry-After", "5");
+        _webServer->send(HTTP_SERVICE_UNAVAILABLE, "application/json",
+                         "{\"success\":false,\"message\":\"Too many tail followers\"}");
+        return;
+    }
+
+    String fullPath = _storagePath(filename.c_str());
+    File file = SD.open(fullPath.c_str(), FILE_READ);
+    if (!file || file.isDirectory()) {
+        if (file) file.close();
+        _sendJSONResponse(false, "File not found", filename.c_str());
+        return;
+    }
+
+    // from: 開始位置（負の値は末尾からのバイト数、ファイルサイズで切り詰め）
+    // 受信中のファイルは書き込み側をflushしてから開き直し、次の追記通知の位置とサイズを揃える
+    if (_flushUploadInProgress(filename)) {
+        file.close();
+        file = SD.open(fullPath.c_str(), FILE_READ);
+        if (!file) {
+            _sendJSONResponse(false, "File not found", filename.c_str());
+            return;
+        }
+    }
+    uint32_t fileSize = file.size();
+    uint32_t start = 0;
+    if (_webServer->hasArg("from")) {
+        long from = _webServer->arg("from").toInt();
+        if (from < 0) {
+            start = ((uint32_t)(-from) < fileSize) ? fileSize + from : 0;
+        } else {
+            start = min((uint32_t)from, fileSize);
+        }
+    }
+    if (start > 0 && !file.seek(start)) {
+        file.close();
+        _sendJSONResponse(false, "Failed to seek file", filename.c_str());
+        return;
+    }
+
+    _webServer->sendHeader("Cache-Control", "no-cache");
+    _webServer->sendHeader("X-Tail-Offset", String(start));
+    _webServer->setContentLength(following ? CONTENT_LENGTH_UNKNOWN : fileSize - start);
+    _webServer->send(HTTP_OK, _getContentType(filename.c_str()), "");
+
+    // 既存部分を送信（follow時はチャンク転送）
+    uint8_t buffer[TAIL_READ_BUFFER_SIZE];
+    uint32_t offset = start;
+    while (offset < fileSize) {
+        size_t n = file.read(buffer, min((uint32_t)sizeof(buffer), fileSize - offset));
+        if (n == 0) break;
+        _webServer->sendContent((const char*)buffer, n);
+        offset += n;
+    }
+    file.close();
+
+    if (!following) {
+        _log(4, "Tail: %s (%u-%u)", filename.c_str(), (unsigned int)start, (unsigned int)offset);
+        return;
+    }
+
+    // 以降は書き込み側からの通知で送信するため、サーバーからクライアントを切り離す
+    _tailManager.add(_webServer->detachClient(), filename, offset);
+    _log(3, "Tail follower added: %s from %u (%u/%u)", filename.c_str(), (unsigned int)offset,
+         _tailManager.getFollowerCount(), _tailManager.getMaxFollowers());
+}
+
+bool M5StackWiFiUploader::_flushUploadInProgress(const String& filename) {
+    // 別のハンドルから見たサイズは書き込み側が直近にflushした位置までなので、受信途中のデータを確定させる
+    bool flushed = false;
+    if (_uploadFile && _uploadFilename == filename) {
+        _uploadFile.flush();
+        flushed = true;
+    }
+    for (auto& entry : _activeSessions) {
+        UploadSession& session = entry.second;
+        if (session.isActive && session.file && session.filename == filename) {
+            session.file.flush();
+            session.lastFlush = session.uploaded;
+            flushed = true;
+        }
+    }
+    return flushed;
+}
+#endif
+
+#if ENABLE_CHANGE_FEED
+void M5StackWiFiUploader::_handleChanges() {
+    // since を省略した場合は現在の連番から（一覧を取得した直後の呼び出しを想定）
+    uint32_t since = _webServer->hasArg("since") ? strtoul(_webServer->arg("since").c_str(), nullptr, 10)
+                                                 : _changeFeed.getLatestSequence();
+    long wait = _webServer->arg("wait").toInt();
+    if (wait > MAX_CHANGE_WAIT) wait = MAX_CHANGE_WAIT;
+
+    if (wait > 0 && !_changeFeed.hasUpdate(since)) {
+        if (!_changeFeed.canWait()) {
+            _webServer->sendHeader("Retry-After", "5");
+            _webServer->send(HTTP_SERVICE_UNAVAILABLE, "application/json",
+                             "{\"success\":false,\"message\":\"Too many change waiters\"}");
+            return;
+        }
+
+        // 変更またはタイムアウトで ChangeFeed が応答するため、サーバーからクライアントを切り離す
+        _changeFeed.addWaiter(_webServer->detachClient(), since, (uint32_t)wait * 1000);
+        _log(4, "Change waiter added from %u (%u/%u)", (unsigned int)since, _changeFeed.getWaiterCount(),
+             _changeFeed.getMaxWaiters());
+        return;
+    }
+
+    char buffer[CHANGE_FEED_BUFFER_SIZE];
+    _webServer->sendHeader("Cache-Control", "no-cache");
+    ChunkedResponseWriter out(*_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(buffer, sizeof(buffer), out.sink());
+    _changeFeed.writeChanges(json, since);
+    json.flush();
+    out.end();
+}
+#endif
+
+#if ENABLE_DIRECTORY_STATS
+void M5StackWiFiUploader::_handleStatsReconcile() {
+    // ディレクトリ全体を走査するので、ダッシュボードの定期取得には /api/status を使う
+    if (!reconcileDirectoryStats()) {
+        _sendJSONResponse(false, "Failed to scan upload directory");
+        return;
+    }
+
+    char buffer[CHUNKED_RESPONSE_BUFFER_SIZE];
+    ChunkedResponseWriter out(*_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(buffer, sizeof(buffer), out.sink());
+    _directoryStats.writeJson(json);
+    json.flush();
+    out.end();
+}
+#endif
+
+// ============================================================================
+// プライベートメソッド - 一覧のページング
+// ============================================================================
+
+bool M5StackWiFiUploader::_parseListingQuery(ListingQuery& query) {
+    String sort = _webServer->arg("sort");
+    if (sort.length() == 0 || sort == "name") {
+        query.sort = LISTING_SORT_NAME;
+    } else if (sort == "size") {
+        query.sort = LISTING_SORT_SIZE;
+    } else if (sort == "mtime") {
+        query.sort = LISTING_SORT_MODIFIED;
+    } else {
+        _sendJSONResponse(false, "Invalid sort (name, size or mtime)");
+        return false;
+    }
+
+    String order = _webServer->arg("order");
+    if (order.length() > 0 && order != "asc" && order != "desc") {
+        _sendJSONResponse(false, "Invalid order (asc or desc)");
+        return false;
+    }
+    query.descending = order == "desc";
+
+    // ext=csv,txt（先頭のドットは省略可）
+    String ext = _webServer->arg("ext");
+    int start = 0;
+    while (start < (int)ext.length()) {
+        int comma = ext.indexOf(',', start);
+        if (comma < 0) comma = ext.length();
+        String item = ext.substring(start, comma);
+        item.trim();
+        if (item.startsWith(".")) item = item.substring(1);
+        item.toLowerCase();
+        if (item.length() > 0) query.extensions.push_back(item);
+        start = comma + 1;
+    }
+
+    if (_webServer->hasArg("minSize")) query.minSize = strtoul(_webServer->arg("minSize").c_str(), nullptr, 10);
+    if (_webServer->hasArg("maxSize")) query.maxSize = strtoul(_webServer->arg("maxSize").c_str(), nullptr, 10);
+    if (_webServer->hasArg("since")) query.since = strtoul(_webServer->arg("since").c_str(), nullptr, 10);
+    query.prefix = _webServer->arg("prefix");
+    query.glob = _webServer->arg("glob");
+
+    // path= / depth= を指定した場合はサブディレクトリとその中を辿って一覧にする
+    if (_webServer->hasArg("path") || _webServer->hasArg("depth")) {
+        if (!_resolvePath(_webServer->arg("path").c_str(), query.path, true)) {
+            _sendJSONResponse(false, "Invalid path");
+            return false;
+        }
+        query.depth = constrain(_webServer->arg("depth").toInt(), 0, MAX_PATH_DEPTH);
+    }
+    return true;
+}
+
+bool M5StackWiFiUploader::_matchesListing(const ListingQuery& query, const char* name,
+                                          uint32_t size, uint32_t modified) const {
+    if (size < query.minSize || size > query.maxSize || modified < query.since) {
+        return false;
+    }
+    if (query.prefix.length() > 0 && strncasecmp(name, query.prefix.c_str(), query.prefix.length()) != 0) {
+        return false;
+    }
+    if (query.glob.length() > 0 && !SDCardManager::matchGlob(query.glob.c_str(), name)) {
+        return false;
+    }
+    if (query.extensions.empty()) {
+        return true;
+    }
+    const char* dot = strrchr(name, '.');
+    if (!dot || dot == name) {
+        return false;
+    }
+    for (const auto& ext : query.extensions) {
+        if (strcasecmp(dot + 1, ext.c_str()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool M5StackWiFiUploader::_openListing(File& dir, uint32_t& position, uint32_t& limit, ListingQuery& query) {
+    position = 0;
+    limit = MAX_FILE_LIST_SIZE;
+    if (_webServer->hasArg("limit")) {
+        limit = constrain(_webServer->arg("limit").toInt(), 1, MAX_FILE_LIST_SIZE);
+    }
+
+    // カーソル: "<読み進めたエントリ数>-<最後に返したファイル名のCRC32>"（いずれも16進）
+    unsigned int cursorPosition = 0;
+    unsigned int lastHash = 0;
+    String cursor = _webServer->arg("cursor");
+    if (cursor.length() > 0 &&
+        (sscanf(cursor.c_str(), "%x-%x", &cursorPosition, &lastHash) != 2 || cursorPosition == 0)) {
+        _sendJSONResponse(false, "Invalid cursor");
+        return false;
+    }
+
+    // サブディレクトリの一覧は _writeTreeEntries() が辿りながらカーソルの位置を探す
+    if (query.depth >= 0) {
+        position = cursorPosition;
+        query.cursorHash = lastHash;
+    }
+
+#if ENABLE_DIRECTORY_INDEX
+    if (_directoryIndex.isValid() && query.depth < 0) {
+        // 並び順の配列上でサイズ・更新時刻の条件を二分探索で範囲に絞る
+        DirectoryIndexOrder indexOrder = (DirectoryIndexOrder)query.sort;
+        size_t total = _directoryIndex.getEntryCount();
+        size_t first = 0;
+        size_t last = total;
+        if (query.sort == LISTING_SORT_SIZE) {
+            first = _directoryIndex.lowerBound(indexOrder, query.minSize);
+            if (query.maxSize < UINT32_MAX) last = _directoryIndex.lowerBound(indexOrder, query.maxSize + 1);
+        } else if (query.sort == LISTING_SORT_MODIFIED) {
+            first = _directoryIndex.lowerBound(indexOrder, query.since);
+        } else {
+            // 接頭辞（glob はワイルドカードより前の部分）に一致する名前は名前順で連続している
+            String prefix = query.glob.substring(0, strcspn(query.glob.c_str(), "*?"));
+            if (query.prefix.length() > prefix.length()) prefix = query.prefix;
+            if (prefix.length() > 0) {
+                size_t count;
+                first = _directoryIndex.prefixRange(prefix.c_str(), count);
+                last = first + count;
+            }
+        }
+        query.rangeFirst = first;
+        query.rangeCount = last > first ? last - first : 0;
+
+        // その範囲内の位置でページングし、SDカードは開かない
+        if (cursorPosition == 0) {
+            return true;
+        }
+        size_t count = query.rangeCount;
+        if (cursorPosition <= count && _nameHash(_listingEntry(query, cursorPosition - 1).name) == lastHash) {
+            position = cursorPosition;
+            return true;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (_nameHash(_listingEntry(query, i).name) == lastHash) {
+                position = i + 1;
+                return true;
+            }
+        }
+        // 最後に返したファイルが削除された（または並び順の値が変わった）場合は元の位置から続ける
+        position = min((size_t)cursorPosition - 1, count);
+        return true;
+    }
+#endif
+
+    // 並べ替えには全件を保持するインデックスが必要（SDカードの読み出し順のまま返すと誤解を招く）
+    if (query.sort != LISTING_SORT_NAME || query.descending) {
+        _sendJSONResponse(false, "Sorting requires the directory index (top-level listing only)");
+        return false;
+    }
+    if (query.depth >= 0) {
+        return true;
+    }
+#if ENABLE_SHARDED_STORAGE
+    // バケットに分けている場合は直下と各バケットを順に読む（_writeTreeEntries() がカーソルの位置を探す）
+    if (_storageLayout.isSharded()) {
+        position = cursorPosition;
+        query.cursorHash = lastHash;
+        return true;
+    }
+#endif
+
+    dir = SD.open(_uploadPath.c_str());
+    if (!dir || !dir.isDirectory()) {
+        if (dir) dir.close();
+        dir = File();
+        _log(2, "Failed to open directory: %s", _uploadPath.c_str());
+        return true;
+    }
+    if (cursorPosition == 0) {
+        return true;
+    }
+
+    // 前回最後に返したエントリへ移動し、名前が一致すればその続きから読む
+    position = cursorPosition;
+    if (dir.seekDir(position - 1)) {
+        File entry = dir.openNextFile();
+        bool matched = entry && _nameHash(entry.name()) == lastHash;
+        if (entry) entry.close();
+        if (matched) return true;
+    }
+
+    // ページの間に追加・削除があって位置がずれた場合は先頭から名前を探し直す
+    dir.rewindDirectory();
+    uint32_t index = 0;
+    File entry = dir.openNextFile();
+    while (entry) {
+        index++;
+        bool matched = _nameHash(entry.name()) == lastHash;
+        entry.close();
+        if (matched) {
+            position = index;
+            return true;
+        }
+        entry = dir.openNextFile();
+    }
+
+    // 最後のエントリが削除されていた場合は元の位置から続ける
+    dir.rewindDirectory();
+    dir.seekDir(position);
+    return true;
+}
+
+uint32_t M5StackWiFiUploader::_writeFileEntries(JsonWriter& json, File& dir, uint32_t position, uint32_t limit,
+                                                const ListingQuery& query, bool detailed, String& nextCursor) {
+    if (query.depth >= 0) {
+        return _writeTreeEntries(json, position, limit, query, detailed, nextCursor);
+    }
+#if ENABLE_DIRECTORY_INDEX
+    if (_directoryIndex.isValid()) {
+        uint32_t count = 0;
+        size_t lastPosition = 0;
+        for (size_t i = position; i < query.rangeCount && !json.hasError(); i++) {
+            const DirectoryIndexEntry& entry = _listingEntry(query, i);
+            if (!_matchesListing(query, entry.name, entry.size, entry.modified)) {
+                continue;
+            }
+
+            // 条件に合うエントリが残っていれば、最後に返したエントリを指すカーソルを返す
+            if (count >= limit) {
+                char cursor[20];
+                snprintf(cursor, sizeof(cursor), "%x-%08x", (unsigned int)lastPosition,
+                         (unsigned int)_nameHash(_listingEntry(query, lastPosition - 1).name));
+                nextCursor = cursor;
+                break;
+            }
+
+            if (detailed) {
+                json.beginObject();
+                json.field("name", entry.name);
+                json.field("size", entry.size);
+                json.field("modified", entry.modified);
+                json.field("isDirectory", false);
+                json.field("extension", SDCardManager::getFileExtension(entry.name));
+                json.endObject();
+            } else {
+                json.value(entry.name);
+            }
+            count++;
+            lastPosition = i + 1;
+        }
+        return count;
+    }
+#endif
+#if ENABLE_SHARDED_STORAGE
+    if (_storageLayout.isSharded()) {
+        return _writeTreeEntries(json, position, limit, query, detailed, nextCursor);
+    }
+#endif
+    if (!dir) return 0;
+
+    uint32_t count = 0;
+    uint32_t lastPosition = 0;
+    uint32_t lastHash = 0;
+    File entry = dir.openNextFile();
+    while (entry && !json.hasError()) {
+        position++;
+        if (!entry.isDirectory() &&
+            _matchesListing(query, entry.name(), entry.size(), query.since ? (uint32_t)entry.getLastWrite() : 0)) {
+            // 上限を超えるファイルが残っていれば、最後に返したエントリを指すカーソルを返す
+            if (count >= limit) {
+                char cursor[20];
+                snprintf(cursor, sizeof(cursor), "%x-%08x", (unsigned int)lastPosition, (unsigned int)lastHash);
+                nextCursor = cursor;
+                break;
+            }
+
+            if (detailed) {
+                json.beginObject();
+                json.field("name", entry.name());
+                json.field("size", (uint32_t)entry.size());
+                json.field("modified", (uint32_t)entry.getLastWrite());
+                json.field("isDirectory", false);
+                json.field("extension", SDCardManager::getFileExtension(entry.name()));
+                json.endObject();
+            } else {
+                json.value(entry.name());
+            }
+            count++;
+            lastPosition = position;
+            lastHash = _nameHash(entry.name());
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    if (entry) entry.close();
+    dir.close();
+    return count;
+}
+
+uint32_t M5StackWiFiUploader::_writeTreeEntries(JsonWriter& json, uint32_t position, uint32_t limit,
+                                                const ListingQuery& query, bool detailed, String& nextCursor) {
+    // 再帰せず、未訪問のディレクトリを明示的なスタックに積んで辿る（同時に開くディレクトリは1つだけ）
+    // depth < 0 は直下のファイルのみの一覧（バケットに分けている場合に使う）
+    struct PendingDirectory {
+        String relative;
+        String path;              // SDカード上のパス
+        uint8_t depth;
+        bool bucket;              // バケット（中のファイルは直下のファイルとして扱う）
+    };
+    std::vector<PendingDirectory> stack;
+    bool flat = query.depth < 0;
+    stack.push_back({query.path, query.path.length() > 0 ? _uploadPath + "/" + query.path : _uploadPath, 0, false});
+
+    uint32_t count = 0;
+    uint32_t visited = 0;
+    uint32_t lastPosition = 0;
+    uint32_t lastHash = 0;
+    bool resumed = position == 0;
+    while (!stack.empty() && nextCursor.length() == 0 && !json.hasError()) {
+        PendingDirectory current = stack.back();
+        stack.pop_back();
+
+        File dir = SD.open(current.path.c_str());
+        if (!dir || !dir.isDirectory()) {
+            if (dir) dir.close();
+            continue;
+        }
+
+        File entry = dir.openNextFile();
+        while (entry && !json.hasError()) {
+            const char* name = entry.name();
+            bool isDir = entry.isDirectory();
+            // 隠しディレクトリ（インデックス・サムネイルのキャッシュ・バケット）は含めない
+            if (name[0] == '.' || (isDir && (flat || current.bucket))) {
+                entry.close();
+                entry = dir.openNextFile();
+                continue;
+            }
+
+            String relative = current.relative.length() > 0 ? current.relative + "/" + name : String(name);
+            if (isDir && current.depth < query.depth) {
+                stack.push_back({relative, _uploadPath + "/" + relative, (uint8_t)(current.depth + 1), false});
+            }
+
+            uint32_t size = isDir ? 0 : (uint32_t)entry.size();
+            uint32_t modified = (uint32_t)entry.getLastWrite();
+            if (isDir || _matchesListing(query, name, size, modified)) {
+                visited++;
+                uint32_t hash = _nameHash(relative.c_str());
+                if (!resumed) {
+                    // 最後に返したエントリの次から再開（見つからなければ元の位置から続ける）
+                    if (hash == query.cursorHash) {
+                        resumed = true;
+                        lastPosition = visited;
+                    } else if (visited > position) {
+                        resumed = true;
+                    }
+                }
+                if (resumed && visited > lastPosition) {
+                    if (count >= limit) {
+                        char cursor[20];
+                        snprintf(cursor, sizeof(cursor), "%x-%08x", (unsigned int)lastPosition, (unsigned int)lastHash);
+                        nextCursor = cursor;
+                        break;
+                    }
+
+                    if (detailed) {
+                        json.beginObject();
+                        json.field("name", relative);
+                        json.field("size", size);
+                        json.field("modified", modified);
+                        json.field("isDirectory", isDir);
+                        json.field("extension", isDir ? String("") : SDCardManager::getFileExtension(name));
+                        json.endObject();
+                    } else {
+                        json.value(relative);
+                    }
+                    count++;
+                    lastPosition = visited;
+                    lastHash = hash;
+                }
+            }
+            entry.close();
+            entry = dir.openNextFile();
+        }
+        if (entry) entry.close();
+        dir.close();
+
+#if ENABLE_SHARDED_STORAGE
+        // 直下のファイルに続けて、各バケットのファイルを同じ階層のファイルとして並べる
+        if (!current.bucket && current.relative.length() == 0) {
+            for (uint16_t bucket = _storageLayout.getBucketCount(); bucket > 0; bucket--) {
+                stack.push_back({current.relative, _storageLayout.bucketPath(_uploadPath, bucket - 1),
+                                 current.depth, true});
+            }
+        }
+#endif
+    }
+    return count;
+}
+
+void M5StackWiFiUploader::_writeCursor(JsonWriter& json, const String& cursor) {
+    json.key("nextCursor");
+    if (cursor.length() == 0) {
+        json.valueNull();
+    } else {
+        json.value(cursor);
+    }
+}
+
+uint32_t M5StackWiFiUploader::_nameHash(const char* name) {
+    return esp_rom_crc32_le(0, (const uint8_t*)name, strlen(name));
+}
+
+// ============================================================================
+// プライベートメソッド - ディレクトリインデックス
+// ============================================================================
+
+void M5StackWiFiUploader::_rebuildDirectoryIndex(bool rescan) {
+#if ENABLE_DIRECTORY_INDEX
+    bool ready = rescan ? _directoryIndex.rebuild(_uploadPath.c_str())
+                        : _directoryIndex.open(_uploadPath.c_str());
+    if (ready) {
+        DirectoryIndexStats stats = _directoryIndex.getStats();
+        _log(3, "Directory index %s: %u entries, %u bytes (%u bytes/entry, %u ms)",
+             stats.loadedFromFile ? "loaded" : "built",
+             (unsigned int)stats.entries, (unsigned int)stats.memoryUsage, stats.bytesPerEntry,
+             (unsigned int)(stats.loadedFromFile ? stats.lastLoadMs : stats.lastRebuildMs));
+    } else if (_directoryIndex.getStats().maxEntries > 0) {
+        _log(2, "Directory index disabled (over %u entries or out of memory): %s",
+             (unsigned int)_directoryIndex.getStats().maxEntries, _uploadPath.c_str());
+    }
+#endif
+    _seedDirectoryStats();
+}
+
+void M5StackWiFiUploader::_indexFile(const char* filename) {
+#if ENABLE_DIRECTORY_INDEX
+    // 書き込み後のサイズと更新時刻はFATのディレクトリエントリから取り直す
+    if (!_directoryIndex.isValid() || strchr(filename, '/')) return;
+    String fullPath = _storagePath(filename);
+    File file = SD.open(fullPath.c_str(), FILE_READ);
+    if (file && !file.isDirectory()) {
+        _directoryIndex.update(filename, file.size(), (uint32_t)file.getLastWrite());
+    } else {
+        _directoryIndex.remove(filename);
+    }
+    if (file) file.close();
+#endif
+}
+
+void M5StackWiFiUploader::_indexFile(const char* filename, uint32_t size) {
+#if ENABLE_DIRECTORY_INDEX
+    // 追記・書き込み開始時はSDカードを開き直さず、サイズは書き込んだ量、更新時刻は現在時刻
+    // （FATの2秒単位に切り捨て）とする
+    if (strchr(filename, '/')) return;
+    _directoryIndex.update(filename, size, (uint32_t)time(nullptr) & ~1UL);
+#endif
+}
+
+void M5StackWiFiUploader::_unindexFile(const char* filename) {
+#if ENABLE_DIRECTORY_INDEX
+    _directoryIndex.remove(filename);
+#endif
+}
+
+// ============================================================================
+// プライベートメソッド - ディレクトリ統計
+// ============================================================================
+
+void M5StackWiFiUploader::_seedDirectoryStats() {
+#if ENABLE_DIRECTORY_STATS
+#if ENABLE_DIRECTORY_INDEX
+    // インデックスがあればRAM上のエントリから数え直す（SDカードは走査しない）
+    if (_directoryIndex.isValid()) {
+        _directoryStats.clear();
+        for (size_t i = 0; i < _directoryIndex.getEntryCount(); i++) {
+            const DirectoryIndexEntry& entry = _directoryIndex.getEntry(i);
+            _directoryStats.add(entry.name, entry.size, entry.modified);
+        }
         return;
     }
-    
+#endif
+    // 差分更新は続けるが、reconcileDirectoryStats() で数え直すまでは正確とみなさない
+    _directoryStats.invalidate();
+#endif
+}
+
+bool M5StackWiFiUploader::_statFile(const char* filename, uint32_t& size, uint32_t& modified) {
+#if ENABLE_DIRECTORY_STATS
+    if (strchr(filename, '/')) return false;
+#if ENABLE_DIRECTORY_INDEX
+    if (_directoryIndex.isValid()) {
+        const DirectoryIndexEntry* entry = _directoryIndex.find(filename);
+        if (!entry) return false;
+        size = entry->size;
+        modified = entry->modified;
+        return true;
+    }
+#endif
+    String fullPath = _storagePath(filename);
     File file = SD.open(fullPath.c_str(), FILE_READ);
-    if (!file) {
-        _log(1, "Failed to open file: %s", fullPath.c_str());
-        _sendJSONResponse(false, "Failed to open file", filename.c_str());
+    bool found = file && !file.isDirectory();
+    if (found) {
+        size = file.size();
+        modified = (uint32_t)file.getLastWrite();
+    }
+    if (file) file.close();
+    return found;
+#else
+    return false;
+#endif
+}
+
+void M5StackWiFiUploader::_countFile(const char* filename, uint32_t size, uint32_t modified) {
+#if ENABLE_DIRECTORY_STATS
+    if (strchr(filename, '/')) return;
+    // 更新時刻を省略した場合はインデックスと同じく現在時刻（FATの2秒単位に切り捨て）
+    _directoryStats.add(filename, size, modified ? modified : (uint32_t)time(nullptr) & ~1UL);
+#endif
+}
+
+void M5StackWiFiUploader::_uncountFile(const char* filename, uint32_t size, uint32_t modified) {
+#if ENABLE_DIRECTORY_STATS
+    if (strchr(filename, '/')) return;
+    _directoryStats.remove(filename, size, modified);
+#endif
+}
+
+void M5StackWiFiUploader::_recountFile(const char* filename, uint32_t oldSize, uint32_t newSize) {
+#if ENABLE_DIRECTORY_STATS
+    // 追記前のサイズが0の場合は新規作成と区別できないので、インデックスがあればそちらで判断する
+    // （インデックスを更新する前に呼び出す）
+    if (strchr(filename, '/')) return;
+    bool existed = oldSize > 0;
+    uint32_t oldModified = 0;
+#if ENABLE_DIRECTORY_INDEX
+    if (_directoryIndex.isValid()) {
+        const DirectoryIndexEntry* entry = _directoryIndex.find(filename);
+        existed = entry != nullptr;
+        if (entry) oldModified = entry->modified;
+    }
+#endif
+    uint32_t now = (uint32_t)time(nullptr) & ~1UL;
+    if (existed) {
+        _directoryStats.resize(filename, oldSize, newSize, oldModified, now);
+    } else {
+        _directoryStats.add(filename, newSize, now);
+    }
+#endif
+}
+
+#if ENABLE_CHANGE_FEED
+void M5StackWiFiUploader::_recordChange(ChangeType type, const char* filename, uint32_t size) {
+    _changeFeed.record(type, filename, size);
+}
+
+void M5StackWiFiUploader::_recordChange(ChangeType type, const char* filename) {
+    // リネーム・移動先のサイズはインデックスにあればそれを使い、なければディレクトリエントリから読む
+#if ENABLE_DIRECTORY_INDEX
+    const DirectoryIndexEntry* entry =
+        _directoryIndex.isValid() && !strchr(filename, '/') ? _directoryIndex.find(filename) : nullptr;
+    if (entry) {
+        _changeFeed.record(type, filename, entry->size);
         return;
     }
+#endif
+    uint32_t size = 0;
+    String fullPath = _storagePath(filename);
+    File file = SD.open(fullPath.c_str(), FILE_READ);
+    if (file) {
+        size = file.size();
+        file.close();
+    }
+    _changeFeed.record(type, filename, size);
+}
+#endif
+
+#if ENABLE_DIRECTORY_INDEX
+const DirectoryIndexEntry& M5StackWiFiUploader::_listingEntry(const ListingQuery& query, size_t position) const {
+    size_t rank = query.descending ? query.rangeFirst + query.rangeCount - 1 - position
+                                   : query.rangeFirst + position;
+    return _directoryIndex.getEntry(rank, (DirectoryIndexOrder)query.sort);
+}
+#endif
+
+bool M5StackWiFiUploader::_knownMissing(const char* filename) const {
+#if ENABLE_DIRECTORY_INDEX
+    // インデックスはアップロードディレクトリ直下のファイルのみ
+    return _directoryIndex.isValid() && !strchr(filename, '/') && !_directoryIndex.contains(filename);
+#else
+    return false;
+#endif
+}
+
+// ============================================================================
+// プライベートメソッド - アップロード（HTTPマルチパート・WebSocket共通）
+// ============================================================================
+
+const char* M5StackWiFiUploader::_openUpload(String& filename, const String& directory, File& file,
+                                             bool& replacing, uint8_t& errorCode) {
+    errorCode = ERR_INVALID_REQUEST;
+
+    // ファイル名を検証
+    if (!_isValidFilename(filename.c_str())) {
+        _log(2, "Invalid filename: %s", filename.c_str());
+        return "Invalid filename";
+    }
     
-    String contentType = _getContentType(filename.c_str());
-    size_t fileSize = file.size();
+    filename = _sanitizeFilename(filename.c_str());
+
+    // 指定したサブディレクトリに保存
+    if (directory.length() > 0) {
+        String relative;
+        if (!_resolvePath((directory + "/" + filename).c_str(), relative)) {
+            _log(2, "Invalid upload path: %s/%s", directory.c_str(), filename.c_str());
+            return "Invalid upload path";
+        }
+        filename = relative;
+    }
     
-    _webServer->sendHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
-    _webServer->streamFile(file, contentType);
+    // 拡張子を検証
+    if (!_isValidExtension(filename.c_str())) {
+        _log(2, "Invalid file extension: %s", filename.c_str());
+        errorCode = ERR_INVALID_EXTENSION;
+        return "Invalid file extension";
+    }
+
+    // 別の転送（WebSocketの他のチャンネル・クライアント）が書き込み中のファイルは開き直さない
+    for (const auto& entry : _activeSessions) {
+        if (entry.second.isActive && entry.second.filename == filename) {
+            _log(2, "File is being uploaded: %s", filename.c_str());
+            return "File is being uploaded";
+        }
+    }
     
+    // ファイルパスを作成
+    String fullPath = _storagePath(filename.c_str());
+    
+    // 上書き保護をチェック
+    if (_overwriteProtection && fileExists(filename.c_str())) {
+        _log(2, "File already exists (overwrite protection): %s", filename.c_str());
+        return "File already exists";
+    }
+    
+    // サブディレクトリが無ければ作成してからファイルを開く
+    int slash = filename.lastIndexOf('/');
+    if (slash > 0 && !_ensureSubdirectory(filename.substring(0, slash))) {
+        errorCode = ERR_SD_WRITE_FAILED;
+        return "Failed to create directory";
+    }
+    replacing = fileExists(filename.c_str());
+    uint32_t oldSize = 0, oldModified = 0;
+    bool counted = replacing && _statFile(filename.c_str(), oldSize, oldModified);
+    file = SD.open(fullPath.c_str(), FILE_WRITE);
+    if (!file) {
+        _log(1, "Failed to open file for writing: %s", fullPath.c_str());
+        errorCode = ERR_SD_WRITE_FAILED;
+        return "Failed to open file for writing";
+    }
+    _onFileChanged(filename.c_str());
+    // 上書きで元の内容は失われるので統計から除き、完了時に新しい内容として数える
+    if (counted) _uncountFile(filename.c_str(), oldSize, oldModified);
+    _indexFile(filename.c_str(), 0);
+#if ENABLE_THUMBNAILS
+    // 上書きされる場合に備えて古いサムネイルを破棄
+    _invalidateThumbnails(filename.c_str());
+#endif
+#if ENABLE_TAIL
+    // 上書き（FILE_WRITE で切り詰め）されたので追跡位置を先頭へ戻す
+    _tailManager.notifyTruncate(filename);
+#endif
+    return nullptr;
+}
+
+void M5StackWiFiUploader::_finishUpload(File& file, const String& filename, uint32_t size, bool replacing) {
     file.close();
-    _log(3, "File download completed: %s (%d bytes)", filename.c_str(), fileSize);
+    _totalUploaded += size;
+    _onFileChanged(filename.c_str());
+    _indexFile(filename.c_str());
+    _countFile(filename.c_str(), size);
+#if ENABLE_CHANGE_FEED
+    _recordChange(replacing ? CHANGE_MODIFY : CHANGE_CREATE, filename.c_str(), size);
+#endif
 }
+
+void M5StackWiFiUploader::_discardUpload(File& file, const String& filename, bool replacing) {
+    file.close();
+    String fullPath = _storagePath(filename.c_str());
+    SD.remove(fullPath.c_str());
+    _onFileChanged(filename.c_str());
+    _unindexFile(filename.c_str());
+#if ENABLE_CHANGE_FEED
+    // 新規のファイルは記録していないので、上書きで失われた場合だけ削除として記録する
+    if (replacing) _recordChange(CHANGE_DELETE, filename.c_str(), 0);
 #endif
+}
 
 // ============================================================================
 // プライベートメソッド - ファイル操作
 // ============================================================================
 
 bool M5StackWiFiUploader::_saveFile(const char* filename, uint8_t* data, uint32_t size) {
-    String fullPath = _uploadPath + "/" + filename;
+    String fullPath = _storagePath(filename);
+#if ENABLE_CHANGE_FEED
+    ChangeType change = fileExists(filename) ? CHANGE_MODIFY : CHANGE_CREATE;
+#endif
+    uint32_t oldSize = 0, oldModified = 0;
+    bool counted = _statFile(filename, oldSize, oldModified);
 
     File file = SD.open(fullPath.c_str(), FILE_WRITE);
     if (!file) {
         _log(1, "Failed to open file for writing: %s", fullPath.c_str());
         return false;
     }
+    if (counted) _uncountFile(filename, oldSize, oldModified);
+
+#if ENABLE_TAIL
+    _tailManager.notifyTruncate(filename);
+#endif
 
     uint32_t written = 0;
     uint32_t chunkSize = 4096;
@@ -969,8 +3460,16 @@ bool M5StackWiFiUploader::_saveFile(const char* filename, uint8_t* data, uint32_
         if (result != toWrite) {
             _log(1, "Failed to write data to file: %s", filename);
             file.close();
+            _indexFile(filename);
+            _countFile(filename, written + result);
+#if ENABLE_CHANGE_FEED
+            _recordChange(change, filename, written + result);
+#endif
             return false;
         }
+#if ENABLE_TAIL
+        _tailManager.notifyAppend(filename, written, data + written, toWrite);
+#endif
 
         written += toWrite;
 
@@ -981,6 +3480,12 @@ bool M5StackWiFiUploader::_saveFile(const char* filename, uint8_t* data, uint32_
     }
 
     file.close();
+    _onFileChanged(filename);
+    _indexFile(filename);
+    _countFile(filename, size);
+#if ENABLE_CHANGE_FEED
+    _recordChange(change, filename, size);
+#endif
     _log(3, "File saved successfully: %s (%d bytes)", fullPath.c_str(), size);
     return true;
 }
@@ -1036,6 +3541,48 @@ String M5StackWiFiUploader::_sanitizeFilename(const char* filename) {
     return result;
 }
 
+bool M5StackWiFiUploader::_resolvePath(const char* path, String& relative, bool allowRoot) {
+    relative = "";
+    if (!path || strchr(path, '\\')) {
+        return false;
+    }
+
+    // 重複・末尾のスラッシュと "/../" を正規化してから1階層ずつ検証し、
+    // アップロードディレクトリの外・隠しディレクトリ（".", ".." を含む）を指すパスは拒否する
+    String normalized = SDCardManager::normalizePath((String("/") + path).c_str());
+    uint8_t depth = 0;
+    int start = 1;
+    while (start < (int)normalized.length()) {
+        int slash = normalized.indexOf('/', start);
+        if (slash < 0) slash = normalized.length();
+        String segment = normalized.substring(start, slash);
+        if (segment.length() == 0 || segment.length() > MAX_FILENAME_LENGTH || segment.startsWith(".") ||
+            !_isValidFilename(segment.c_str()) || ++depth > MAX_PATH_DEPTH) {
+            return false;
+        }
+        start = slash + 1;
+    }
+
+    relative = normalized.substring(1);
+    return allowRoot || relative.length() > 0;
+}
+
+bool M5StackWiFiUploader::_ensureSubdirectory(const String& relative) {
+    // SD.mkdir() は親ディレクトリを作らないため、上の階層から順に作成する
+    int start = 0;
+    while (start < (int)relative.length()) {
+        int slash = relative.indexOf('/', start);
+        if (slash < 0) slash = relative.length();
+        String dirPath = _uploadPath + "/" + relative.substring(0, slash);
+        if (!SD.exists(dirPath.c_str()) && !SD.mkdir(dirPath.c_str())) {
+            _log(1, "Failed to create directory: %s", dirPath.c_str());
+            return false;
+        }
+        start = slash + 1;
+    }
+    return true;
+}
+
 bool M5StackWiFiUploader::_ensureUploadDirectory() {
     if (!SD.exists(_uploadPath.c_str())) {
         if (!SD.mkdir(_uploadPath.c_str())) {
@@ -1047,6 +3594,28 @@ bool M5StackWiFiUploader::_ensureUploadDirectory() {
     return true;
 }
 
+String M5StackWiFiUploader::_storagePath(const char* filename) const {
+#if ENABLE_SHARDED_STORAGE
+    return _storageLayout.filePath(_uploadPath, filename);
+#else
+    return _uploadPath + "/" + filename;
+#endif
+}
+
+std::vector<String> M5StackWiFiUploader::_storageDirectories(const char* path) const {
+    // アップロードディレクトリ直下のファイルは、直下と各バケットに分かれて保存されている
+    std::vector<String> dirs;
+    dirs.push_back(path);
+#if ENABLE_SHARDED_STORAGE
+    if (_uploadPath == path) {
+        for (uint16_t bucket = 0; bucket < _storageLayout.getBucketCount(); bucket++) {
+            dirs.push_back(_storageLayout.bucketPath(_uploadPath, bucket));
+        }
+    }
+#endif
+    return dirs;
+}
+
 // ============================================================================
 // プライベートメソッド - ユーティリティ
 // ============================================================================
@@ -1077,17 +3646,48 @@ void M5StackWiFiUploader::_log(uint8_t level, const char* format, ...) {
 }
 
 void M5StackWiFiUploader::_sendJSONResponse(bool success, const char* message, const char* filename) {
-    String json = "{";
-    json += "\"success\": " + String(success ? "true" : "false") + ", ";
-    json += "\"message\": \"" + String(message) + "\"";
-    
+    int code = success ? 200 : 400;
+    char buffer[JSON_MESSAGE_BUFFER_SIZE];
+    ChunkedResponseWriter out(*_webServer);
+    JsonWriter json(buffer, sizeof(buffer), [&](const char* data, size_t length) {
+        // バッファに収まらない（長いファイル名など）場合のみチャンク転送に切り替える
+        out.begin(code, "application/json");
+        return out.write(data, length);
+    });
+    json.beginObject();
+    json.field("success", success);
+    json.field("message", message);
     if (filename) {
-        json += ", \"filename\": \"" + String(filename) + "\"";
+        json.field("filename", filename);
     }
-    
-    json += "}";
+    json.endObject();
 
-    _webServer->send(success ? 200 : 400, "application/json", json);
+    if (json.getBytesWritten() <= sizeof(buffer)) {
+        _webServer->send_P(code, "application/json", buffer, json.getBytesWritten());
+        return;
+    }
+    json.flush();
+    out.end();
+}
+
+bool M5StackWiFiUploader::_isCompressibleType(const String& contentType) {
+    return contentType.startsWith("text/") || contentType == "application/json";
+}
+
+bool M5StackWiFiUploader::_clientAcceptsGzip() {
+    if (!_webServer->hasHeader("Accept-Encoding")) return false;
+    String acceptEncoding = _webServer->header("Accept-Encoding");
+    acceptEncoding.toLowerCase();
+    int pos = acceptEncoding.indexOf("gzip");
+    if (pos < 0) return false;
+
+    // "gzip;q=0" は明示的な拒否
+    int comma = acceptEncoding.indexOf(',', pos);
+    int q = acceptEncoding.indexOf("q=", pos);
+    if (q >= 0 && (comma < 0 || q < comma)) {
+        return acceptEncoding.substring(q + 2).toFloat() > 0.0f;
+    }
+    return true;
 }
 
 String M5StackWiFiUploader::_getContentType(const char* filename) {
@@ -1108,6 +3708,113 @@ String M5StackWiFiUploader::_getContentType(const char* filename) {
     return "application/octet-stream";
 }
 
+// ============================================================================
+// プライベートメソッド - 条件付きGET
+// ============================================================================
+
+bool M5StackWiFiUploader::_checkNotModified(const String& etag, time_t lastModified) {
+    // 検証子は200/304どちらの応答にも付与する
+    _webServer->sendHeader("ETag", etag);
+    _webServer->sendHeader("Cache-Control", "no-cache");
+
+    String lastModifiedStr;
+    if (lastModified > 0) {
+        lastModifiedStr = _formatHTTPDate(lastModified);
+        _webServer->sendHeader("Last-Modified", lastModifiedStr);
+    }
+
+    // If-None-Match が存在する場合は If-Modified-Since より優先（RFC 7232）
+    bool notModified = false;
+    if (_webServer->hasHeader("If-None-Match")) {
+        notModified = _etagMatches(_webServer->header("If-None-Match"), etag);
+    } else if (lastModified > 0 && _webServer->hasHeader("If-Modified-Since")) {
+        time_t since = _parseHTTPDate(_webServer->header("If-Modified-Since"));
+        notModified = since > 0 && lastModified <= since;
+    }
+
+    if (notModified) {
+        _webServer->send(HTTP_NOT_MODIFIED);
+    }
+    return notModified;
+}
+
+String M5StackWiFiUploader::_listingETag() const {
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"L%08x-%x\"", (unsigned int)_bootId, (unsigned int)_dirGeneration);
+    return String(etag);
+}
+
+void M5StackWiFiUploader::_markDirectoryChanged() {
+    _dirGeneration++;
+}
+
+void M5StackWiFiUploader::_onFileChanged(const char* filename) {
+    // 一覧のETagを更新し、キャッシュ済みの内容を書き込みと同時に破棄（write-through）
+    _markDirectoryChanged();
+#if ENABLE_FILE_CACHE
+    _fileCache.invalidate(filename);
+#endif
+}
+
+bool M5StackWiFiUploader::_etagMatches(const String& ifNoneMatch, const String& etag) {
+    // 弱い比較: "W/" プレフィックスを無視し、カンマ区切りのいずれかと一致すればtrue
+    String target = etag.startsWith("W/") ? etag.substring(2) : etag;
+    int start = 0;
+    while (start < (int)ifNoneMatch.length()) {
+        int comma = ifNoneMatch.indexOf(',', start);
+        if (comma < 0) comma = ifNoneMatch.length();
+
+        String candidate = ifNoneMatch.substring(start, comma);
+        candidate.trim();
+        if (candidate == "*") return true;
+        if (candidate.startsWith("W/")) candidate = candidate.substring(2);
+        if (candidate == target) return true;
+
+        start = comma + 1;
+    }
+    return false;
+}
+
+String M5StackWiFiUploader::_formatHTTPDate(time_t t) {
+    struct tm tmUtc;
+    gmtime_r(&t, &tmUtc);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tmUtc);
+    return String(buf);
+}
+
+time_t M5StackWiFiUploader::_parseHTTPDate(const String& date) {
+    // IMF-fixdate形式（例: "Sun, 06 Nov 1994 08:49:37 GMT"）のみ対応
+    static const char* const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                         "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    char mon[4] = {0};
+    int day, year, hour, minute, second;
+    if (sscanf(date.c_str(), "%*3s, %d %3s %d %d:%d:%d", &day, mon, &year, &hour, &minute, &second) != 6) {
+        return 0;
+    }
+    // 月名は3文字の完全一致のみ（一致しない日付は無視し、別の月として解釈しない）
+    int month = 0;
+    for (int i = 0; i < 12 && strlen(mon) == 3; i++) {
+        if (strncmp(mon, months[i], 3) == 0) {
+            month = i + 1;
+            break;
+        }
+    }
+    if (month == 0) {
+        return 0;
+    }
+
+    // 暦日からUNIX時刻を計算（タイムゾーン設定に依存しない）
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = (long)era * 146097 + (long)doe - 719468;
+
+    return (time_t)(days * 86400L + hour * 3600L + minute * 60L + second);
+}
+
 // ============================================================================
 // セッション管理（将来の拡張用）
 // ============================================================================
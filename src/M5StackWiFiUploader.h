@@ -4,13 +4,42 @@
 #include <Arduino.h>
 #include <WebServer.h>
 #include "Config.h"
+#include "UploaderWebServer.h"
 #include "ErrorHandler.h"
 #include "RetryManager.h"
 #include "ProgressTracker.h"
 #if ENABLE_WEBSOCKET
 #include "WebSocketHandler.h"
+#include "CreditWindow.h"
 #endif
 #include "SDCardManager.h"
+#include "DownloadStreamer.h"
+#include "GzipStream.h"
+#include "ArchiveStreamer.h"
+#include "ChunkedResponseWriter.h"
+#include "JsonWriter.h"
+#include "JsonReader.h"
+#if ENABLE_FILE_CACHE
+#include "FileCache.h"
+#endif
+#if ENABLE_THUMBNAILS
+#include "ThumbnailGenerator.h"
+#endif
+#if ENABLE_TAIL
+#include "TailManager.h"
+#endif
+#if ENABLE_CHANGE_FEED
+#include "ChangeFeed.h"
+#endif
+#if ENABLE_DIRECTORY_INDEX
+#include "DirectoryIndex.h"
+#endif
+#if ENABLE_DIRECTORY_STATS
+#include "DirectoryStats.h"
+#endif
+#if ENABLE_SHARDED_STORAGE
+#include "ShardedLayout.h"
+#endif
 #include <FS.h>
 #include <SD.h>
 #include <functional>
@@ -39,6 +68,45 @@ struct UploadSession {
     File file;
     bool isActive;
     uint8_t sessionId;
+    uint8_t clientId;             // WebSocketのクライアントID
+    uint8_t channel;              // WebSocketのチャンネル番号（1つの接続で複数のファイルを同時に送る場合）
+    uint16_t nextSequence;        // 次に受信するバイナリフレームのシーケンス番号
+    bool replacing;               // 既存のファイルを上書きしているか
+    uint32_t lastProgress;        // 直近に進捗を通知したバイト数
+    uint32_t lastFlush;           // 直近にflushしたバイト数
+    unsigned long lastActivity;   // 直近にデータを受信した時刻（無通信のタイムアウト判定）
+#if ENABLE_WEBSOCKET
+    CreditWindow credit;          // WebSocketのフロー制御
+#endif
+};
+
+// ============================================================================
+// 一覧の並び順・絞り込み条件（?sort=&order=&ext=&minSize=&maxSize=&since=&prefix=&glob=&path=&depth=）
+// ============================================================================
+enum ListingSort : uint8_t {
+    LISTING_SORT_NAME = 0,        // DirectoryIndexOrder と同じ値
+    LISTING_SORT_SIZE = 1,
+    LISTING_SORT_MODIFIED = 2
+};
+
+struct ListingQuery {
+    ListingSort sort;
+    bool descending;
+    std::vector<String> extensions;   // 小文字・ドットなし（空で全て）
+    uint32_t minSize;
+    uint32_t maxSize;
+    uint32_t since;                   // この時刻以降に更新されたもの（UNIXタイムスタンプ、0で全て）
+    String prefix;                    // ファイル名の接頭辞（大文字小文字を区別しない）
+    String glob;                      // ファイル名のワイルドカード（* と ?）
+    String path;                      // 一覧を取るサブディレクトリ（アップロードディレクトリからの相対パス）
+    int8_t depth;                     // サブディレクトリを辿る深さ（-1で従来どおり直下のファイルのみ）
+    size_t rangeFirst;                // インデックス上の対象範囲（並び順での位置）
+    size_t rangeCount;
+    uint32_t cursorHash;              // カーソルが指す最後に返したエントリ（サブディレクトリの一覧用）
+
+    ListingQuery()
+        : sort(LISTING_SORT_NAME), descending(false), minSize(0), maxSize(UINT32_MAX), since(0),
+          depth(-1), rangeFirst(0), rangeCount(0), cursorHash(0) {}
 };
 
 // ============================================================================
@@ -118,6 +186,147 @@ public:
      */
     void setOverwriteProtection(bool enable = true);
 
+    /**
+     * @brief HTTP keep-alive（持続的接続）を設定
+     * @param enable true=1接続で複数のリクエストを処理
+     * @param maxRequests 1接続で処理する最大リクエスト数
+     * @param idleTimeoutMs 次のリクエストを待つ最大時間（ミリ秒）
+     * @note 待機中の新しい接続がある場合、アイドル中の接続はタイムアウトを待たずに閉じます
+     */
+    void setKeepAlive(bool enable = true, uint16_t maxRequests = DEFAULT_KEEP_ALIVE_MAX_REQUESTS,
+                      uint32_t idleTimeoutMs = DEFAULT_KEEP_ALIVE_TIMEOUT);
+
+#if ENABLE_ADVANCED_ENDPOINTS
+    /**
+     * @brief テキスト系ファイルのオンザフライgzip圧縮を有効化
+     * @param enable true=Accept-Encoding: gzip のクライアントへ圧縮して送信
+     * @param minSize 圧縮対象とする最小ファイルサイズ（バイト）
+     * @note 事前圧縮された "name.gz" がある場合はこの設定に関係なくそちらを配信
+     */
+    void setOnTheFlyCompression(bool enable = true, uint32_t minSize = DEFAULT_GZIP_MIN_SIZE);
+#endif
+
+#if ENABLE_DOWNLOAD_ENGINE
+    /**
+     * @brief ダブルバッファ先読みダウンロードエンジンを有効化
+     * @param enable true=DownloadStreamer, false=WebServer::streamFile()
+     */
+    void enableDownloadEngine(bool enable = true);
+
+    /**
+     * @brief ダウンロードエンジンのバッファ構成を設定
+     * @param bufferSize 1バッファのサイズ（バイト、デフォルト16KB）
+     * @param bufferCount バッファ数（2〜4）
+     */
+    void setDownloadBuffers(size_t bufferSize, uint8_t bufferCount = DEFAULT_DOWNLOAD_BUFFER_COUNT);
+#endif
+
+#if ENABLE_FILE_CACHE
+    /**
+     * @brief 小さなファイルのRAMキャッシュを設定
+     * @param capacity 全体の上限バイト数（0で無効、既定はPSRAMあり512KB / なし32KB）
+     * @param maxEntrySize キャッシュ対象とする最大ファイルサイズ（バイト）
+     */
+    void setFileCache(size_t capacity, size_t maxEntrySize = DEFAULT_FILE_CACHE_MAX_ENTRY_SIZE);
+
+    /**
+     * @brief RAMキャッシュを破棄（ライブラリ外でSDカードを書き換えた場合に呼び出す）
+     */
+    void clearFileCache();
+
+    /**
+     * @brief RAMキャッシュの統計情報を取得
+     */
+    FileCacheStats getFileCacheStats() const { return _fileCache.getStats(); }
+#endif
+
+#if ENABLE_TAIL
+    /**
+     * @brief ライブtail（/api/tail?follow=1）の上限を設定
+     * @param maxFollowers 同時に追跡できるクライアント数（超過時は503）
+     * @param idleTimeoutMs 追記がない状態でレスポンスを閉じるまでの時間（ミリ秒）
+     */
+    void setTailLimits(uint8_t maxFollowers, uint32_t idleTimeoutMs = DEFAULT_TAIL_IDLE_TIMEOUT);
+
+    /**
+     * @brief ライブtailで追跡中のクライアント数を取得
+     */
+    uint8_t getTailFollowerCount() const { return _tailManager.getFollowerCount(); }
+#endif
+
+#if ENABLE_CHANGE_FEED
+    /**
+     * @brief 変更フィード（/api/changes）の上限を設定
+     * @param capacity 保持する変更の件数（押し出された連番を指定したクライアントには一覧の取り直しを求める）
+     * @param maxWaiters 変更を待って同時に接続を保持できるクライアント数（超過時は503）
+     */
+    void setChangeFeedLimits(uint16_t capacity, uint8_t maxWaiters = DEFAULT_MAX_CHANGE_WAITERS);
+
+    /**
+     * @brief 最後に記録した変更の連番を取得
+     */
+    uint32_t getChangeSequence() const { return _changeFeed.getLatestSequence(); }
+#endif
+
+#if ENABLE_DIRECTORY_INDEX
+    /**
+     * @brief アップロードディレクトリのインデックス（一覧・存在確認をRAMで処理）を設定
+     * @param maxEntries 保持する最大ファイル数（0で無効、超過時はSDカードを直接参照）
+     * @param verifyIntervalMs ライブラリ外での変更を検出するための読み比べの間隔（0で検出しない）
+     * @param persistent true=インデックスをアップロードディレクトリ内の DIRECTORY_INDEX_DIR に保存し、
+     *                   次回の起動時は走査せずに読み込む
+     * @note 稼働中に呼び出した場合はその場で読み込み（または再構築）します
+     */
+    void setDirectoryIndex(uint32_t maxEntries,
+                           uint32_t verifyIntervalMs = DEFAULT_DIRECTORY_INDEX_VERIFY_INTERVAL,
+                           bool persistent = true);
+
+    /**
+     * @brief ディレクトリを走査してインデックスを作り直す（ライブラリ外でSDカードを書き換えた直後に呼び出す）
+     */
+    void rescanDirectoryIndex();
+
+    /**
+     * @brief インデックスの統計情報（エントリ数・1エントリあたりのメモリ使用量など）を取得
+     */
+    DirectoryIndexStats getDirectoryIndexStats() const { return _directoryIndex.getStats(); }
+#endif
+
+#if ENABLE_DIRECTORY_STATS
+    /**
+     * @brief ディレクトリを走査してディレクトリ統計（ファイル数・合計サイズ・拡張子ごとの内訳）を数え直す
+     * @return 走査できた場合true
+     * @note 通常は書き込みのたびに差分で更新されます。インデックスが無効な構成での起動直後や、
+     *       ライブラリ外でSDカードを書き換えた後など、必要なときだけ呼び出してください
+     */
+    bool reconcileDirectoryStats();
+
+    /**
+     * @brief ディレクトリ統計を取得（ディレクトリの大きさによらず一定時間）
+     */
+    const DirectoryStats& getDirectoryStats() const { return _directoryStats; }
+#endif
+
+#if ENABLE_SHARDED_STORAGE
+    /**
+     * @brief アップロードディレクトリ直下のファイルをバケットに分けて保存する（APIからは平坦な一覧のまま）
+     * @param buckets バケット数（0で平坦な配置に戻す、最大 MAX_SHARD_BUCKETS）
+     * @note 稼働中に呼び出した場合はその場で既存のファイルを移行します（begin() でも前回と配置が異なれば移行）
+     */
+    void setShardedStorage(uint16_t buckets = DEFAULT_SHARD_BUCKETS);
+
+    /**
+     * @brief 既存のファイルを現在の配置へ移動する（ライブラリ外で直下にファイルを置いた場合などに呼び出す）
+     * @return 移動したファイル数
+     */
+    uint32_t migrateStorage();
+
+    /**
+     * @brief バケット数を取得（平坦な配置では0）
+     */
+    uint16_t getShardBucketCount() const { return _storageLayout.getBucketCount(); }
+#endif
+
     // ========================================================================
     // コールバック設定
     // ========================================================================
@@ -156,6 +365,18 @@ public:
      */
     uint8_t getActiveUploads() const;
 
+#if ENABLE_ADVANCED_ENDPOINTS
+    /**
+     * @brief 直近のダウンロードの転送統計を取得（バイト/秒の比較用）
+     */
+    const DownloadStats& getLastDownloadStats() const { return _lastDownloadStats; }
+#endif
+
+    /**
+     * @brief ディレクトリ世代カウンタを取得（アップロード・削除のたびに増加）
+     */
+    uint32_t getDirectoryGeneration() const { return _dirGeneration; }
+
     /**
      * @brief サーバーのIPアドレスを取得
      */
@@ -191,7 +412,24 @@ public:
     bool deleteFile(const char* filename);
 
     /**
-     * @brief ディレクトリ内のファイル一覧を取得
+     * @brief ファイルへデータを追記（ライブtailのフォロワーへも即座に配信）
+     * @param filename ファイル名（アップロードディレクトリ内）
+     * @param data 追記データ
+     * @param length 追記長
+     * @return 全バイト書き込めた場合true
+     */
+    bool appendFile(const char* filename, const uint8_t* data, size_t length);
+
+    /**
+     * @brief ファイル名を変更（アップロードディレクトリ内）
+     * @param from 変更前のファイル名
+     * @param to 変更後のファイル名（許可された拡張子のみ、既存ファイルがある場合は失敗）
+     * @return 変更できた場合true
+     */
+    bool renameFile(const char* from, const char* to);
+
+    /**
+     * @brief ディレクトリ内のファイル一覧を取得（最大 MAX_FILE_LIST_SIZE 件）
      */
     std::vector<String> listFiles(const char* path = nullptr);
 
@@ -200,7 +438,7 @@ private:
     // プライベートメンバ
     // ========================================================================
     
-    WebServer* _webServer;
+    UploaderWebServer* _webServer;
     ErrorHandler _errorHandler;
     RetryManager _retryManager;
     ProgressTracker _progressTracker;
@@ -217,10 +455,46 @@ private:
     bool _webSocketEnabled;
 #endif
     bool _overwriteProtection;
+    bool _keepAliveEnabled;
+    uint16_t _keepAliveMaxRequests;
+    uint32_t _keepAliveTimeout;
     uint32_t _totalUploaded;
+    uint32_t _dirGeneration;   // ディレクトリ世代（一覧のETagに使用）
+    uint32_t _bootId;          // 起動ごとの識別子（再起動後のETag衝突防止）
+#if ENABLE_DOWNLOAD_ENGINE
+    DownloadStreamer _downloadStreamer;
+    bool _downloadEngineEnabled;
+#endif
+#if ENABLE_ADVANCED_ENDPOINTS
+    DownloadStats _lastDownloadStats;
+    bool _gzipOnTheFly;
+    uint32_t _gzipMinSize;
+#endif
+#if ENABLE_FILE_CACHE
+    FileCache _fileCache;
+    bool _fileCacheConfigured;
+#endif
+#if ENABLE_TAIL
+    TailManager _tailManager;
+#endif
+#if ENABLE_CHANGE_FEED
+    ChangeFeed _changeFeed;
+#endif
+#if ENABLE_DIRECTORY_INDEX
+    DirectoryIndex _directoryIndex;
+    bool _directoryIndexConfigured;
+#endif
+#if ENABLE_DIRECTORY_STATS
+    DirectoryStats _directoryStats;
+#endif
+#if ENABLE_SHARDED_STORAGE
+    ShardedLayout _storageLayout;
+#endif
     
     std::map<uint8_t, UploadSession> _activeSessions;
     uint8_t _nextSessionId;
+    File _uploadFile;             // HTTPマルチパートで受信中のファイル
+    String _uploadFilename;
 
     // コールバック
     UploadCallback _onUploadStart = nullptr;
@@ -236,29 +510,120 @@ private:
     void _handleUploadHTTP();
     void _handleUploadData();  // マルチパートアップロードハンドラー
 #if ENABLE_WEBSOCKET
-    void _handleUploadWebSocket();
+    // WebSocketアップロード（file_info で開始し、続くバイナリフレームをチャンネル番号で振り分けてSDカードへ書き込む）
+    void _handleWebSocketFileInfo(uint8_t clientId, const WSFileInfo& info);
+    void _handleWebSocketData(uint8_t clientId, uint8_t channel, uint16_t sequence, const uint8_t* data,
+                              size_t length);
+    void _abortWebSocketUpload(uint8_t clientId, int16_t channel, uint8_t errorCode, const char* message);
+    void _checkWebSocketTimeouts();
+    UploadSession* _findClientSession(uint8_t clientId, int16_t channel);   // channel < 0 は任意のチャンネル
 #endif
     void _handleListFiles();
     void _handleDeleteFile();
     void _handleStatus();
 #if ENABLE_ADVANCED_ENDPOINTS
+    void _handleBatch();
+    bool _findJsonArray(JsonReader& reader, const char* key);
+    void _readBatchOperation(JsonReader& reader, char* op, size_t opSize, char* from, char* to, size_t size);
+    const char* _runBatchOperation(const char* op, const char* from, const char* to,
+                                   String& source, String& target, std::vector<String>& changed);
     void _handleFileListDetailed();
+    void _handleSearch();
+    void _sendFileList(ListingQuery& query);
     void _handleFileDownload();
+    bool _streamGzip(File& file, const String& contentType, DownloadStats& stats);
+    void _handleArchiveDownload();
+    bool _readArchiveManifest(const String& body, std::vector<String>& names, ArchiveFormat& format);
+#if ENABLE_FILE_CACHE
+    void _sendCachedFile(const FileCacheEntry& entry, const String& contentType, bool compressible);
+#endif
+#if ENABLE_THUMBNAILS
+    void _handleThumbnail();
+    String _thumbnailKey(const String& filename) const;
+    void _invalidateThumbnails(const char* filename);
+    void _invalidateThumbnails(const std::vector<String>& filenames);
+#endif
+#if ENABLE_TAIL
+    void _handleTail();
+    bool _flushUploadInProgress(const String& filename);   // 受信中ならflushしてtrue
+#endif
+#if ENABLE_CHANGE_FEED
+    void _handleChanges();
+#endif
+#if ENABLE_DIRECTORY_STATS
+    void _handleStatsReconcile();
+#endif
     void _handleDebugLog();
 #endif
     void _handleRoot();
 
+    // 一覧のページング（?limit=&cursor=）と並び順・絞り込み
+    bool _parseListingQuery(ListingQuery& query);
+    bool _matchesListing(const ListingQuery& query, const char* name, uint32_t size, uint32_t modified) const;
+    bool _openListing(File& dir, uint32_t& position, uint32_t& limit, ListingQuery& query);
+    uint32_t _writeFileEntries(JsonWriter& json, File& dir, uint32_t position, uint32_t limit,
+                               const ListingQuery& query, bool detailed, String& nextCursor);
+    uint32_t _writeTreeEntries(JsonWriter& json, uint32_t position, uint32_t limit,
+                               const ListingQuery& query, bool detailed, String& nextCursor);
+    void _writeCursor(JsonWriter& json, const String& cursor);
+    static uint32_t _nameHash(const char* name);
+
+    // ディレクトリインデックスの差分更新
+    void _rebuildDirectoryIndex(bool rescan = false);
+    void _indexFile(const char* filename);
+    void _indexFile(const char* filename, uint32_t size);
+    void _unindexFile(const char* filename);
+#if ENABLE_CHANGE_FEED
+    // 変更フィードへの記録（サイズを省略した場合はインデックスかSDカードから取得）
+    void _recordChange(ChangeType type, const char* filename, uint32_t size);
+    void _recordChange(ChangeType type, const char* filename);
+#endif
+    bool _knownMissing(const char* filename) const;
+
+    // ディレクトリ統計の差分更新（直下・バケット内のファイルのみ、統計が無効な構成では何もしない）
+    // 削除・上書きの前に _statFile() で元のサイズと更新時刻を取得し、成功後に _uncountFile() で反映する
+    void _seedDirectoryStats();
+    bool _statFile(const char* filename, uint32_t& size, uint32_t& modified);
+    void _countFile(const char* filename, uint32_t size, uint32_t modified = 0);
+    void _uncountFile(const char* filename, uint32_t size, uint32_t modified);
+    void _recountFile(const char* filename, uint32_t oldSize, uint32_t newSize);
+#if ENABLE_DIRECTORY_INDEX
+    const DirectoryIndexEntry& _listingEntry(const ListingQuery& query, size_t position) const;
+#endif
+
+    // アップロード先の検証・書き込みの開始と終了（HTTPマルチパート・WebSocket共通）
+    // _openUpload() は filename を検証・正規化後の相対パスに置き換え、失敗時はエラーメッセージを返す
+    const char* _openUpload(String& filename, const String& directory, File& file, bool& replacing,
+                            uint8_t& errorCode);
+    void _finishUpload(File& file, const String& filename, uint32_t size, bool replacing);
+    void _discardUpload(File& file, const String& filename, bool replacing);
+
     // ファイル操作
     bool _saveFile(const char* filename, uint8_t* data, uint32_t size);
     bool _isValidExtension(const char* filename);
     bool _isValidFilename(const char* filename);
     String _sanitizeFilename(const char* filename);
+    bool _resolvePath(const char* path, String& relative, bool allowRoot = false);
+    bool _ensureSubdirectory(const String& relative);
     bool _ensureUploadDirectory();
+    String _storagePath(const char* filename) const;
+    std::vector<String> _storageDirectories(const char* path) const;
 
     // ユーティリティ
     void _log(uint8_t level, const char* format, ...);
     void _sendJSONResponse(bool success, const char* message, const char* filename = nullptr);
     String _getContentType(const char* filename);
+    bool _isCompressibleType(const String& contentType);
+    bool _clientAcceptsGzip();
+
+    // 条件付きGET（ETag / Last-Modified）
+    bool _checkNotModified(const String& etag, time_t lastModified = 0);
+    String _listingETag() const;
+    void _markDirectoryChanged();
+    void _onFileChanged(const char* filename);
+    static bool _etagMatches(const String& ifNoneMatch, const String& etag);
+    static String _formatHTTPDate(time_t t);
+    static time_t _parseHTTPDate(const String& date);
 
     // セッション管理
     uint8_t _createSession(const char* filename, uint32_t filesize);
@@ -142,47 +142,68 @@ bool SDCardManager::deleteDir(const char* dirpath) {
     return SD.rmdir(dirpath);
 }
 
-std::vector<String> SDCardManager::listFiles(const char* dirpath, bool includeDir) {
-    std::vector<String> files;
-    
-    if (!_initialized) return files;
+uint32_t SDCardManager::forEachEntry(const char* dirpath, DirectoryVisitor visitor, bool includeDir, uint8_t fields) {
+    if (!_initialized || !visitor) return 0;
     
     File dir = SD.open(dirpath);
     if (!dir || !dir.isDirectory()) {
-        return files;
+        if (dir) dir.close();
+        return 0;
     }
     
-    File file = dir.openNextFile();
-    while (file) {
-        if (includeDir || !file.isDirectory()) {
-            files.push_back(file.name());
+    uint32_t visited = 0;
+    DirectoryEntry entry;
+    
+    if (fields == DIR_FIELD_NAME) {
+        // 名前だけなら各エントリを開かずに読み進める（フルパスが返るのでファイル名部分を渡す）
+        bool isDir = false;
+        String path = dir.getNextFileName(&isDir);
+        while (path.length() > 0) {
+            if (includeDir || !isDir) {
+                const char* slash = strrchr(path.c_str(), '/');
+                entry.name = slash ? slash + 1 : path.c_str();
+                entry.size = 0;
+                entry.modified = 0;
+                entry.isDirectory = isDir;
+                visited++;
+                if (!visitor(entry)) break;
+            }
+            path = dir.getNextFileName(&isDir);
         }
-        file = dir.openNextFile();
+    } else {
+        // サイズ・更新時刻は走査で開いたエントリから取り、パスで開き直さない
+        File file = dir.openNextFile();
+        while (file) {
+            bool isDir = file.isDirectory();
+            if (includeDir || !isDir) {
+                entry.name = file.name();
+                entry.size = (!isDir && (fields & DIR_FIELD_SIZE)) ? file.size() : 0;
+                entry.modified = (fields & DIR_FIELD_MODIFIED) ? (uint32_t)file.getLastWrite() : 0;
+                entry.isDirectory = isDir;
+                visited++;
+                if (!visitor(entry)) break;
+            }
+            file.close();
+            file = dir.openNextFile();
+        }
+        if (file) file.close();
     }
     
     dir.close();
+    return visited;
+}
+
+std::vector<String> SDCardManager::listFiles(const char* dirpath, bool includeDir) {
+    std::vector<String> files;
+    forEachEntry(dirpath, [&files](const DirectoryEntry& entry) {
+        files.push_back(entry.name);
+        return true;
+    }, includeDir, DIR_FIELD_NAME);
     return files;
 }
 
 uint32_t SDCardManager::getFileCount(const char* dirpath) {
-    if (!_initialized) return 0;
-    
-    File dir = SD.open(dirpath);
-    if (!dir || !dir.isDirectory()) {
-        return 0;
-    }
-    
-    uint32_t count = 0;
-    File file = dir.openNextFile();
-    while (file) {
-        if (!file.isDirectory()) {
-            count++;
-        }
-        file = dir.openNextFile();
-    }
-    
-    dir.close();
-    return count;
+    return forEachEntry(dirpath, [](const DirectoryEntry&) { return true; }, false, DIR_FIELD_NAME);
 }
 
 // ============================================================================
@@ -275,6 +296,32 @@ String SDCardManager::getFileExtension(const char* filename) {
     return ext;
 }
 
+bool SDCardManager::matchGlob(const char* pattern, const char* filename) {
+    if (!pattern || !filename) return false;
+    
+    // 最後の * の位置を覚えておき、不一致なら * が1文字多く吸収したものとしてやり直す
+    const char* star = nullptr;
+    const char* retry = nullptr;
+    while (*filename) {
+        if (*pattern == '*') {
+            star = pattern++;
+            retry = filename;
+        } else if (*pattern == '?' || tolower((unsigned char)*pattern) == tolower((unsigned char)*filename)) {
+            pattern++;
+            filename++;
+        } else if (star) {
+            pattern = star + 1;
+            filename = ++retry;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
 String SDCardManager::getBaseName(const char* filename) {
     const char* slash = strrchr(filename, '/');
     const char* start = slash ? slash + 1 : filename;
@@ -310,8 +357,8 @@ String SDCardManager::normalizePath(const char* path) {
         normalized.replace("//", "/");
     }
     
-    // パストラバーサル対策
-    while (normalized.indexOf("/../") != -1) {
+    // パストラバーサル対策（先頭の "/../" は戻る階層がないため残す。lastIndexOf() の位置が負にならないようにする）
+    while (normalized.indexOf("/../") > 0) {
         int pos = normalized.indexOf("/../");
         int prevSlash = normalized.lastIndexOf("/", pos - 1);
         if (prevSlash >= 0) {
@@ -385,37 +432,12 @@ uint32_t SDCardManager::getLastModified(const char* filepath) {
 std::vector<FileInfo> SDCardManager::listFilesWithInfo(const char* dirpath, bool includeDir) {
     std::vector<FileInfo> fileInfoList;
     
-    if (!_initialized) return fileInfoList;
-    
     String normalizedPath = normalizePath(dirpath);
-    File dir = SD.open(normalizedPath.c_str());
-    
-    if (!dir || !dir.isDirectory()) {
-        if (dir) dir.close();
-        return fileInfoList;
-    }
-    
-    File entry;
-    while (entry = dir.openNextFile()) {
-        bool isDir = entry.isDirectory();
-        
-        if (!includeDir && isDir) {
-            entry.close();
-            continue;
-        }
-        
-        FileInfo info;
-        info.name = String(entry.name());
-        info.size = isDir ? 0 : entry.size();
-        info.modified = getLastModified(entry.name());
-        info.isDirectory = isDir;
-        info.extension = isDir ? "" : getFileExtension(entry.name());
-        
-        fileInfoList.push_back(info);
-        entry.close();
-    }
+    forEachEntry(normalizedPath.c_str(), [&fileInfoList](const DirectoryEntry& entry) {
+        fileInfoList.push_back(_makeFileInfo(entry));
+        return true;
+    }, includeDir, DIR_FIELD_ALL);
     
-    dir.close();
     return fileInfoList;
 }
 
@@ -432,12 +454,24 @@ FileInfo SDCardManager::getFileInfo(const char* filepath) {
     File file = SD.open(filepath);
     if (!file) return info;
     
-    info.name = String(file.name());
-    info.isDirectory = file.isDirectory();
-    info.size = info.isDirectory ? 0 : file.size();
-    info.modified = getLastModified(filepath);
-    info.extension = info.isDirectory ? "" : getFileExtension(filepath);
+    // 開いたハンドルから全項目を取り、getLastModified() で開き直さない
+    DirectoryEntry entry;
+    entry.name = file.name();
+    entry.isDirectory = file.isDirectory();
+    entry.size = entry.isDirectory ? 0 : file.size();
+    entry.modified = file.getLastWrite();
+    info = _makeFileInfo(entry);
     
     file.close();
     return info;
 }
+
+FileInfo SDCardManager::_makeFileInfo(const DirectoryEntry& entry) {
+    FileInfo info;
+    info.name = String(entry.name);
+    info.size = entry.size;
+    info.modified = entry.modified;
+    info.isDirectory = entry.isDirectory;
+    info.extension = entry.isDirectory ? "" : getFileExtension(entry.name);
+    return info;
+}
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <SD.h>
+#include <functional>
 #include <vector>
 
 /**
@@ -16,6 +17,32 @@ struct FileInfo {
     String extension;     // 拡張子
 };
 
+/**
+ * @brief ディレクトリ走査中の1エントリ（開いているエントリから取得した値）
+ */
+struct DirectoryEntry {
+    const char* name;     // ファイル名（パスを除く、コールバック中のみ有効）
+    uint32_t size;        // ファイルサイズ（DIR_FIELD_SIZE 指定時、ディレクトリは0）
+    uint32_t modified;    // 最終更新時刻（DIR_FIELD_MODIFIED 指定時）
+    bool isDirectory;     // ディレクトリフラグ
+};
+
+/**
+ * @brief forEachEntry() で取得する項目
+ *
+ * 名前とディレクトリフラグは常に取得します。DIR_FIELD_NAME のみの場合は
+ * エントリを開かずに名前だけを読み進めるため最も速くなります。
+ */
+enum DirectoryField : uint8_t {
+    DIR_FIELD_NAME = 0,
+    DIR_FIELD_SIZE = 0x01,
+    DIR_FIELD_MODIFIED = 0x02,
+    DIR_FIELD_ALL = DIR_FIELD_SIZE | DIR_FIELD_MODIFIED
+};
+
+// ディレクトリ走査のコールバック（false を返すと走査を中止）
+typedef std::function<bool(const DirectoryEntry& entry)> DirectoryVisitor;
+
 /**
  * @brief SDカード操作を管理するクラス
  * 
@@ -122,6 +149,18 @@ public:
      */
     static bool deleteDir(const char* dirpath);
 
+    /**
+     * @brief ディレクトリを1回だけ走査し、各エントリでコールバックを呼び出す
+     * @param dirpath ディレクトリパス
+     * @param visitor エントリごとのコールバック（false を返すと中止）
+     * @param includeDir true=ディレクトリも含める
+     * @param fields 取得する項目（DirectoryField の論理和）
+     * @return コールバックを呼び出したエントリ数
+     * @note サイズ・更新時刻は走査で開いたエントリから取得し、パスで開き直すことはありません
+     */
+    static uint32_t forEachEntry(const char* dirpath, DirectoryVisitor visitor, bool includeDir = false,
+                                 uint8_t fields = DIR_FIELD_ALL);
+
     /**
      * @brief ディレクトリ内のファイル一覧を取得
      * @param dirpath ディレクトリパス
@@ -212,6 +251,14 @@ public:
      */
     static String getBaseName(const char* filename);
 
+    /**
+     * @brief ファイル名がワイルドカードのパターンに一致するか（大文字小文字を区別しない）
+     * @param pattern パターン（* は0文字以上、? は任意の1文字）
+     * @param filename ファイル名
+     * @return 一致すればtrue
+     */
+    static bool matchGlob(const char* pattern, const char* filename);
+
     // ========================================================================
     // ユーティリティ
     // ========================================================================
@@ -260,6 +307,11 @@ private:
      * @brief パスを正規化（内部用）
      */
     static String _normalizePath(const String& path);
+
+    /**
+     * @brief 開いているエントリから FileInfo を作成（内部用）
+     */
+    static FileInfo _makeFileInfo(const DirectoryEntry& entry);
 };
 
 #endif // SDCARD_MANAGER_H
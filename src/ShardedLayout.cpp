@@ -0,0 +1,184 @@
+#include "ShardedLayout.h"
+#include <vector>
+#include <esp_rom_crc.h>
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+ShardedLayout::ShardedLayout()
+    : _buckets(0) {
+}
+
+// ============================================================================
+// 設定・パスの変換
+// ============================================================================
+
+void ShardedLayout::configure(uint16_t buckets) {
+    _buckets = buckets > MAX_SHARD_BUCKETS ? MAX_SHARD_BUCKETS : buckets;
+}
+
+uint16_t ShardedLayout::bucketOf(const char* name) const {
+    if (_buckets == 0) return 0;
+
+    // FATは大文字小文字を区別しないため、小文字にそろえてからCRC32を取る
+    uint8_t buffer[32];
+    size_t used = 0;
+    uint32_t crc = 0;
+    for (const char* p = name; *p; p++) {
+        buffer[used++] = tolower((unsigned char)*p);
+        if (used == sizeof(buffer)) {
+            crc = esp_rom_crc32_le(crc, buffer, used);
+            used = 0;
+        }
+    }
+    crc = esp_rom_crc32_le(crc, buffer, used);
+    return crc % _buckets;
+}
+
+String ShardedLayout::bucketPath(const String& root, uint16_t bucket) const {
+    char name[8];
+    snprintf(name, sizeof(name), "%02x", bucket);
+    return _shardRoot(root) + "/" + name;
+}
+
+String ShardedLayout::filePath(const String& root, const char* name) const {
+    if (_buckets == 0 || strchr(name, '/')) {
+        return root + "/" + name;
+    }
+    return bucketPath(root, bucketOf(name)) + "/" + name;
+}
+
+// ============================================================================
+// 移行
+// ============================================================================
+
+uint32_t ShardedLayout::migrate(const String& root, uint32_t& conflicts) {
+    conflicts = 0;
+    String shardRoot = _shardRoot(root);
+    bool hasShards = SD.exists(shardRoot.c_str());
+    uint32_t moved = 0;
+
+    if (isSharded()) {
+        // 同じバケット数での移行が完了していれば、バケットの作成と再配置は省く
+        bool current = hasShards && _readLayoutMarker(root) == _buckets;
+        if (!current && !_ensureBuckets(root)) return 0;
+        moved += _moveFiles(root, root, conflicts);
+        if (current) return moved;
+    } else if (!hasShards) {
+        return 0;
+    }
+
+    // バケット数を変えた・平坦な配置に戻した場合は、既存のバケット内のファイルを移し直す
+    // （同時に開くディレクトリを1つにするため、バケットの一覧を先に読む）
+    std::vector<String> buckets;
+    File dir = SD.open(shardRoot.c_str());
+    if (dir && dir.isDirectory()) {
+        bool isDir = false;
+        String path = dir.getNextFileName(&isDir);
+        while (path.length() > 0) {
+            if (isDir) buckets.push_back(path.substring(path.lastIndexOf('/') + 1));
+            path = dir.getNextFileName(&isDir);
+        }
+    }
+    if (dir) dir.close();
+
+    for (const auto& name : buckets) {
+        String dirPath = shardRoot + "/" + name;
+        moved += _moveFiles(dirPath, root, conflicts);
+        // 使わなくなったバケットは空になっていれば削除する
+        if (!isSharded() || !_isBucketName(name.c_str())) {
+            SD.rmdir(dirPath.c_str());
+        }
+    }
+
+    // 移せなかったファイルが残っていれば、次回も再配置を試みる
+    if (conflicts == 0) {
+        if (isSharded()) {
+            _writeLayoutMarker(root);
+        } else {
+            String marker = shardRoot + "/" SHARD_LAYOUT_FILE;
+            SD.remove(marker.c_str());
+            SD.rmdir(shardRoot.c_str());
+        }
+    }
+    return moved;
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+String ShardedLayout::_shardRoot(const String& root) const {
+    return root + "/" SHARD_DIR;
+}
+
+uint16_t ShardedLayout::_readLayoutMarker(const String& root) const {
+    String marker = _shardRoot(root) + "/" SHARD_LAYOUT_FILE;
+    File file = SD.open(marker.c_str(), FILE_READ);
+    if (!file) return 0;
+
+    char text[8] = {0};
+    file.read((uint8_t*)text, sizeof(text) - 1);
+    file.close();
+    return (uint16_t)strtoul(text, nullptr, 10);
+}
+
+void ShardedLayout::_writeLayoutMarker(const String& root) const {
+    String marker = _shardRoot(root) + "/" SHARD_LAYOUT_FILE;
+    File file = SD.open(marker.c_str(), FILE_WRITE);
+    if (!file) return;
+    file.print(_buckets);
+    file.close();
+}
+
+bool ShardedLayout::_ensureBuckets(const String& root) const {
+    String shardRoot = _shardRoot(root);
+    if (!SD.exists(shardRoot.c_str()) && !SD.mkdir(shardRoot.c_str())) return false;
+
+    for (uint16_t bucket = 0; bucket < _buckets; bucket++) {
+        String path = bucketPath(root, bucket);
+        if (!SD.exists(path.c_str()) && !SD.mkdir(path.c_str())) return false;
+    }
+    return true;
+}
+
+bool ShardedLayout::_isBucketName(const char* name) const {
+    char* end = nullptr;
+    unsigned long bucket = strtoul(name, &end, 16);
+    if (end == name || *end != '\0' || bucket >= _buckets) return false;
+
+    char expected[8];
+    snprintf(expected, sizeof(expected), "%02x", (unsigned int)bucket);
+    return strcmp(name, expected) == 0;
+}
+
+uint32_t ShardedLayout::_moveFiles(const String& dirPath, const String& root, uint32_t& conflicts) const {
+    File dir = SD.open(dirPath.c_str());
+    if (!dir || !dir.isDirectory()) {
+        if (dir) dir.close();
+        return 0;
+    }
+
+    // FATは移動したエントリを削除済みの印に変えるだけで詰めないため、走査しながらリネームしても読み出し位置はずれない
+    uint32_t moved = 0;
+    bool isDir = false;
+    String path = dir.getNextFileName(&isDir);
+    while (path.length() > 0) {
+        if (!isDir) {
+            String name = path.substring(path.lastIndexOf('/') + 1);
+            String source = dirPath + "/" + name;
+            String target = filePath(root, name.c_str());
+            if (target != source) {
+                if (!SD.exists(target.c_str()) && SD.rename(source.c_str(), target.c_str())) {
+                    moved++;
+                } else {
+                    conflicts++;
+                }
+            }
+        }
+        path = dir.getNextFileName(&isDir);
+    }
+    dir.close();
+    return moved;
+}
@@ -0,0 +1,79 @@
+#ifndef SHARDED_LAYOUT_H
+#define SHARDED_LAYOUT_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SD.h>
+#include "Config.h"
+
+/**
+ * @brief アップロードディレクトリのファイルをハッシュで分けたバケットに保存する配置
+ *
+ * FATのディレクトリ内の検索（SD.exists / SD.open）はエントリ数に比例して遅くなるため、
+ * 直下のファイルを SHARD_DIR 内の N 個のバケット（ファイル名のCRC32 % N、"00"〜"ff"）に分けて保存します。
+ * APIからは従来どおり平坦な名前空間に見え、物理パスへの変換は filePath() だけで行います。
+ * サブディレクトリ（"cam1/a.jpg" のような相対パス）は分割せず、そのままの位置に保存します。
+ *
+ * バケット数の変更や平坦な配置との切り替えは migrate() で既存のファイルを移動して反映します。
+ * 移動は同じボリューム内の SD.rename() で行い、ファイルの内容はコピーしません。
+ */
+class ShardedLayout {
+public:
+    ShardedLayout();
+
+    /**
+     * @brief バケット数を設定（反映は次の migrate() から）
+     * @param buckets バケット数（0で平坦な配置、最大 MAX_SHARD_BUCKETS）
+     */
+    void configure(uint16_t buckets);
+
+    /**
+     * @brief バケットに分けて保存するか
+     */
+    bool isSharded() const { return _buckets > 0; }
+
+    /**
+     * @brief バケット数を取得（平坦な配置では0）
+     */
+    uint16_t getBucketCount() const { return _buckets; }
+
+    /**
+     * @brief ファイル名からバケット番号を求める（大文字小文字を区別しない、FATと同じ規則）
+     */
+    uint16_t bucketOf(const char* name) const;
+
+    /**
+     * @brief バケットのディレクトリのパスを取得
+     * @param root アップロードディレクトリのパス
+     * @param bucket バケット番号
+     */
+    String bucketPath(const String& root, uint16_t bucket) const;
+
+    /**
+     * @brief ファイルの物理パスを取得
+     * @param root アップロードディレクトリのパス
+     * @param name ファイル名（'/' を含む相対パスは分割しない）
+     */
+    String filePath(const String& root, const char* name) const;
+
+    /**
+     * @brief 既存のファイルを現在の配置へ移動する（直下のファイル・別のバケット数のバケット内のファイル）
+     * @param root アップロードディレクトリのパス
+     * @param conflicts 移動先に同名のファイルがある等の理由で移動できなかった数
+     * @return 移動したファイル数
+     * @note 前回の移行が完了していれば、直下のファイルの確認だけで済ませる
+     */
+    uint32_t migrate(const String& root, uint32_t& conflicts);
+
+private:
+    uint16_t _buckets;
+
+    String _shardRoot(const String& root) const;
+    uint16_t _readLayoutMarker(const String& root) const;
+    void _writeLayoutMarker(const String& root) const;
+    bool _ensureBuckets(const String& root) const;
+    bool _isBucketName(const char* name) const;
+    uint32_t _moveFiles(const String& dirPath, const String& root, uint32_t& conflicts) const;
+};
+
+#endif // SHARDED_LAYOUT_H
@@ -0,0 +1,161 @@
+#include "TailManager.h"
+
+// ============================================================================
+// コンストラクタ・デストラクタ
+// ============================================================================
+
+TailManager::TailManager()
+    : _maxFollowers(DEFAULT_MAX_TAIL_FOLLOWERS),
+      _idleTimeout(DEFAULT_TAIL_IDLE_TIMEOUT) {
+}
+
+TailManager::~TailManager() {
+    closeAll();
+}
+
+// ============================================================================
+// 設定・登録
+// ============================================================================
+
+void TailManager::configure(uint8_t maxFollowers, uint32_t idleTimeoutMs) {
+    _maxFollowers = maxFollowers;
+    _idleTimeout = idleTimeoutMs;
+
+    // 上限を下げた場合は古いフォロワーから終了
+    while (_followers.size() > _maxFollowers) {
+        _finish(_followers.front());
+        _followers.erase(_followers.begin());
+    }
+}
+
+bool TailManager::add(const WiFiClient& client, const String& filename, uint32_t offset) {
+    if (!canAccept()) return false;
+
+    TailFollower follower;
+    follower.client = client;
+    follower.filename = filename;
+    follower.offset = offset;
+    follower.lastActivity = millis();
+    follower.bytesSent = 0;
+    _followers.push_back(follower);
+    return true;
+}
+
+// ============================================================================
+// 書き込み側からの通知
+// ============================================================================
+
+void TailManager::notifyAppend(const String& filename, uint32_t offset, const uint8_t* data, size_t length) {
+    if (_followers.empty() || length == 0) return;
+
+    for (auto it = _followers.begin(); it != _followers.end();) {
+        if (it->filename != filename) {
+            ++it;
+            continue;
+        }
+
+        // 追跡位置より先のデータが届いた場合は欠落があるため終了させる（クライアントは from を指定して再接続）
+        if (offset > it->offset) {
+            _finish(*it);
+            it = _followers.erase(it);
+            continue;
+        }
+
+        // 追跡位置より前のデータは送信済み分を除いて送る
+        uint32_t end = offset + length;
+        bool ok = true;
+        if (end > it->offset) {
+            uint32_t skip = it->offset - offset;
+            ok = writeChunk(it->client, data + skip, length - skip);
+            if (ok) {
+                it->offset = end;
+                it->bytesSent += length - skip;
+                it->lastActivity = millis();
+            }
+        }
+
+        // 送信できないクライアントは書き込み側を待たせないよう切り離す
+        if (!ok || !it->client.connected()) {
+            it->client.stop();
+            it = _followers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TailManager::notifyTruncate(const String& filename) {
+    for (auto& follower : _followers) {
+        if (follower.filename == filename) {
+            follower.offset = 0;
+        }
+    }
+}
+
+void TailManager::notifyRemove(const String& filename) {
+    for (auto it = _followers.begin(); it != _followers.end();) {
+        if (it->filename == filename) {
+            _finish(*it);
+            it = _followers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// ============================================================================
+// 定期処理
+// ============================================================================
+
+void TailManager::loop() {
+    if (_followers.empty()) return;
+
+    unsigned long now = millis();
+    for (auto it = _followers.begin(); it != _followers.end();) {
+        if (!it->client.connected()) {
+            it->client.stop();
+            it = _followers.erase(it);
+        } else if (now - it->lastActivity >= _idleTimeout) {
+            _finish(*it);
+            it = _followers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TailManager::closeAll() {
+    for (auto& follower : _followers) {
+        _finish(follower);
+    }
+    _followers.clear();
+}
+
+bool TailManager::isFollowed(const String& filename) const {
+    for (const auto& follower : _followers) {
+        if (follower.filename == filename) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// チャンク転送
+// ============================================================================
+
+bool TailManager::writeChunk(WiFiClient& client, const uint8_t* data, size_t length) {
+    if (length == 0) return true;
+
+    char header[12];
+    int headerLength = snprintf(header, sizeof(header), "%x\r\n", (unsigned int)length);
+    if (client.write((const uint8_t*)header, headerLength) != (size_t)headerLength) return false;
+    if (client.write(data, length) != length) return false;
+    return client.write((const uint8_t*)"\r\n", 2) == 2;
+}
+
+void TailManager::_finish(TailFollower& follower) {
+    // 終端チャンクを送って正常終了させる
+    if (follower.client.connected()) {
+        follower.client.write((const uint8_t*)"0\r\n\r\n", 5);
+    }
+    follower.client.stop();
+}
@@ -0,0 +1,116 @@
+#ifndef TAIL_MANAGER_H
+#define TAIL_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <vector>
+#include "Config.h"
+
+// ============================================================================
+// tailフォロワー情報
+// ============================================================================
+struct TailFollower {
+    WiFiClient client;          // 切り離したクライアント（チャンク転送中）
+    String filename;            // 追跡中のファイル名
+    uint32_t offset;            // 次に送るファイル上の位置
+    unsigned long lastActivity; // 最後にデータを送った時刻
+    uint32_t bytesSent;         // 送信済みバイト数
+};
+
+/**
+ * @brief 追記中のファイルをクライアントへ流し続けるライブtail管理クラス
+ *
+ * 書き込み側（アップロード・appendFile）から追記データを直接受け取り、
+ * 同じファイルを追跡しているクライアントへチャンクとして送信します。
+ * SDカードをポーリングしないため、追記がない間は何も読み書きしません。
+ */
+class TailManager {
+public:
+    TailManager();
+    ~TailManager();
+
+    /**
+     * @brief 上限を設定
+     * @param maxFollowers 同時に追跡できるクライアント数
+     * @param idleTimeoutMs 追記がない状態でレスポンスを閉じるまでの時間（ミリ秒）
+     */
+    void configure(uint8_t maxFollowers, uint32_t idleTimeoutMs);
+
+    /**
+     * @brief 新しいフォロワーを受け付けられるか判定
+     */
+    bool canAccept() const { return _followers.size() < _maxFollowers; }
+
+    /**
+     * @brief フォロワーを登録（チャンク転送のヘッダーと既存部分の送信後に呼び出す）
+     * @param client 切り離したクライアント
+     * @param filename 追跡するファイル名
+     * @param offset 次に送るファイル上の位置
+     * @return 登録成功時true
+     */
+    bool add(const WiFiClient& client, const String& filename, uint32_t offset);
+
+    /**
+     * @brief 書き込み側からの追記通知
+     * @param filename ファイル名
+     * @param offset 追記したデータのファイル上の位置
+     * @param data 追記データ
+     * @param length 追記長
+     */
+    void notifyAppend(const String& filename, uint32_t offset, const uint8_t* data, size_t length);
+
+    /**
+     * @brief ファイルが切り詰められた（上書きされた）ことを通知
+     */
+    void notifyTruncate(const String& filename);
+
+    /**
+     * @brief ファイルが削除されたことを通知（追跡中のフォロワーを終了）
+     */
+    void notifyRemove(const String& filename);
+
+    /**
+     * @brief 切断・アイドルタイムアウトを処理（handleClient から定期的に呼び出す）
+     */
+    void loop();
+
+    /**
+     * @brief 全フォロワーを終了
+     */
+    void closeAll();
+
+    /**
+     * @brief 指定ファイルを追跡しているフォロワーがいるか
+     */
+    bool isFollowed(const String& filename) const;
+
+    /**
+     * @brief 現在のフォロワー数を取得
+     */
+    uint8_t getFollowerCount() const { return _followers.size(); }
+
+    /**
+     * @brief 最大フォロワー数を取得
+     */
+    uint8_t getMaxFollowers() const { return _maxFollowers; }
+
+    /**
+     * @brief アイドルタイムアウトを取得（ミリ秒）
+     */
+    uint32_t getIdleTimeout() const { return _idleTimeout; }
+
+    /**
+     * @brief チャンク転送の1チャンクを書き込む（フォロワー以外の送信にも使用）
+     * @return 全バイト書き込めた場合true
+     */
+    static bool writeChunk(WiFiClient& client, const uint8_t* data, size_t length);
+
+private:
+    std::vector<TailFollower> _followers;
+    uint8_t _maxFollowers;
+    uint32_t _idleTimeout;
+
+    void _finish(TailFollower& follower);
+};
+
+#endif // TAIL_MANAGER_H
@@ -0,0 +1,140 @@
+#include "ThumbnailGenerator.h"
+#include <rom/tjpgd.h>
+#include <algorithm>
+#include <vector>
+
+// ROM版TJpgDecが要求する作業領域サイズ
+#define TJPGD_WORK_SIZE 3100
+
+// ============================================================================
+// デコーダコンテキスト（jd_prepare の device として渡す）
+// ============================================================================
+struct ThumbnailDecodeContext {
+    File* source;
+    uint8_t* pixels;                // サムネイル画素（RGB888）
+    uint16_t width;                 // サムネイル幅
+    std::vector<uint16_t> mapX;     // サムネイルの各列が参照する縮小画像の列
+    std::vector<uint16_t> mapY;     // サムネイルの各行が参照する縮小画像の行
+};
+
+static UINT tjpgdInput(JDEC* decoder, BYTE* buffer, UINT length) {
+    ThumbnailDecodeContext* ctx = (ThumbnailDecodeContext*)decoder->device;
+    if (buffer) {
+        return ctx->source->read(buffer, length);
+    }
+    // buffer が NULL の場合は読み飛ばし
+    uint32_t position = ctx->source->position();
+    return ctx->source->seek(position + length) ? length : 0;
+}
+
+static UINT tjpgdOutput(JDEC* decoder, void* bitmap, JRECT* rect) {
+    ThumbnailDecodeContext* ctx = (ThumbnailDecodeContext*)decoder->device;
+    const uint8_t* src = (const uint8_t*)bitmap;
+    uint16_t rectWidth = rect->right - rect->left + 1;
+
+    // このブロックに含まれるサンプル点だけをサムネイルへ書き込む
+    auto rowBegin = std::lower_bound(ctx->mapY.begin(), ctx->mapY.end(), rect->top);
+    auto colBegin = std::lower_bound(ctx->mapX.begin(), ctx->mapX.end(), rect->left);
+    for (auto row = rowBegin; row != ctx->mapY.end() && *row <= rect->bottom; ++row) {
+        size_t dy = row - ctx->mapY.begin();
+        for (auto col = colBegin; col != ctx->mapX.end() && *col <= rect->right; ++col) {
+            size_t dx = col - ctx->mapX.begin();
+            const uint8_t* p = src + ((size_t)(*row - rect->top) * rectWidth + (*col - rect->left)) * 3;
+            uint8_t* d = ctx->pixels + (dy * ctx->width + dx) * 3;
+            d[0] = p[0];
+            d[1] = p[1];
+            d[2] = p[2];
+        }
+    }
+    return 1;
+}
+
+// ============================================================================
+// コンストラクタ
+// ============================================================================
+
+ThumbnailGenerator::ThumbnailGenerator()
+    : _sourceWidth(0),
+      _sourceHeight(0),
+      _width(0),
+      _height(0),
+      _scale(0) {
+}
+
+// ============================================================================
+// 生成
+// ============================================================================
+
+bool ThumbnailGenerator::generate(File& source, uint16_t maxSize, uint8_t quality, JpegOutputCallback output) {
+    _sourceWidth = _sourceHeight = _width = _height = 0;
+    _scale = 0;
+    if (maxSize == 0) return false;
+
+    void* work = malloc(TJPGD_WORK_SIZE);
+    if (!work) return false;
+
+    ThumbnailDecodeContext ctx;
+    ctx.source = &source;
+    ctx.pixels = nullptr;
+
+    JDEC decoder;
+    if (jd_prepare(&decoder, tjpgdInput, work, TJPGD_WORK_SIZE, &ctx) != JDR_OK) {
+        free(work);
+        return false;
+    }
+    _sourceWidth = decoder.width;
+    _sourceHeight = decoder.height;
+
+    // 長辺を maxSize に合わせる（元画像より大きくはしない）
+    uint16_t longSide = max(_sourceWidth, _sourceHeight);
+    uint16_t target = min(maxSize, longSide);
+    _width = max(1, (int)((uint32_t)_sourceWidth * target / longSide));
+    _height = max(1, (int)((uint32_t)_sourceHeight * target / longSide));
+
+    // サムネイル以上の解像度が残る最大の縮小率を選ぶ
+    uint16_t scaledWidth = _sourceWidth;
+    uint16_t scaledHeight = _sourceHeight;
+    for (uint8_t s = 3; s > 0; s--) {
+        uint16_t w = (_sourceWidth + (1 << s) - 1) >> s;
+        uint16_t h = (_sourceHeight + (1 << s) - 1) >> s;
+        if (w >= _width && h >= _height) {
+            _scale = s;
+            scaledWidth = w;
+            scaledHeight = h;
+            break;
+        }
+    }
+
+    ctx.width = _width;
+    ctx.mapX.resize(_width);
+    ctx.mapY.resize(_height);
+    for (uint16_t x = 0; x < _width; x++) {
+        ctx.mapX[x] = min((uint32_t)(2 * x + 1) * scaledWidth / (2 * _width), (uint32_t)scaledWidth - 1);
+    }
+    for (uint16_t y = 0; y < _height; y++) {
+        ctx.mapY[y] = min((uint32_t)(2 * y + 1) * scaledHeight / (2 * _height), (uint32_t)scaledHeight - 1);
+    }
+
+    size_t pixelBytes = (size_t)_width * _height * 3;
+    if (psramFound()) {
+        ctx.pixels = (uint8_t*)ps_malloc(pixelBytes);
+    }
+    if (!ctx.pixels) {
+        ctx.pixels = (uint8_t*)malloc(pixelBytes);
+    }
+    if (!ctx.pixels) {
+        free(work);
+        return false;
+    }
+    memset(ctx.pixels, 0, pixelBytes);
+
+    bool ok = jd_decomp(&decoder, tjpgdOutput, _scale) == JDR_OK;
+    free(work);
+
+    if (ok) {
+        JpegEncoder encoder;
+        ok = encoder.encode(ctx.pixels, _width, _height, quality, output);
+    }
+    free(ctx.pixels);
+    return ok;
+}
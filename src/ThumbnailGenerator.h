@@ -0,0 +1,63 @@
+#ifndef THUMBNAIL_GENERATOR_H
+#define THUMBNAIL_GENERATOR_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "Config.h"
+#include "JpegEncoder.h"
+
+/**
+ * @brief JPEGサムネイル生成クラス
+ *
+ * ESP32 ROM内蔵のTJpgDecのDCT領域縮小（1/2・1/4・1/8）で、目標サイズを
+ * 下回らない範囲で最も小さく展開するため、大きな写真でも全画素を展開しません。
+ * 展開結果を目標サイズへ間引き、JpegEncoderで小さなJPEGに再符号化します。
+ */
+class ThumbnailGenerator {
+public:
+    ThumbnailGenerator();
+
+    /**
+     * @brief サムネイルを生成
+     * @param source 元JPEGファイル（読み込み用に開いたもの）
+     * @param maxSize 長辺の最大ピクセル数（拡大はしない）
+     * @param quality JPEG品質（1〜100）
+     * @param output 出力コールバック
+     * @return 生成成功時true（プログレッシブJPEGなど非対応形式はfalse）
+     */
+    bool generate(File& source, uint16_t maxSize, uint8_t quality, JpegOutputCallback output);
+
+    /**
+     * @brief 元画像の幅を取得（generate後に有効）
+     */
+    uint16_t getSourceWidth() const { return _sourceWidth; }
+
+    /**
+     * @brief 元画像の高さを取得（generate後に有効）
+     */
+    uint16_t getSourceHeight() const { return _sourceHeight; }
+
+    /**
+     * @brief サムネイルの幅を取得（generate後に有効）
+     */
+    uint16_t getWidth() const { return _width; }
+
+    /**
+     * @brief サムネイルの高さを取得（generate後に有効）
+     */
+    uint16_t getHeight() const { return _height; }
+
+    /**
+     * @brief 使用したDCT縮小率（0=1/1, 1=1/2, 2=1/4, 3=1/8）を取得
+     */
+    uint8_t getScale() const { return _scale; }
+
+private:
+    uint16_t _sourceWidth;
+    uint16_t _sourceHeight;
+    uint16_t _width;
+    uint16_t _height;
+    uint8_t _scale;
+};
+
+#endif // THUMBNAIL_GENERATOR_H
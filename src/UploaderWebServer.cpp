@@ -0,0 +1,196 @@
+#include "UploaderWebServer.h"
+#include <vector>
+
+// ============================================================================
+// コンストラクタ・設定
+// ============================================================================
+
+UploaderWebServer::UploaderWebServer(uint16_t port)
+    : WebServer(port),
+      _keepAliveEnabled(true),
+      _keepAliveMaxRequests(DEFAULT_KEEP_ALIVE_MAX_REQUESTS),
+      _keepAliveTimeout(DEFAULT_KEEP_ALIVE_TIMEOUT),
+      _requestsOnConnection(0),
+      _keepAliveRequested(false),
+      _keepAliveResponded(false) {
+    _keepAliveStats = KeepAliveStats();
+}
+
+void UploaderWebServer::setKeepAlive(bool enable, uint16_t maxRequests, uint32_t idleTimeoutMs) {
+    _keepAliveEnabled = enable && maxRequests > 1;
+    _keepAliveMaxRequests = maxRequests;
+    _keepAliveTimeout = idleTimeoutMs;
+}
+
+void UploaderWebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
+    std::vector<const char*> keys(headerKeys, headerKeys + headerKeysCount);
+    keys.push_back("Connection");
+    WebServer::collectHeaders(keys.data(), keys.size());
+}
+
+// ============================================================================
+// クライアント処理
+// ============================================================================
+
+void UploaderWebServer::handleClient() {
+    if (!_keepAliveEnabled) {
+        WebServer::handleClient();
+        return;
+    }
+
+    if (_currentStatus == HC_NONE) {
+        _currentClient = _server.accept();
+        if (!_currentClient) {
+            if (_nullDelay) delay(1);
+            return;
+        }
+        _currentStatus = HC_WAIT_READ;
+        _statusChange = millis();
+        _requestsOnConnection = 0;
+        _keepAliveStats.connections++;
+    }
+
+    bool keepCurrentClient = false;
+
+    if (_currentClient.available()) {
+        // パイプライン化されたリクエストも受信バッファに残るため、1件ずつ到着順に処理される
+        _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
+        if (_parseRequest(_currentClient)) {
+            _requestsOnConnection++;
+            _keepAliveStats.requests++;
+            if (_requestsOnConnection > 1) _keepAliveStats.reusedRequests++;
+
+            _keepAliveRequested = _requestAllowsKeepAlive();
+            _keepAliveResponded = false;
+            _contentLength = CONTENT_LENGTH_NOT_SET;
+            _handleRequest();
+            _keepAliveRequested = false;
+
+            // ハンドラーがクライアントを切り離した場合はそのまま次の接続へ
+            if (_currentStatus == HC_NONE) {
+                return;
+            }
+            if (_keepAliveResponded && _currentClient.connected()) {
+                keepCurrentClient = true;
+                _statusChange = millis();
+            }
+        }
+    } else if (_currentClient.connected()) {
+        // 最初のリクエストは HTTP_MAX_DATA_WAIT、2件目以降は keep-alive のアイドル時間まで待つ
+        // 待機中の新しい接続がある場合は、アイドル中の接続を閉じて順番を譲る
+        bool idle = _requestsOnConnection > 0;
+        uint32_t limit = idle ? _keepAliveTimeout : HTTP_MAX_DATA_WAIT;
+        if (millis() - _statusChange <= limit && !(idle && _server.hasClient())) {
+            keepCurrentClient = true;
+        }
+        yield();
+    }
+
+    if (!keepCurrentClient) {
+        _dropClient();
+    }
+}
+
+WiFiClient UploaderWebServer::detachClient() {
+    WiFiClient client = _currentClient;
+    _currentClient = WiFiClient();
+    _currentStatus = HC_NONE;
+    // 終端チャンクは切り離した側が送るため、サーバーからは送らない
+    _chunked = false;
+    return client;
+}
+
+// ============================================================================
+// レスポンス送信
+// ============================================================================
+
+void UploaderWebServer::send(int code, const char* contentType, const String& content) {
+    String header;
+    _prepareResponseHeader(header, code, contentType, content.length());
+    _currentClient.write((const uint8_t*)header.c_str(), header.length());
+    if (content.length()) {
+        sendContent(content);
+    }
+}
+
+void UploaderWebServer::send(int code, char* contentType, const String& content) {
+    send(code, (const char*)contentType, content);
+}
+
+void UploaderWebServer::send(int code, const String& contentType, const String& content) {
+    send(code, contentType.c_str(), content);
+}
+
+void UploaderWebServer::send(int code, const char* contentType, const char* content) {
+    send_P(code, contentType, content, content ? strlen(content) : 0);
+}
+
+void UploaderWebServer::send_P(int code, PGM_P contentType, PGM_P content) {
+    send_P(code, contentType, content, content ? strlen_P(content) : 0);
+}
+
+void UploaderWebServer::send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength) {
+    String header;
+    _prepareResponseHeader(header, code, contentType, contentLength);
+    _currentClient.write((const uint8_t*)header.c_str(), header.length());
+    if (contentLength > 0) {
+        sendContent(content, contentLength);
+    }
+}
+
+// ============================================================================
+// プライベートメソッド
+// ============================================================================
+
+void UploaderWebServer::_prepareResponseHeader(String& response, int code, const char* contentType,
+                                               size_t contentLength) {
+    response = "HTTP/1." + String(_currentVersion) + ' ' + String(code) + ' ' + _responseCodeToString(code) + "\r\n";
+    response += "Content-Type: ";
+    response += contentType ? contentType : "text/html";
+    response += "\r\n";
+
+    // 本文の終わりが分からないレスポンス（HTTP/1.0 への長さ不明の送信）は切断で終端する
+    bool delimited = true;
+    if (_contentLength == CONTENT_LENGTH_NOT_SET) {
+        response += "Content-Length: " + String(contentLength) + "\r\n";
+    } else if (_contentLength != CONTENT_LENGTH_UNKNOWN) {
+        response += "Content-Length: " + String(_contentLength) + "\r\n";
+    } else if (_currentVersion) {
+        _chunked = true;
+        response += "Accept-Ranges: none\r\nTransfer-Encoding: chunked\r\n";
+    } else {
+        delimited = false;
+    }
+
+    _keepAliveResponded = _keepAliveRequested && delimited;
+    if (_keepAliveResponded) {
+        uint16_t remaining = _keepAliveMaxRequests - _requestsOnConnection;
+        response += "Connection: keep-alive\r\nKeep-Alive: timeout=" + String((_keepAliveTimeout + 999) / 1000) +
+                    ", max=" + String(remaining) + "\r\n";
+    } else {
+        response += "Connection: close\r\n";
+    }
+
+    response += _responseHeaders;
+    response += "\r\n";
+    _responseHeaders = "";
+}
+
+bool UploaderWebServer::_requestAllowsKeepAlive() {
+    if (_requestsOnConnection >= _keepAliveMaxRequests) return false;
+
+    // HTTP/1.1 は既定で持続的接続、HTTP/1.0 は明示的に要求された場合のみ
+    String connection = header("Connection");
+    connection.toLowerCase();
+    if (_currentVersion == 0) {
+        return connection.indexOf("keep-alive") >= 0;
+    }
+    return connection.indexOf("close") < 0;
+}
+
+void UploaderWebServer::_dropClient() {
+    _currentClient = WiFiClient();
+    _currentStatus = HC_NONE;
+    _currentUpload.reset();
+    _currentRaw.reset();
+}
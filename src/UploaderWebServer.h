@@ -0,0 +1,113 @@
+#ifndef UPLOADER_WEB_SERVER_H
+#define UPLOADER_WEB_SERVER_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+#include "Config.h"
+
+// ============================================================================
+// keep-alive統計情報
+// ============================================================================
+struct KeepAliveStats {
+    uint32_t connections;     // 受け付けた接続数
+    uint32_t requests;        // 処理したリクエスト数
+    uint32_t reusedRequests;  // 既存の接続で処理したリクエスト数（2件目以降）
+};
+
+/**
+ * @brief M5StackWiFiUploader 用の WebServer 拡張
+ *
+ * - 長時間開いたままにするレスポンス（ライブtailなど）のために、
+ *   処理中のクライアントをサーバーから切り離す機能
+ * - HTTP keep-alive（1接続で複数のリクエストを順に処理。パイプライン化されたリクエストも到着順に処理）
+ *
+ * keep-alive を返すため、レスポンスヘッダーを書き込む send() / send_P() / streamFile() を
+ * このクラスで置き換えています。WebServer 内部から送信されたレスポンス（ハンドラー未登録の404など）は
+ * 従来どおり Connection: close となり、その接続は応答後に閉じます。
+ */
+class UploaderWebServer : public WebServer {
+public:
+    explicit UploaderWebServer(uint16_t port = DEFAULT_HTTP_PORT);
+
+    /**
+     * @brief keep-alive を設定
+     * @param enable true=持続的接続を使用
+     * @param maxRequests 1接続で処理する最大リクエスト数
+     * @param idleTimeoutMs 次のリクエストを待つ最大時間（ミリ秒）
+     */
+    void setKeepAlive(bool enable, uint16_t maxRequests = DEFAULT_KEEP_ALIVE_MAX_REQUESTS,
+                      uint32_t idleTimeoutMs = DEFAULT_KEEP_ALIVE_TIMEOUT);
+
+    bool isKeepAliveEnabled() const { return _keepAliveEnabled; }
+
+    /**
+     * @brief keep-alive統計情報を取得
+     */
+    const KeepAliveStats& getKeepAliveStats() const { return _keepAliveStats; }
+
+    /**
+     * @brief クライアント処理（keep-alive無効時は WebServer の処理をそのまま使用）
+     */
+    void handleClient() override;
+
+    /**
+     * @brief 収集するリクエストヘッダーを設定（keep-alive判定用に Connection を追加）
+     */
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+
+    // レスポンス送信（ヘッダーに接続の扱いを反映）
+    void send(int code, const char* contentType = NULL, const String& content = String(""));
+    void send(int code, char* contentType, const String& content);
+    void send(int code, const String& contentType, const String& content);
+    void send(int code, const char* contentType, const char* content);
+    void send_P(int code, PGM_P contentType, PGM_P content);
+    void send_P(int code, PGM_P contentType, PGM_P content, size_t contentLength);
+
+    template <typename T>
+    size_t streamFile(T& file, const String& contentType, const int code = 200) {
+        // ".gz" のファイルは WebServer::streamFile() と同様に Content-Encoding: gzip を付与
+        String name = file.name();
+        if (name.endsWith(".gz") && contentType != "application/x-gzip" &&
+            contentType != "application/octet-stream") {
+            sendHeader("Content-Encoding", "gzip");
+        }
+        setContentLength(file.size());
+        send(code, contentType, "");
+        return _currentClient.write(file);
+    }
+
+    /**
+     * @brief 処理中のクライアントを切り離して返す
+     *
+     * 切り離した後はサーバーが応答の終端（チャンク終端）を書き込んだり
+     * 切断待ちで次の接続の受け付けを遅らせたりしないため、
+     * 呼び出し側がソケットの送信と切断に責任を持ちます。
+     * ハンドラーの最後に呼び出してください。
+     */
+    WiFiClient detachClient();
+
+    /**
+     * @brief 現在のリクエストがチャンク転送を受け取れるか（HTTP/1.1 以降）
+     */
+    bool acceptsChunked() const { return _currentVersion != 0; }
+
+    /**
+     * @brief 現在のレスポンスの後に接続を閉じる（本文を途中までしか送れなかった場合に呼び出す）
+     */
+    void closeAfterResponse() { _keepAliveResponded = false; }
+
+private:
+    bool _keepAliveEnabled;
+    uint16_t _keepAliveMaxRequests;
+    uint32_t _keepAliveTimeout;
+    uint16_t _requestsOnConnection;   // 現在の接続で処理したリクエスト数
+    bool _keepAliveRequested;         // 現在のリクエストで接続を維持できるか
+    bool _keepAliveResponded;         // 現在のレスポンスで keep-alive を返したか
+    KeepAliveStats _keepAliveStats;
+
+    void _prepareResponseHeader(String& response, int code, const char* contentType, size_t contentLength);
+    bool _requestAllowsKeepAlive();
+    void _dropClient();
+};
+
+#endif // UPLOADER_WEB_SERVER_H
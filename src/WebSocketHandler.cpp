@@ -1,4 +1,5 @@
 #include "WebSocketHandler.h"
+#include "ErrorHandler.h"
 #include <ArduinoJson.h>
 
 // ============================================================================
@@ -15,7 +16,8 @@ WebSocketHandler::WebSocketHandler(uint16_t port)
       _dataCallback(nullptr),
       _messageCallback(nullptr),
       _connectCallback(nullptr),
-      _disconnectCallback(nullptr) {
+      _disconnectCallback(nullptr),
+      _cancelCallback(nullptr) {
     _server = new WebSocketsServer(_port);
 }
 
@@ -77,26 +79,28 @@ void WebSocketHandler::handleClient() {
 // ============================================================================
 
 void WebSocketHandler::sendProgress(uint8_t clientId, const char* filename,
-                                    uint32_t uploaded, uint32_t total) {
+                                    uint32_t uploaded, uint32_t total, uint8_t channel) {
     if (!_isRunning || !_server) return;
 
     StaticJsonDocument<256> doc;
     doc["type"] = "progress";
+    doc["channel"] = channel;
     doc["filename"] = filename;
     doc["uploaded"] = uploaded;
     doc["total"] = total;
-    doc["percentage"] = (uploaded * 100) / total;
+    doc["percentage"] = total > 0 ? (uint32_t)((uint64_t)uploaded * 100 / total) : 100;
 
     String json;
     serializeJson(doc, json);
     _server->sendTXT(clientId, json);
 }
 
-void WebSocketHandler::sendComplete(uint8_t clientId, const char* filename, bool success) {
+void WebSocketHandler::sendComplete(uint8_t clientId, const char* filename, bool success, uint8_t channel) {
     if (!_isRunning || !_server) return;
 
     StaticJsonDocument<256> doc;
     doc["type"] = "complete";
+    doc["channel"] = channel;
     doc["filename"] = filename;
     doc["success"] = success;
 
@@ -105,11 +109,34 @@ void WebSocketHandler::sendComplete(uint8_t clientId, const char* filename, bool
     _server->sendTXT(clientId, json);
 }
 
-void WebSocketHandler::sendError(uint8_t clientId, uint8_t errorCode, const char* message) {
+void WebSocketHandler::sendAck(uint8_t clientId, const char* filename, uint32_t received, uint32_t uploaded,
+                               uint16_t credit, uint32_t chunkSize, uint8_t channel) {
+    if (!_isRunning || !_server) return;
+
+    StaticJsonDocument<256> doc;
+    doc["type"] = "ack";
+    doc["channel"] = channel;
+    doc["filename"] = filename;
+    doc["received"] = received;
+    doc["uploaded"] = uploaded;
+    doc["credit"] = credit;
+    if (chunkSize > 0) {
+        doc["chunkSize"] = chunkSize;
+    }
+
+    String json;
+    serializeJson(doc, json);
+    _server->sendTXT(clientId, json);
+}
+
+void WebSocketHandler::sendError(uint8_t clientId, uint8_t errorCode, const char* message, int16_t channel) {
     if (!_isRunning || !_server) return;
 
     StaticJsonDocument<256> doc;
     doc["type"] = "error";
+    if (channel >= 0) {
+        doc["channel"] = channel;
+    }
     doc["code"] = errorCode;
     doc["message"] = message;
 
@@ -183,7 +210,7 @@ void WebSocketHandler::_handleWebSocketEvent(uint8_t clientId, WStype_t type,
             break;
 
         case WStype_BIN:
-            _log(3, "[WS] Binary message from client %d, length: %d", clientId, length);
+            _log(3, "[WS] Binary message from client %d, length: %u", clientId, (unsigned int)length);
             _handleBinaryMessage(clientId, payload, length);
             break;
 
@@ -210,14 +237,14 @@ void WebSocketHandler::_handleTextMessage(uint8_t clientId, const char* message)
 
     if (error) {
         _log(1, "[WS] JSON parse error: %s", error.c_str());
-        sendError(clientId, 4, "Invalid JSON format");
+        sendError(clientId, ERR_INVALID_REQUEST, "Invalid JSON format");
         return;
     }
 
     const char* type = doc["type"];
     if (!type) {
         _log(1, "[WS] Missing message type");
-        sendError(clientId, 4, "Missing message type");
+        sendError(clientId, ERR_INVALID_REQUEST, "Missing message type");
         return;
     }
 
@@ -230,16 +257,22 @@ void WebSocketHandler::_handleTextMessage(uint8_t clientId, const char* message)
         fileInfo.mimeType = doc["mimeType"].as<String>();
         fileInfo.chunkSize = doc["chunkSize"] | 4096;
         fileInfo.totalChunks = doc["totalChunks"];
+        fileInfo.path = doc["path"] | "";
+        fileInfo.channel = doc["channel"] | 0;
 
-        _log(2, "[WS] File info: %s (%u bytes)", fileInfo.filename.c_str(), fileInfo.filesize);
+        _log(2, "[WS] File info: %s (%u bytes, channel %u)", fileInfo.filename.c_str(), fileInfo.filesize,
+             fileInfo.channel);
 
         if (_fileInfoCallback) {
             _fileInfoCallback(clientId, fileInfo);
         }
     }
     else if (strcmp(type, "cancel") == 0) {
-        _log(2, "[WS] Upload cancel request from client %d", clientId);
-        // キャンセル処理
+        int16_t channel = doc["channel"] | -1;
+        _log(2, "[WS] Upload cancel request from client %d (channel %d)", clientId, channel);
+        if (_cancelCallback) {
+            _cancelCallback(clientId, channel);
+        }
     }
     else if (strcmp(type, "pause") == 0) {
         _log(2, "[WS] Upload pause request from client %d", clientId);
@@ -259,8 +292,16 @@ void WebSocketHandler::_handleTextMessage(uint8_t clientId, const char* message)
 
 void WebSocketHandler::_handleBinaryMessage(uint8_t clientId, const uint8_t* data, size_t length) {
     // バイナリデータ（ファイルチャンク）を処理
+    if (length < WS_FRAME_HEADER_SIZE) {
+        _log(1, "[WS] Binary frame shorter than header from client %d (%u bytes)", clientId, (unsigned int)length);
+        sendError(clientId, ERR_INVALID_DATA, "Binary frame shorter than header");
+        return;
+    }
+
+    uint8_t channel = data[0];
+    uint16_t sequence = data[2] | (data[3] << 8);
     if (_dataCallback) {
-        _dataCallback(clientId, data, length);
+        _dataCallback(clientId, channel, sequence, data + WS_FRAME_HEADER_SIZE, length - WS_FRAME_HEADER_SIZE);
     }
 }
 
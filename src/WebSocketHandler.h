@@ -19,6 +19,16 @@ enum WSMessageType {
     WS_MSG_RESUME          // 再開要求
 };
 
+// ============================================================================
+// バイナリフレームのヘッダー
+// ============================================================================
+// ファイルデータのバイナリフレームは先頭に4バイトのヘッダーを持つ
+//   [0]    チャンネル番号（file_info の "channel"）
+//   [1]    フラグ（予約、0を送る）
+//   [2..3] シーケンス番号（リトルエンディアン、チャンネルごとに0から数え、65535の次は0）
+// 1つの接続で複数のファイルを同時に送る場合、フレームはチャンネル番号で各転送へ振り分ける
+#define WS_FRAME_HEADER_SIZE 4
+
 // ============================================================================
 // WebSocketファイル情報
 // ============================================================================
@@ -28,15 +38,19 @@ struct WSFileInfo {
     String mimeType;
     uint32_t chunkSize;
     uint32_t totalChunks;
+    String path;            // 保存先のサブディレクトリ（HTTPの ?path= と同じ、省略時は直下）
+    uint8_t channel;        // 転送のチャンネル番号（省略時は0）
 };
 
 // ============================================================================
 // WebSocketコールバック
 // ============================================================================
 typedef std::function<void(uint8_t clientId, const WSFileInfo& fileInfo)> WSFileInfoCallback;
-typedef std::function<void(uint8_t clientId, const uint8_t* data, size_t length)> WSDataCallback;
+typedef std::function<void(uint8_t clientId, uint8_t channel, uint16_t sequence, const uint8_t* data,
+                           size_t length)> WSDataCallback;
 typedef std::function<void(uint8_t clientId, const char* message)> WSMessageCallback;
 typedef std::function<void(uint8_t clientId)> WSClientCallback;
+typedef std::function<void(uint8_t clientId, int16_t channel)> WSChannelCallback;   // channel < 0 は全チャンネル
 
 // ============================================================================
 // WebSocketHandler クラス
@@ -83,7 +97,7 @@ public:
     void onFileInfo(WSFileInfoCallback callback) { _fileInfoCallback = callback; }
 
     /**
-     * @brief データ受信コールバックを設定
+     * @brief データ受信コールバックを設定（ヘッダーを除いたデータとチャンネル番号・シーケンス番号を渡す）
      * @param callback コールバック関数
      */
     void onData(WSDataCallback callback) { _dataCallback = callback; }
@@ -106,6 +120,12 @@ public:
      */
     void onDisconnect(WSClientCallback callback) { _disconnectCallback = callback; }
 
+    /**
+     * @brief アップロード中止要求（{"type":"cancel","channel":n}）受信コールバックを設定
+     * @param callback コールバック関数（"channel" を省略した場合は channel = -1）
+     */
+    void onCancel(WSChannelCallback callback) { _cancelCallback = callback; }
+
     // ========================================================================
     // メッセージ送信
     // ========================================================================
@@ -116,25 +136,41 @@ public:
      * @param filename ファイル名
      * @param uploaded アップロード済みバイト数
      * @param total 総バイト数
+     * @param channel チャンネル番号
      */
     void sendProgress(uint8_t clientId, const char* filename, 
-                     uint32_t uploaded, uint32_t total);
+                     uint32_t uploaded, uint32_t total, uint8_t channel = 0);
 
     /**
      * @brief 完了通知を送信
      * @param clientId クライアントID
      * @param filename ファイル名
      * @param success 成功フラグ
+     * @param channel チャンネル番号
+     */
+    void sendComplete(uint8_t clientId, const char* filename, bool success, uint8_t channel = 0);
+
+    /**
+     * @brief 受信確認とクレジットを送信（クライアントは received + credit チャンクまで送信できる）
+     * @param clientId クライアントID
+     * @param filename ファイル名
+     * @param received 受信済みのチャンク数
+     * @param uploaded 受信済みのバイト数
+     * @param credit 受信済みのチャンクから数えて送信してよいチャンク数
+     * @param chunkSize 1チャンクの最大バイト数（ヘッダーを除く、file_info への応答でのみ通知、0で省略）
+     * @param channel チャンネル番号
      */
-    void sendComplete(uint8_t clientId, const char* filename, bool success);
+    void sendAck(uint8_t clientId, const char* filename, uint32_t received, uint32_t uploaded,
+                 uint16_t credit, uint32_t chunkSize = 0, uint8_t channel = 0);
 
     /**
      * @brief エラー通知を送信
      * @param clientId クライアントID
      * @param errorCode エラーコード
      * @param message エラーメッセージ
+     * @param channel チャンネル番号（転送に関係しないエラーは負の値で省略）
      */
-    void sendError(uint8_t clientId, uint8_t errorCode, const char* message);
+    void sendError(uint8_t clientId, uint8_t errorCode, const char* message, int16_t channel = -1);
 
     /**
      * @brief テキストメッセージを送信
@@ -215,6 +251,7 @@ private:
     WSMessageCallback _messageCallback;
     WSClientCallback _connectCallback;
     WSClientCallback _disconnectCallback;
+    WSChannelCallback _cancelCallback;
 
     /**
      * @brief WebSocketイベントハンドラー